@@ -0,0 +1,309 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+
+#include "nel/misc/common.h"
+#include "nel/misc/debug.h"
+
+#include "benchmark.h"
+#include "render_stats.h"
+
+using namespace NLMISC;
+
+// square loop around location at fixed camera height
+static CBenchmarkPath makeLoop(const std::string &name, float x, float y, float size)
+{
+	float half = size / 2.f;
+	float z = 50.f;
+
+	CBenchmarkPath path;
+	path.Name = name;
+	path.Step = 4.f;
+	path.Waypoints = {
+		CVector(x - half, y + half, z),
+		CVector(x + half, y + half, z),
+		CVector(x + half, y - half, z),
+		CVector(x - half, y - half, z),
+		CVector(x - half, y + half, z),
+	};
+	return path;
+}
+
+// square area centered around location
+static CBenchmarkRegion makeRegion(const std::string &name, float x, float y, float size)
+{
+	float half = size / 2.f;
+
+	CBenchmarkRegion region;
+	region.Name = name;
+	region.Min = CVector2f(x - half, y - half);
+	region.Max = CVector2f(x + half, y + half);
+	return region;
+}
+
+//----------------------------------------------------------------------------
+const std::vector<CBenchmarkPath> &getBenchmarkPaths()
+{
+	// same locations as keyboard shortcuts
+	static std::vector<CBenchmarkPath> paths;
+	if (paths.empty()) {
+		paths.push_back(makeLoop("pyr", 18886, -24346, 400));
+		paths.push_back(makeLoop("fairhaven", 17126, -32986, 400));
+		paths.push_back(makeLoop("yrkanis", 4720, -3435, 400));
+		paths.push_back(makeLoop("zorai", 8643, -2868, 400));
+		paths.push_back(makeLoop("nexus", 8960, -7120, 400));
+
+		// long flight out of pyr, streams zones in and out
+		CBenchmarkPath flight;
+		flight.Name = "pyr_flight";
+		flight.Step = 16.f;
+		flight.Waypoints = {
+			CVector(18886, -24346, 50),
+			CVector(20486, -24346, 50),
+			CVector(20486, -25946, 50),
+		};
+		paths.push_back(flight);
+	}
+	return paths;
+}
+
+//----------------------------------------------------------------------------
+const std::vector<CBenchmarkRegion> &getBenchmarkRegions()
+{
+	static std::vector<CBenchmarkRegion> regions;
+	if (regions.empty()) {
+		regions.push_back(makeRegion("pyr_region", 18880, -24320, 800));
+		regions.push_back(makeRegion("fairhaven_region", 17120, -32960, 800));
+		regions.push_back(makeRegion("yrkanis_region", 4720, -3440, 800));
+		regions.push_back(makeRegion("zorai_region", 8640, -2880, 800));
+	}
+	return regions;
+}
+
+//----------------------------------------------------------------------------
+void CBenchmarkResult::setSamples(std::vector<double> samples, double elapsed)
+{
+	std::sort(samples.begin(), samples.end());
+
+	Frames = samples.size();
+	Elapsed = elapsed;
+	Avg = samples.empty() ? 0.0 : std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+	P50 = CRenderStats::percentile(samples, 50);
+	P90 = CRenderStats::percentile(samples, 90);
+	P99 = CRenderStats::percentile(samples, 99);
+	Max = CRenderStats::percentile(samples, 100);
+	Throughput = elapsed > 0 ? Frames / elapsed : 0.0;
+}
+
+//----------------------------------------------------------------------------
+void CBenchmarkReport::setInfo(const std::string &key, const std::string &value)
+{
+	for (auto &it : _Info) {
+		if (it.first == key) {
+			it.second = value;
+			return;
+		}
+	}
+	_Info.emplace_back(key, value);
+}
+
+//----------------------------------------------------------------------------
+std::string CBenchmarkReport::getInfo(const std::string &key) const
+{
+	for (const auto &it : _Info) {
+		if (it.first == key) {
+			return it.second;
+		}
+	}
+	return "";
+}
+
+//----------------------------------------------------------------------------
+bool CBenchmarkReport::writeJson(const std::string &filename) const
+{
+	std::ofstream out(filename.c_str());
+	if (!out.is_open()) {
+		nlwarning("failed to open '%s' for writing", filename.c_str());
+		return false;
+	}
+
+	out << std::fixed << std::setprecision(6);
+	out << "{\n";
+	out << "  \"info\": {";
+	for (uint i = 0; i < _Info.size(); ++i) {
+		out << (i > 0 ? ",\n" : "\n") << "    \"" << CRenderStats::jsonEscape(_Info[i].first) << "\": \""
+		    << CRenderStats::jsonEscape(_Info[i].second) << "\"";
+	}
+	out << "\n  },\n";
+
+	out << "  \"results\": [";
+	for (uint i = 0; i < _Results.size(); ++i) {
+		const CBenchmarkResult &r = _Results[i];
+		out << (i > 0 ? ",\n" : "\n")
+		    << "    { \"name\": \"" << CRenderStats::jsonEscape(r.Name) << "\""
+		    << ", \"kind\": \"" << r.Kind << "\""
+		    << ", \"frames\": " << r.Frames
+		    << ", \"elapsed\": " << r.Elapsed
+		    << ", \"avg\": " << r.Avg
+		    << ", \"p50\": " << r.P50
+		    << ", \"p90\": " << r.P90
+		    << ", \"p99\": " << r.P99
+		    << ", \"max\": " << r.Max
+		    << ", \"zones_loaded\": " << r.ZonesLoaded
+		    << ", \"zones_unloaded\": " << r.ZonesUnloaded
+		    << ", \"throughput\": " << r.Throughput
+		    << " }";
+	}
+	out << "\n  ]\n";
+	out << "}\n";
+
+	return true;
+}
+
+//----------------------------------------------------------------------------
+bool CBenchmarkReport::writeCsv(const std::string &filename) const
+{
+	std::ofstream out(filename.c_str());
+	if (!out.is_open()) {
+		nlwarning("failed to open '%s' for writing", filename.c_str());
+		return false;
+	}
+
+	// run info as comment lines
+	for (const auto &it : _Info) {
+		out << "# " << it.first << "=" << it.second << "\n";
+	}
+
+	out << std::fixed << std::setprecision(6);
+	out << "name,kind,frames,elapsed,avg,p50,p90,p99,max,zones_loaded,zones_unloaded,throughput\n";
+	for (const auto &r : _Results) {
+		out << r.Name << "," << r.Kind << "," << r.Frames << "," << r.Elapsed
+		    << "," << r.Avg << "," << r.P50 << "," << r.P90 << "," << r.P99 << "," << r.Max
+		    << "," << r.ZonesLoaded << "," << r.ZonesUnloaded << "," << r.Throughput << "\n";
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------------
+bool CBenchmarkReport::loadCsv(const std::string &filename)
+{
+	std::ifstream in(filename.c_str());
+	if (!in.is_open()) {
+		nlwarning("failed to open '%s' for reading", filename.c_str());
+		return false;
+	}
+
+	_Info.clear();
+	_Results.clear();
+
+	std::string line;
+	bool header = true;
+	while (std::getline(in, line)) {
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		if (line.empty()) continue;
+
+		if (line[0] == '#') {
+			std::string::size_type pos = line.find('=');
+			if (pos != std::string::npos) {
+				setInfo(trim(line.substr(1, pos - 1)), line.substr(pos + 1));
+			}
+			continue;
+		}
+
+		if (header) {
+			header = false;
+			continue;
+		}
+
+		std::vector<std::string> cols;
+		splitString(line, ",", cols);
+		if (cols.size() != 12) {
+			nlwarning("'%s': invalid line '%s'", filename.c_str(), line.c_str());
+			continue;
+		}
+
+		CBenchmarkResult r;
+		r.Name = cols[0];
+		r.Kind = cols[1];
+		fromString(cols[2], r.Frames);
+		fromString(cols[3], r.Elapsed);
+		fromString(cols[4], r.Avg);
+		fromString(cols[5], r.P50);
+		fromString(cols[6], r.P90);
+		fromString(cols[7], r.P99);
+		fromString(cols[8], r.Max);
+		fromString(cols[9], r.ZonesLoaded);
+		fromString(cols[10], r.ZonesUnloaded);
+		fromString(cols[11], r.Throughput);
+		_Results.push_back(r);
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------------
+bool CBenchmarkReport::compare(const CBenchmarkReport &baseline, float tolerance) const
+{
+	// different settings make numbers meaningless
+	for (const auto &it : _Info) {
+		if (it.first == "date") continue;
+
+		std::string other = baseline.getInfo(it.first);
+		if (other != it.second) {
+			std::cout << "WARN: baseline " << it.first << " '" << other << "' differs from '" << it.second << "'\n";
+		}
+	}
+
+	auto delta = [](double now, double base) {
+		return base > 0 ? (now - base) / base * 100.0 : 0.0;
+	};
+
+	bool ok = true;
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "benchmark vs baseline (p50/p99 ms, throughput/s)\n";
+	for (const auto &r : _Results) {
+		const CBenchmarkResult *base = nullptr;
+		for (const auto &b : baseline.getResults()) {
+			if (b.Name == r.Name && b.Kind == r.Kind) {
+				base = &b;
+				break;
+			}
+		}
+		if (!base) {
+			std::cout << "  " << r.Name << ": not in baseline\n";
+			continue;
+		}
+
+		double p50 = delta(r.P50, base->P50);
+		bool slower = p50 > tolerance;
+		if (slower) {
+			ok = false;
+		}
+
+		std::cout << "  " << r.Name
+		          << ": p50 " << base->P50 * 1000.0 << " -> " << r.P50 * 1000.0 << " (" << std::showpos << p50 << std::noshowpos << "%)"
+		          << ", p99 " << base->P99 * 1000.0 << " -> " << r.P99 * 1000.0 << " (" << std::showpos << delta(r.P99, base->P99) << std::noshowpos << "%)"
+		          << ", throughput " << base->Throughput << " -> " << r.Throughput
+		          << ", zones " << base->ZonesLoaded << " -> " << r.ZonesLoaded
+		          << (slower ? "  REGRESSION" : "") << "\n";
+	}
+	std::cout << std::flush;
+
+	return ok;
+}
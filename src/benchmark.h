@@ -0,0 +1,103 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nel/misc/types_nl.h"
+#include "nel/misc/vector.h"
+#include "nel/misc/vector_2f.h"
+
+// top-down camera path, replayed at fixed step per frame so frame count
+// does not depend on machine speed
+struct CBenchmarkPath
+{
+	std::string Name;
+	// camera moves in straight lines between waypoints
+	std::vector<NLMISC::CVector> Waypoints;
+	// meters per frame
+	float Step;
+};
+
+// fixed world area rendered with auto render tiles
+struct CBenchmarkRegion
+{
+	std::string Name;
+	NLMISC::CVector2f Min;
+	NLMISC::CVector2f Max;
+};
+
+const std::vector<CBenchmarkPath> &getBenchmarkPaths();
+const std::vector<CBenchmarkRegion> &getBenchmarkRegions();
+
+struct CBenchmarkResult
+{
+	std::string Name;
+	// "path" or "region"
+	std::string Kind;
+	// frames for path, tiles for region
+	uint Frames;
+	// seconds
+	double Elapsed;
+	double Avg, P50, P90, P99, Max;
+	uint ZonesLoaded;
+	uint ZonesUnloaded;
+	// frames (tiles) per second
+	double Throughput;
+
+	CBenchmarkResult()
+	    : Frames(0)
+	    , Elapsed(0)
+	    , Avg(0)
+	    , P50(0)
+	    , P90(0)
+	    , P99(0)
+	    , Max(0)
+	    , ZonesLoaded(0)
+	    , ZonesUnloaded(0)
+	    , Throughput(0)
+	{
+	}
+
+	// fill frame time fields from samples (seconds)
+	void setSamples(std::vector<double> samples, double elapsed);
+};
+
+// benchmark results with run info (driver, window size, settings)
+// numbers are only comparable with same renderer, ie. mesa llvmpipe
+// with LIBGL_ALWAYS_SOFTWARE=1 on every machine
+class CBenchmarkReport
+{
+public:
+	void setInfo(const std::string &key, const std::string &value);
+	std::string getInfo(const std::string &key) const;
+
+	void addResult(const CBenchmarkResult &result) { _Results.push_back(result); }
+	const std::vector<CBenchmarkResult> &getResults() const { return _Results; }
+
+	bool writeJson(const std::string &filename) const;
+	bool writeCsv(const std::string &filename) const;
+	// read csv written by writeCsv (saved baseline)
+	bool loadCsv(const std::string &filename);
+
+	// print per case difference to baseline, returns false if any case p50
+	// is slower than tolerance (percent)
+	bool compare(const CBenchmarkReport &baseline, float tolerance) const;
+
+private:
+	std::vector<std::pair<std::string, std::string>> _Info;
+	std::vector<CBenchmarkResult> _Results;
+};
+
+#endif
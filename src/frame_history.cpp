@@ -0,0 +1,140 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "frame_history.h"
+#include "render_stats.h"
+
+using namespace NLMISC;
+
+static const char *frameStageNames[FrameStageCount] = {
+	"refresh",
+	"render",
+	"overlay",
+	"swap",
+};
+
+//----------------------------------------------------------------------------
+const char *getFrameStageName(TFrameStage stage)
+{
+	if (stage >= FrameStageCount) return "unknown";
+	return frameStageNames[stage];
+}
+
+//----------------------------------------------------------------------------
+CFrameHistory::CFrameHistory()
+    : _Head(0)
+    , _Count(0)
+    , _FrameStart(0)
+{
+	_Current = CFrame();
+}
+
+//----------------------------------------------------------------------------
+void CFrameHistory::beginFrame()
+{
+	_FrameStart = CTime::getPerformanceTime();
+	_Current = CFrame();
+}
+
+//----------------------------------------------------------------------------
+void CFrameHistory::endFrame()
+{
+	_Current.Total = CTime::ticksToSecond(CTime::getPerformanceTime() - _FrameStart);
+
+	_Frames[_Head] = _Current;
+	_Head = (_Head + 1) % MaxFrames;
+	if (_Count < MaxFrames) {
+		_Count++;
+	}
+}
+
+//----------------------------------------------------------------------------
+void CFrameHistory::addStageTime(TFrameStage stage, double seconds)
+{
+	if (seconds > 0) {
+		_Current.Stage[stage] += seconds;
+	}
+}
+
+//----------------------------------------------------------------------------
+double CFrameHistory::getFrame(uint i) const
+{
+	if (i >= _Count) return 0.0;
+	return _Frames[(_Head + MaxFrames - _Count + i) % MaxFrames].Total;
+}
+
+//----------------------------------------------------------------------------
+double CFrameHistory::getFrameStage(uint i, TFrameStage stage) const
+{
+	if (i >= _Count) return 0.0;
+	return _Frames[(_Head + MaxFrames - _Count + i) % MaxFrames].Stage[stage];
+}
+
+//----------------------------------------------------------------------------
+double CFrameHistory::getMin() const
+{
+	if (_Count == 0) return 0.0;
+
+	double ret = _Frames[0].Total;
+	for (uint i = 1; i < _Count; ++i) {
+		ret = std::min(ret, _Frames[i].Total);
+	}
+	return ret;
+}
+
+//----------------------------------------------------------------------------
+double CFrameHistory::getMax() const
+{
+	double ret = 0.0;
+	for (uint i = 0; i < _Count; ++i) {
+		ret = std::max(ret, _Frames[i].Total);
+	}
+	return ret;
+}
+
+//----------------------------------------------------------------------------
+double CFrameHistory::getAvg() const
+{
+	if (_Count == 0) return 0.0;
+
+	double sum = 0.0;
+	for (uint i = 0; i < _Count; ++i) {
+		sum += _Frames[i].Total;
+	}
+	return sum / _Count;
+}
+
+//----------------------------------------------------------------------------
+double CFrameHistory::getPercentile(double p) const
+{
+	std::vector<double> sorted;
+	sorted.reserve(_Count);
+	for (uint i = 0; i < _Count; ++i) {
+		sorted.push_back(_Frames[i].Total);
+	}
+	std::sort(sorted.begin(), sorted.end());
+
+	return CRenderStats::percentile(sorted, p);
+}
+
+//----------------------------------------------------------------------------
+double CFrameHistory::getStageAvg(TFrameStage stage) const
+{
+	if (_Count == 0) return 0.0;
+
+	double sum = 0.0;
+	for (uint i = 0; i < _Count; ++i) {
+		sum += _Frames[i].Stage[stage];
+	}
+	return sum / _Count;
+}
@@ -0,0 +1,72 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef FRAME_HISTORY_H
+#define FRAME_HISTORY_H
+
+#include "nel/misc/types_nl.h"
+#include "nel/misc/time_nl.h"
+
+enum TFrameStage
+{
+	FrameRefresh = 0,
+	FrameRender,
+	FrameOverlay,
+	FrameSwap,
+	FrameStageCount
+};
+
+const char *getFrameStageName(TFrameStage stage);
+
+// rolling frame times for interactive mode, sleep after frame is not counted
+class CFrameHistory
+{
+public:
+	enum
+	{
+		MaxFrames = 256
+	};
+
+	CFrameHistory();
+
+	void beginFrame();
+	// call before any slowdown sleep
+	void endFrame();
+	void addStageTime(TFrameStage stage, double seconds);
+
+	// frames in buffer
+	uint size() const { return _Count; }
+	// i == 0 is oldest frame, seconds
+	double getFrame(uint i) const;
+	double getFrameStage(uint i, TFrameStage stage) const;
+
+	double getMin() const;
+	double getAvg() const;
+	double getMax() const;
+	double getPercentile(double p) const;
+	double getStageAvg(TFrameStage stage) const;
+
+private:
+	struct CFrame
+	{
+		double Total;
+		double Stage[FrameStageCount];
+	};
+
+	CFrame _Frames[MaxFrames];
+	// next write position
+	uint _Head;
+	uint _Count;
+
+	NLMISC::TTicks _FrameStart;
+	CFrame _Current;
+};
+
+#endif
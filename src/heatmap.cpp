@@ -0,0 +1,167 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#include "nel/misc/bitmap.h"
+#include "nel/misc/debug.h"
+#include "nel/misc/file.h"
+#include "nel/misc/rgba.h"
+
+#include "heatmap.h"
+
+using namespace NLMISC;
+
+static const char *metricNames[HeatmapMetricCount] = {
+	"render",
+	"triangles",
+	"meshes",
+	"zones",
+	"readback",
+};
+
+// blue -> cyan -> green -> yellow -> red
+static CRGBA getHeatColor(float t)
+{
+	static const CRGBA ramp[] = {
+		CRGBA(0, 0, 255),
+		CRGBA(0, 255, 255),
+		CRGBA(0, 255, 0),
+		CRGBA(255, 255, 0),
+		CRGBA(255, 0, 0),
+	};
+	const uint last = sizeof(ramp) / sizeof(ramp[0]) - 1;
+
+	t = std::max(0.f, std::min(1.f, t)) * last;
+	uint i = std::min(last - 1, (uint)t);
+	float f = t - i;
+
+	CRGBA ret;
+	ret.blendFromui(ramp[i], ramp[i + 1], (uint)(f * 256));
+	ret.A = 200;
+	return ret;
+}
+
+//----------------------------------------------------------------------------
+const char *getHeatmapMetricName(THeatmapMetric metric)
+{
+	if (metric >= HeatmapMetricCount) return "unknown";
+	return metricNames[metric];
+}
+
+//----------------------------------------------------------------------------
+bool getHeatmapMetricFromName(const std::string &name, THeatmapMetric &metric)
+{
+	for (uint i = 0; i < HeatmapMetricCount; ++i) {
+		if (name == metricNames[i]) {
+			metric = (THeatmapMetric)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------------
+double getHeatmapValue(const CRenderStats::CTileSample &tile, THeatmapMetric metric)
+{
+	switch (metric) {
+	case HeatmapRender:
+		return tile.StageTime[StageRender] + tile.StageTime[StageInverseZ] + tile.StageTime[StageFxaa];
+	case HeatmapTriangles:
+		return tile.Triangles;
+	case HeatmapMeshes:
+		return tile.Meshes;
+	case HeatmapZones:
+		return tile.Memory.Zones;
+	case HeatmapReadback:
+		return tile.StageTime[StageReadback];
+	default:
+		return 0.0;
+	}
+}
+
+//----------------------------------------------------------------------------
+bool writeHeatmapCsv(const std::string &filename, const CRenderStats &stats)
+{
+	std::ofstream out(filename.c_str());
+	if (!out.is_open()) {
+		nlwarning("failed to open '%s' for writing", filename.c_str());
+		return false;
+	}
+
+	out << std::fixed << std::setprecision(3);
+	out << "x,y,render_ms,triangles,meshes,zones,readback_ms\n";
+	for (const auto &tile : stats.getTiles()) {
+		out << tile.X << "," << tile.Y
+		    << "," << getHeatmapValue(tile, HeatmapRender) * 1000.0
+		    << "," << tile.Triangles
+		    << "," << tile.Meshes
+		    << "," << tile.Memory.Zones
+		    << "," << getHeatmapValue(tile, HeatmapReadback) * 1000.0
+		    << "\n";
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------------
+bool writeHeatmapPng(const std::string &filename, const CRenderStats &stats, THeatmapMetric metric,
+    uint mapWidth, uint mapHeight, uint tileWidth, uint tileHeight, uint downscale)
+{
+	const auto &tiles = stats.getTiles();
+	if (tiles.empty() || tileWidth == 0 || tileHeight == 0) {
+		return false;
+	}
+	downscale = std::max(1u, downscale);
+
+	// p99 as top of the scale, so single slow tile does not flatten everything else
+	std::vector<double> values;
+	values.reserve(tiles.size());
+	for (const auto &tile : tiles) {
+		values.push_back(getHeatmapValue(tile, metric));
+	}
+	std::sort(values.begin(), values.end());
+	double top = CRenderStats::percentile(values, 99);
+	if (top <= 0) {
+		top = 1;
+	}
+
+	uint width = (mapWidth + downscale - 1) / downscale;
+	uint height = (mapHeight + downscale - 1) / downscale;
+
+	CBitmap btm;
+	btm.resize(width, height, CBitmap::RGBA);
+	CRGBA *pixels = (CRGBA *)&btm.getPixels()[0];
+
+	for (const auto &tile : tiles) {
+		CRGBA color = getHeatColor((float)(getHeatmapValue(tile, metric) / top));
+
+		uint x0 = tile.X * tileWidth / downscale;
+		uint y0 = tile.Y * tileHeight / downscale;
+		uint x1 = std::min(width, ((tile.X + 1) * tileWidth + downscale - 1) / downscale);
+		uint y1 = std::min(height, ((tile.Y + 1) * tileHeight + downscale - 1) / downscale);
+		for (uint y = y0; y < y1; ++y) {
+			for (uint x = x0; x < x1; ++x) {
+				pixels[y * width + x] = color;
+			}
+		}
+	}
+
+	COFile fs;
+	if (!fs.open(filename)) {
+		nlwarning("failed to open '%s' for writing", filename.c_str());
+		return false;
+	}
+	btm.writePNG(fs, 32);
+
+	return true;
+}
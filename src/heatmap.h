@@ -0,0 +1,43 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <string>
+
+#include "nel/misc/types_nl.h"
+
+#include "render_stats.h"
+
+enum THeatmapMetric
+{
+	HeatmapRender = 0,
+	HeatmapTriangles,
+	HeatmapMeshes,
+	HeatmapZones,
+	HeatmapReadback,
+	HeatmapMetricCount
+};
+
+const char *getHeatmapMetricName(THeatmapMetric metric);
+// 'render', 'triangles', ...; returns false if name is not known
+bool getHeatmapMetricFromName(const std::string &name, THeatmapMetric &metric);
+double getHeatmapValue(const CRenderStats::CTileSample &tile, THeatmapMetric metric);
+
+// per tile render complexity
+bool writeHeatmapCsv(const std::string &filename, const CRenderStats &stats);
+
+// tile values as colored blocks over transparent background, image is map size / downscale
+// so it can be stretched over the rendered map png
+bool writeHeatmapPng(const std::string &filename, const CRenderStats &stats, THeatmapMetric metric,
+    uint mapWidth, uint mapHeight, uint tileWidth, uint tileHeight, uint downscale);
+
+#endif
@@ -0,0 +1,287 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "nel/misc/common.h"
+#include "nel/misc/debug.h"
+
+#ifdef NL_OS_UNIX
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "job_server.h"
+#include "render_stats.h"
+
+using namespace NLMISC;
+
+//----------------------------------------------------------------------------
+CJobServer::CJobServer()
+    : _Listen(-1)
+    , _ReplyFd(-1)
+    , _Finished(false)
+    , _NextClient(1)
+    , _NextJobId(1)
+{
+}
+
+//----------------------------------------------------------------------------
+CJobServer::~CJobServer()
+{
+	close();
+}
+
+//----------------------------------------------------------------------------
+bool CJobServer::open(const std::string &target)
+{
+	close();
+	_Finished = false;
+
+#ifdef NL_OS_UNIX
+	if (target.empty() || target == "stdin" || target == "-") {
+		// keep stdout for replies, console messages go to stderr
+		fflush(stdout);
+		_ReplyFd = dup(STDOUT_FILENO);
+		if (_ReplyFd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+			nlwarning("failed to redirect stdout: %s", strerror(errno));
+			close();
+			return false;
+		}
+		_Clients[0] = { STDIN_FILENO, "" };
+		return true;
+	}
+
+	if (target.compare(0, 5, "unix:") != 0) {
+		nlwarning("invalid job source '%s', use 'stdin' or 'unix:/path'", target.c_str());
+		return false;
+	}
+
+	std::string path = target.substr(5);
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+		nlwarning("invalid socket path '%s'", path.c_str());
+		return false;
+	}
+	strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+	_Listen = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (_Listen < 0) {
+		nlwarning("socket: %s", strerror(errno));
+		return false;
+	}
+
+	// stale socket from previous run, never remove anything else
+	struct stat st;
+	if (lstat(path.c_str(), &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			nlwarning("'%s' exists and is not a socket", path.c_str());
+			close();
+			return false;
+		}
+		unlink(path.c_str());
+	}
+	if (bind(_Listen, (sockaddr *)&addr, sizeof(addr)) < 0) {
+		nlwarning("'%s': %s", path.c_str(), strerror(errno));
+		close();
+		return false;
+	}
+	// only unlinked by close() once bound by us
+	_SocketPath = path;
+	if (listen(_Listen, 8) < 0) {
+		nlwarning("'%s': %s", path.c_str(), strerror(errno));
+		close();
+		return false;
+	}
+
+	nlinfo("waiting for jobs on '%s'", _SocketPath.c_str());
+	return true;
+#else
+	nlwarning("render daemon is only supported on unix");
+	return false;
+#endif
+}
+
+//----------------------------------------------------------------------------
+void CJobServer::close()
+{
+#ifdef NL_OS_UNIX
+	for (auto &it : _Clients) {
+		if (it.first != 0) {
+			::close(it.second.Fd);
+		}
+	}
+	if (_Listen >= 0) {
+		::close(_Listen);
+		if (!_SocketPath.empty()) {
+			unlink(_SocketPath.c_str());
+		}
+	}
+	if (_ReplyFd >= 0) {
+		fflush(stdout);
+		dup2(_ReplyFd, STDOUT_FILENO);
+		::close(_ReplyFd);
+	}
+#endif
+	_Clients.clear();
+	_Listen = -1;
+	_ReplyFd = -1;
+	_SocketPath.clear();
+}
+
+//----------------------------------------------------------------------------
+void CJobServer::poll(std::deque<CRenderJob> &queue, sint timeout)
+{
+#ifdef NL_OS_UNIX
+	std::vector<pollfd> fds;
+	std::vector<uint> ids;
+	if (_Listen >= 0) {
+		fds.push_back({ _Listen, POLLIN, 0 });
+		ids.push_back(0);
+	}
+	for (const auto &it : _Clients) {
+		fds.push_back({ it.second.Fd, POLLIN, 0 });
+		ids.push_back(it.first);
+	}
+	if (fds.empty()) {
+		_Finished = true;
+		return;
+	}
+
+	if (::poll(&fds[0], fds.size(), timeout) <= 0) {
+		return;
+	}
+
+	for (uint i = 0; i < fds.size(); ++i) {
+		if (!fds[i].revents) continue;
+
+		if (fds[i].fd == _Listen) {
+			acceptClient();
+			continue;
+		}
+
+		auto it = _Clients.find(ids[i]);
+		if (it != _Clients.end() && !readClient(it->first, it->second, queue)) {
+			if (it->first == 0) {
+				// stdin closed, finish queued jobs and quit
+				_Finished = true;
+			} else {
+				::close(it->second.Fd);
+			}
+			_Clients.erase(it);
+		}
+	}
+#endif
+}
+
+//----------------------------------------------------------------------------
+void CJobServer::acceptClient()
+{
+#ifdef NL_OS_UNIX
+	sint fd = accept(_Listen, nullptr, nullptr);
+	if (fd < 0) {
+		nlwarning("accept: %s", strerror(errno));
+		return;
+	}
+	_Clients[_NextClient++] = { fd, "" };
+#endif
+}
+
+//----------------------------------------------------------------------------
+bool CJobServer::readClient(uint client, CClient &c, std::deque<CRenderJob> &queue)
+{
+#ifdef NL_OS_UNIX
+	char buf[4096];
+	ssize_t n = read(c.Fd, buf, sizeof(buf));
+	if (n <= 0) {
+		if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+			return true;
+		}
+		// last line without newline
+		if (!c.Buffer.empty()) {
+			handleLine(client, c.Buffer, queue);
+			c.Buffer.clear();
+		}
+		return false;
+	}
+	c.Buffer.append(buf, n);
+
+	std::string::size_type pos;
+	while ((pos = c.Buffer.find('\n')) != std::string::npos) {
+		std::string line = c.Buffer.substr(0, pos);
+		c.Buffer.erase(0, pos + 1);
+		handleLine(client, line, queue);
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+//----------------------------------------------------------------------------
+void CJobServer::handleLine(uint client, const std::string &line, std::deque<CRenderJob> &queue)
+{
+	std::string trimmed = trim(line);
+	if (trimmed.empty() || trimmed[0] == '#') return;
+
+	CRenderJob job;
+	std::string error;
+	if (!parseRenderJob(trimmed, job, error)) {
+		reply(client, toString("{\"event\":\"failed\",\"id\":\"%s\",\"error\":\"%s\"}",
+		    CRenderStats::jsonEscape(job.Id).c_str(), CRenderStats::jsonEscape(error).c_str()));
+		return;
+	}
+
+	if (job.Id.empty()) {
+		job.Id = toString(_NextJobId++);
+	}
+	job.Client = client;
+	queue.push_back(job);
+
+	reply(client, toString("{\"event\":\"queued\",\"id\":\"%s\",\"queue\":%u}",
+	    CRenderStats::jsonEscape(job.Id).c_str(), (uint)queue.size()));
+}
+
+//----------------------------------------------------------------------------
+void CJobServer::reply(uint client, const std::string &line)
+{
+#ifdef NL_OS_UNIX
+	sint fd = -1;
+	if (client == 0) {
+		fd = _ReplyFd;
+	} else {
+		auto it = _Clients.find(client);
+		if (it != _Clients.end()) {
+			fd = it->second.Fd;
+		}
+	}
+	if (fd < 0) return;
+
+	std::string data = line + "\n";
+	const char *ptr = data.c_str();
+	size_t left = data.size();
+	while (left > 0) {
+		// client may have gone away, no SIGPIPE
+		ssize_t n = client == 0 ? write(fd, ptr, left) : send(fd, ptr, left, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) break;
+		ptr += n;
+		left -= n;
+	}
+#endif
+}
@@ -0,0 +1,71 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef JOB_SERVER_H
+#define JOB_SERVER_H
+
+#include <deque>
+#include <map>
+#include <string>
+
+#include "nel/misc/types_nl.h"
+
+#include "render_job.h"
+
+// reads json line jobs from stdin or unix socket clients,
+// replies are json lines to stdout or to the client that sent the job,
+// in stdin mode other stdout output is moved to stderr
+//
+// {"event":"queued","id":"1","queue":2}
+// {"event":"started","id":"1","map":"fyros"}
+// {"event":"done","id":"1","map":"fyros","output":"out/fyros.png","elapsed":12.5,"warm":true}
+// {"event":"failed","id":"1","error":"continent not found"}
+class CJobServer
+{
+public:
+	CJobServer();
+	~CJobServer();
+
+	// 'stdin' or 'unix:/path/to/socket'
+	bool open(const std::string &target);
+	void close();
+
+	// wait up to timeout ms (-1 forever) for input, complete lines go into queue
+	void poll(std::deque<CRenderJob> &queue, sint timeout);
+	// stdin closed (socket server never finishes by itself)
+	bool isFinished() const { return _Finished; }
+
+	// reply to client that sent the job, dropped if client is gone
+	void reply(uint client, const std::string &line);
+
+private:
+	struct CClient
+	{
+		sint Fd;
+		std::string Buffer;
+	};
+
+	void acceptClient();
+	// false when client closed connection
+	bool readClient(uint client, CClient &c, std::deque<CRenderJob> &queue);
+	void handleLine(uint client, const std::string &line, std::deque<CRenderJob> &queue);
+
+	sint _Listen;
+	// original stdout in stdin mode, only replies are written there
+	sint _ReplyFd;
+	std::string _SocketPath;
+	bool _Finished;
+	uint _NextClient;
+	uint _NextJobId;
+	// 0 is stdin/stdout
+	std::map<uint, CClient> _Clients;
+};
+
+#endif
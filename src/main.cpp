@@ -16,6 +16,7 @@
 #include "nel/misc/path.h"
 
 #include "map_renderer.h"
+#include "zone_id.h"
 
 using namespace NLMISC;
 
@@ -40,18 +41,23 @@ int main(int argc, char **argv)
 
 	args.addArg("", "outdir", "dir", "Output directory to save rendered maps");
 	args.addArg("", "inverse-z", "", "Use Inverse Z-Buffer test for rendering (useful for prime roots)");
+	args.addArg("", "inverse-z-always", "", "Render inverse Z passes on every tile, by default tiles without geometry above camera skip them");
 	args.addArg("", "no-trees", "", "Try to avoid rendering trees (useful for zorai/matis/etc)");
 	args.addArg("", "fxaa", "", "Enable FXAA");
+	args.addArg("", "ssaa", "2|4", "Render tiles at 2x or 4x size and downsample instead of FXAA (headless only)");
 	args.addArg("", "pacs", "0,1,2,..", "Render PACS borders. Optional command separated id for filters (show all by default)");
 
 	args.addArg("", "grid", "", "show tile grid");
 	args.addArg("", "grid-names", "", "show tile grid names");
+	args.addArg("", "overlay-layers", "", "Rasterize pacs/grid overlays into separate transparent png layers");
+	args.addArg("", "overlays-only", "", "Only write overlay layers, skip terrain render");
 
 	args.addArg("", "list-maps", "", "list ingame maps from ryzom.world");
 	args.addArg("", "list-continents", "", "list ingame map continents from ryzom.world");
 
 	args.addArg("", "znear", "-1000", "camera frustum z-near");
 	args.addArg("", "zfar", "1000", "camera frustum z-far");
+	args.addArg("", "no-tight-depth", "", "Use fixed znear/zfar on every tile instead of range from zone and ig bounds");
 
 	args.addArg("", "vision", "500", "landscape vision in meters (radius)");
 	args.addArg("", "tilenear", "50", "landscape tile near in meters (radius)");
@@ -65,12 +71,44 @@ int main(int argc, char **argv)
 	args.addArg("", "render-continents", "", "Render all from --list-continents");
 
 	args.addArg("", "season", "sp|su|au|wi", "Season to use");
+	args.addArg("", "memory-budget", "MB", "Evict caches and stream png rows when resident memory would go over budget");
+	args.addArg("", "band-streaming", "", "Always write png row by row instead of keeping full map in memory");
+	args.addArg("", "static-map", "", "Skip per frame simulation (veget wind and relight, coarse mesh lighting updates, per tile animate) for top-down map renders");
+	args.addArg("", "headless", "", "Render into offscreen target from hidden window, no event pump (auto render, benchmark, screenshot). Still needs an X server, use Xvfb on display-less hosts");
+	args.addArg("", "tile-size", "N|WxH", "Screenshot tile size in pixels (default 800), headless mode allows up to 8192");
+	args.addArg("", "plan", "", "Print tiles, zones, peak memory, output size and estimated time for maps to render, no gpu needed");
+	args.addArg("", "lod-bias", "x|auto", "Coarser landscape tessellation and veget at low scale, higher is coarser, 0 is full quality. Default 'auto' uses largest bias that --auto-tune found close to full quality render, full quality without tuning");
+	args.addArg("", "preview", "only", "Write coarse <map>.preview.png stages (far bank, no igs, large tiles) before full render, which refines it as tile rows complete, 'only' skips full render");
+	args.addArg("", "resume", "", "Keep finished tiles in <outdir>/<map>.checkpoint, continue interrupted renders and skip maps that are already done");
+	args.addArg("", "jobs", "N", "Render maps in N parallel worker processes, largest maps first (needs --headless)");
+	args.addArg("", "heatmap", "render|triangles|meshes|zones|readback", "Write per tile complexity <map>.heatmap.csv and .heatmap.png colored by metric (default render)");
+	args.addArg("", "daemon", "stdin|unix:/path", "Keep renderer warm and render json line jobs (map, season, scale, region, overlays, output) until stdin closes or 'quit'");
+	args.addArg("", "tile-server", "[host:]port", "Serve /{z}/{x}/{y}.png world tiles over http (zoom 6-11), missing tiles are rendered on request");
+	args.addArg("", "tile-cache", "dir", "Disk cache directory for tile server (default <outdir>/tiles), tiles go into <dir>/<settings hash>");
+	args.addArg("", "auto-tune", "", "Find smallest seam free vision, tilenear and tile size for continents of maps to render, saved into <outdir>/autotune and used by later renders");
+	args.addArg("", "world", "", "Render all continents into one sparse z/x/y tile pyramid in <outdir>/world/<season>, continents with unchanged settings are reused");
+	args.addArg("", "progress", "stderr|stdout|fd:N|file", "Write json lines progress events (tiles, elapsed, eta) for batch renders (default stderr, stdout is shared with messages)");
+	args.addArg("", "trace", "", "Also write chrome://tracing json next to timing report of auto rendered maps, waits for gpu after each render stage");
 	args.addArg("", "perf", "x", "Only render X frame(s) and then quit");
+	args.addArg("", "benchmark", "all|pyr,pyr_region,..", "Replay benchmark camera paths and regions, write benchmark.json/.csv into outdir and quit");
+	args.addArg("", "benchmark-baseline", "benchmark.csv", "Compare benchmark to saved results, exit with error on regression");
+	args.addArg("", "benchmark-tolerance", "10", "Allowed p50 frame time regression in percent");
+	args.addArg("", "bench-zone-ids", "x", "Run zone name/id lookup microbenchmark for X iterations and quit");
 
 	if (!args.parse(argc, argv)) {
 		return EXIT_FAILURE;
 	}
 
+	if (args.haveLongArg("bench-zone-ids")) {
+		uint nr;
+		std::vector<std::string> val = args.getLongArg("bench-zone-ids");
+		if (val.empty() || !fromString(val.front(), nr)) {
+			nr = 100;
+		}
+		benchZoneIds(nr);
+		return EXIT_SUCCESS;
+	}
+
 	// --------------------------------------------------------------------------
 	// default values from config
 	if (args.haveLongArg("config")) {
@@ -98,13 +136,141 @@ int main(int argc, char **argv)
 	if (args.haveLongArg("inverse-z")) {
 		render.setInverseZ(true);
 	}
+	if (args.haveLongArg("inverse-z-always")) {
+		render.setInverseZ(true);
+		render.setInverseZAuto(false);
+	}
 	if (args.haveLongArg("no-trees")) {
 		render.setHideTrees(true);
 	}
+	if (args.haveLongArg("ssaa")) {
+		uint factor = 0;
+		if (args.getLongArg("ssaa").empty() || !fromString(args.getLongArg("ssaa").front(), factor) || (factor != 2 && factor != 4)) {
+			std::cout << "ERR: --ssaa requires factor 2 or 4" << std::endl;
+			return EXIT_FAILURE;
+		}
+		render.setSupersample(factor);
+	}
 	if (args.haveLongArg("fxaa")) {
 		render.setFxaa(true);
 	}
 
+	if (args.haveLongArg("memory-budget")) {
+		uint mb = 0;
+		if (args.getLongArg("memory-budget").empty() || !fromString(args.getLongArg("memory-budget").front(), mb)) {
+			std::cout << "ERR: --memory-budget requires size in MB" << std::endl;
+			return EXIT_FAILURE;
+		}
+		render.setMemoryBudget(mb);
+	}
+	if (args.haveLongArg("band-streaming")) {
+		render.setBandStreaming(true);
+	}
+	if (args.haveLongArg("static-map")) {
+		render.setStaticMap(true);
+	}
+	if (args.haveLongArg("headless")) {
+		render.setHeadless(true);
+	}
+	if (args.haveLongArg("tile-size")) {
+		std::vector<std::string> size;
+		if (!args.getLongArg("tile-size").empty()) {
+			splitString(args.getLongArg("tile-size").front(), "x", size);
+		}
+		uint width = 0;
+		uint height = 0;
+		if (size.empty() || size.size() > 2 || !fromString(size.front(), width) || !fromString(size.back(), height) || width == 0 || height == 0) {
+			std::cout << "ERR: --tile-size requires size as 'N' or 'WxH'" << std::endl;
+			return EXIT_FAILURE;
+		}
+		render.setTileSize(width, height);
+	}
+
+	if (args.haveLongArg("plan")) {
+		render.setPlan(true);
+	}
+
+	if (args.haveLongArg("lod-bias")) {
+		float bias = -1.f;
+		if (args.getLongArg("lod-bias").empty()
+		    || (args.getLongArg("lod-bias").front() != "auto" && (!fromString(args.getLongArg("lod-bias").front(), bias) || bias < 0.f))) {
+			std::cout << "ERR: --lod-bias requires non-negative number or 'auto'" << std::endl;
+			return EXIT_FAILURE;
+		}
+		render.setLodBias(bias);
+	}
+
+	if (args.haveLongArg("preview")) {
+		bool only = !args.getLongArg("preview").empty() && args.getLongArg("preview").front() == "only";
+		render.setPreview(only);
+	}
+
+	if (args.haveLongArg("resume")) {
+		render.setResume(true);
+	}
+
+	if (args.haveLongArg("jobs")) {
+		uint jobs = 0;
+		if (args.getLongArg("jobs").empty() || !fromString(args.getLongArg("jobs").front(), jobs) || jobs == 0) {
+			std::cout << "ERR: --jobs requires number of worker processes" << std::endl;
+			return EXIT_FAILURE;
+		}
+		render.setJobs(jobs);
+	}
+
+	if (args.haveLongArg("heatmap")) {
+		THeatmapMetric metric = HeatmapRender;
+		if (!args.getLongArg("heatmap").empty() && !getHeatmapMetricFromName(args.getLongArg("heatmap").front(), metric)) {
+			std::cout << "ERR: unknown heatmap metric '" << args.getLongArg("heatmap").front() << "'" << std::endl;
+			return EXIT_FAILURE;
+		}
+		render.setHeatmap(metric);
+	}
+
+	if (args.haveLongArg("daemon")) {
+		std::string source = "stdin";
+		if (!args.getLongArg("daemon").empty()) {
+			source = args.getLongArg("daemon").front();
+		}
+		render.setDaemon(source);
+	}
+
+	if (args.haveLongArg("tile-server")) {
+		std::string address = "8080";
+		if (!args.getLongArg("tile-server").empty()) {
+			address = args.getLongArg("tile-server").front();
+		}
+		render.setTileServer(address);
+	}
+
+	if (args.haveLongArg("tile-cache") && !args.getLongArg("tile-cache").empty()) {
+		render.setTileCacheDirectory(args.getLongArg("tile-cache").front());
+	}
+
+	if (args.haveLongArg("auto-tune")) {
+		render.setAutoTune(true);
+	}
+
+	if (args.haveLongArg("world")) {
+		render.setWorld(true);
+	}
+
+	if (args.haveLongArg("progress")) {
+		// stdout also carries console messages
+		std::string target = "stderr";
+		if (!args.getLongArg("progress").empty()) {
+			target = args.getLongArg("progress").front();
+		}
+		if (!render.setProgress(target)) {
+			std::cout << "ERR: cannot open progress stream '" << target << "'" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (args.haveLongArg("trace")) {
+		render.setTrace(true);
+	}
+
 	if (args.haveLongArg("perf")) {
 		uint nr;
 		std::vector<std::string> val = args.getLongArg("perf");
@@ -114,6 +280,29 @@ int main(int argc, char **argv)
 		render.setPerf(nr);
 	}
 
+	if (args.haveLongArg("benchmark")) {
+		std::vector<std::string> filter;
+		if (!args.getLongArg("benchmark").empty() && args.getLongArg("benchmark").front() != "all") {
+			splitString(args.getLongArg("benchmark").front(), ",", filter);
+		}
+
+		std::string baseline;
+		if (args.haveLongArg("benchmark-baseline")) {
+			if (args.getLongArg("benchmark-baseline").empty()) {
+				std::cout << "ERR: --benchmark-baseline requires csv filename" << std::endl;
+				return EXIT_FAILURE;
+			}
+			baseline = args.getLongArg("benchmark-baseline").front();
+		}
+
+		float tolerance = 10.f;
+		if (args.haveLongArg("benchmark-tolerance") && !args.getLongArg("benchmark-tolerance").empty()) {
+			fromString(args.getLongArg("benchmark-tolerance").front(), tolerance);
+		}
+
+		render.setBenchmark(filter, baseline, tolerance);
+	}
+
 	if (args.haveLongArg("vision")) {
 		if (!args.getLongArg("vision").empty()) {
 			uint nr = 0;
@@ -141,6 +330,9 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (args.haveLongArg("no-tight-depth")) {
+		render.setTightDepth(false);
+	}
 	if (args.haveLongArg("zfar")) {
 		if (!args.getLongArg("zfar").empty()) {
 			float nr = 0;
@@ -200,6 +392,10 @@ int main(int argc, char **argv)
 		render.setGrid(args.haveLongArg("grid"), args.haveLongArg("grid-names"));
 	}
 
+	if (args.haveLongArg("overlay-layers") || args.haveLongArg("overlays-only")) {
+		render.setOverlayLayers(args.haveLongArg("overlay-layers"), args.haveLongArg("overlays-only"));
+	}
+
 	if (args.haveLongArg("pacs")) {
 		std::vector<uint> ids { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
 		if (!args.getLongArg("pacs").empty()) {
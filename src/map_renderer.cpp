@@ -8,17 +8,41 @@
  * file that was distributed with this source code.
  */
 
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <iomanip>
+#include <set>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#ifdef NL_OS_UNIX
+#include <csignal>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 //
 #include "map_renderer.h"
+#include "benchmark.h"
+#include "heatmap.h"
+#include "job_server.h"
+#include "overlay_rasterizer.h"
+#include "png_band_writer.h"
+#include "render_checkpoint.h"
+#include "render_tuning.h"
+#include "supersample.h"
+#include "tile_server.h"
+#include "zone_id.h"
 
 #include "nel/3d/fxaa.h"
 #include "nel/3d/instance_group_user.h"
+#include "nel/3d/landscape_user.h"
 #include "nel/3d/material.h"
 #include "nel/3d/scene_group.h"
 #include "nel/3d/scene_user.h"
+#include "nel/3d/shape.h"
 #include "nel/3d/u_3d_mouse_listener.h"
 #include "nel/3d/u_camera.h"
 #include "nel/3d/u_driver.h"
@@ -28,12 +52,16 @@
 #include "nel/3d/u_scene.h"
 #include "nel/3d/u_text_context.h"
 #include "nel/3d/text_context_user.h"
+#include "nel/3d/patch.h"
+#include "nel/3d/zone.h"
 #include "nel/misc/aabbox.h"
 #include "nel/misc/algo.h"
 #include "nel/misc/config_file.h"
 #include "nel/misc/file.h"
+#include "nel/misc/mem_stream.h"
 #include "nel/misc/path.h"
 #include "nel/misc/progress_callback.h"
+#include "nel/misc/rect.h"
 #include "nel/pacs/u_global_retriever.h"
 #include "nel/pacs/u_move_container.h"
 #include "nel/pacs/u_move_primitive.h"
@@ -48,14 +76,80 @@ using namespace NLMISC;
 using namespace NLPACS;
 using namespace EGSPD;
 
-// nel zone tile width/height (AA_01.zonel) in meters
-#define ZONE_TILE_WH 160
-#define ZONE_MAX_X 26 * 26 * ZONE_TILE_WH // AA-ZZ == 108160
-#define ZONE_MAX_Y 256 * ZONE_TILE_WH
-
 // world image
 static const uint staticWI = 0;
 
+// window size, also the tile size for auto render
+static const uint defaultWindowWH = 800;
+// offscreen target size limit, fbo/texture size on most gl drivers (llvmpipe included)
+static const uint maxTileWH = 8192;
+// meters added around zone/ig bounds for per tile depth range
+static const float depthMargin = 10.f;
+// tile server zoom levels, 6 is 1:8 (autoRender scale limit), 11 is 4:1
+static const uint tileMinZoom = 6;
+static const uint tileMaxZoom = 11;
+// headless preview tile limit, few large tiles instead of many small ones
+static const uint previewTileWH = 4096;
+// seconds between preview writes during full render
+static const double previewWriteInterval = 2.0;
+
+// lod bias 1: far bank textures only below this px:m
+static const float farBankMaxScale = 0.5f;
+// lod bias 1: no micro vegetation below this px:m
+static const float vegetableMinScale = 0.25f;
+
+// auto tune: pixels next to tile border checked for seams, allowed share of differing pixels
+static const uint tuneSeamBand = 2;
+static const float tuneMaxDiff = 0.001f;
+// auto lod bias: candidates from coarse to fine, allowed share of pixels that differ from full quality
+static const float tuneLodBiases[] = { 4.f, 2.f, 1.f };
+static const float tuneLodMaxDiff = 0.01f;
+
+// preview stages from coarse to fine, full render follows them
+struct CPreviewStage
+{
+	// fraction of final scale
+	float Scale;
+	// tessellation threshold, higher is coarser
+	float Threshold;
+	// tile near 0 textures whole landscape from far bank
+	bool FarBank;
+	bool IGs;
+};
+static const CPreviewStage previewStages[] = {
+	{ 0.25f, 0.01f, true, false },
+	{ 0.5f, 0.001f, false, true },
+};
+
+//----------------------------------------------------------------------------
+// pacs edge type to color
+static CRGBA getPacsEdgeColor(uint8 type)
+{
+	switch (type) {
+	// Block
+	case 0:
+		return CRGBA::Red;
+	// Surmountable
+	case 1:
+		return CRGBA::Green;
+	// Link
+	case 2:
+		return CRGBA::Yellow;
+	// Waterline
+	case 3:
+		return CRGBA::Blue;
+	// Exterior
+	case 4:
+		return CRGBA::Magenta;
+	// Exterior door
+	case 5:
+		return CRGBA(127, 127, 127);
+	// Unknown
+	default:
+		return CRGBA(255, 100, 100);
+	}
+}
+
 struct KeyBindingRec
 {
 	std::string id;
@@ -136,6 +230,10 @@ CMapRenderer::CMapRenderer()
 	_LandscapeVision = 0;
 	_LandscapeThreshold = 0.0f;
 	_TileNearLocked = false;
+	_TileSizeLocked = false;
+	_RenderThreshold = 0.00005f;
+	_LodBias = -1.f;
+	_SkipIGs = false;
 
 	_Padding = 0;
 
@@ -145,6 +243,7 @@ CMapRenderer::CMapRenderer()
 	_FontName = "ryzom.ttf";
 
 	_ActiveContinent = nullptr;
+	_VillagesInScene = 0;
 	_RetrieverBank = nullptr;
 	_GlobalRetriever = nullptr;
 	_PACS = nullptr;
@@ -152,13 +251,43 @@ CMapRenderer::CMapRenderer()
 	_ZoneMax = CVector2f(0.f, 0.f);
 
 	_InverseZ = false;
+	_InverseZAuto = true;
+	_TightDepth = true;
 	_FrameDelta = 0.0;
 	_SlowDown = true;
 	_UseLight = false;
 	_FrameLimit = 0;
+	_Benchmark = false;
+	_MemoryBudget = 0;
+	_EvictionRss = 0;
+	_BandStreaming = false;
+	_StaticMap = false;
+	_Headless = false;
+	_TileWidth = defaultWindowWH;
+	_TileHeight = defaultWindowWH;
+	_Heatmap = false;
+	_HeatmapMetric = HeatmapRender;
+	_Resume = false;
+	_Plan = false;
+	_Preview = false;
+	_PreviewOnly = false;
+	_PreviewWritten = 0;
+	_World = false;
+	_OutpostRuinsIG = "gen_bt_ruines.ig";
+	_Supersample = 1;
+	_AutoTune = false;
+	_ForcedVision = 0;
+	_Jobs = 1;
+	_WorkerIn = -1;
+	_WorkerOut = -1;
+	_TileCacheMemory = 256 << 20;
+	_TileCacheDisk = (uint64)2048 << 20;
+	_BenchmarkTolerance = 10.f;
 
 	_DrawGrid = false;
 	_DrawGridNames = false;
+	_OverlayLayers = false;
+	_OverlayLayersOnly = false;
 
 	_DrawPacs = false;
 	_PacsFilter = { true, false, true, false, false, false };
@@ -199,6 +328,7 @@ void CMapRenderer::setSeason(const std::string &season)
 void CMapRenderer::release()
 {
 	unloadContinent();
+	_ShapeBounds.clear();
 
 	if (!sceneMaterial.empty()) {
 		driver->deleteMaterial(sceneMaterial);
@@ -208,6 +338,7 @@ void CMapRenderer::release()
 		driver->deleteMaterial(pacsMaterial);
 	}
 
+	_GridLabels.clear();
 	if (text) {
 		driver->deleteTextContext(text);
 		text = nullptr;
@@ -294,6 +425,7 @@ void CMapRenderer::loadSheets()
 	exts.emplace_back("world");
 	exts.emplace_back("continent");
 
+	CStageTimer timer(_Stats, StageSheets);
 	IProgressCallback callback;
 	SheetMngr.loadAllSheet(callback, false, false, false, false, &exts);
 }
@@ -364,6 +496,91 @@ void CMapRenderer::loadConfig(const std::string &cfgFilename)
 	if (var) {
 		_Padding = var->asInt();
 	}
+
+	var = cf.getVarPtr("MemoryBudget");
+	if (var) {
+		setMemoryBudget(var->asInt());
+	}
+
+	var = cf.getVarPtr("BandStreaming");
+	if (var) {
+		_BandStreaming = var->asBool();
+	}
+
+	var = cf.getVarPtr("InverseZAuto");
+	if (var) {
+		_InverseZAuto = var->asBool();
+	}
+
+	var = cf.getVarPtr("TightDepth");
+	if (var) {
+		_TightDepth = var->asBool();
+	}
+
+	var = cf.getVarPtr("StaticMap");
+	if (var) {
+		_StaticMap = var->asBool();
+	}
+
+	var = cf.getVarPtr("Headless");
+	if (var) {
+		_Headless = var->asBool();
+	}
+
+	// coarser landscape at low scale, 0 renders full quality at every scale, negative is auto
+	var = cf.getVarPtr("LodBias");
+	if (var) {
+		_LodBias = var->asFloat() < 0.f ? -1.f : var->asFloat();
+	}
+
+	// ssaa factor, headless only
+	var = cf.getVarPtr("Supersample");
+	if (var) {
+		_Supersample = var->asInt();
+		if (_Supersample != 1 && _Supersample != 2 && _Supersample != 4) {
+			nlwarning("Supersample should be 1, 2 or 4");
+			_Supersample = 1;
+		}
+	}
+
+	// outpost building .ig files
+	var = cf.getVarPtr("OutpostRuinsIG");
+	if (var) {
+		_OutpostRuinsIG = var->asString();
+	}
+
+	var = cf.getVarPtr("OutpostConstructionIG");
+	if (var) {
+		_OutpostConstructionIG = var->asString();
+	}
+
+	var = cf.getVarPtr("Jobs");
+	if (var) {
+		_Jobs = var->asInt();
+	}
+
+	// tile server cache limits in MB
+	var = cf.getVarPtr("TileCacheMemory");
+	if (var) {
+		_TileCacheMemory = (uint64)var->asInt() << 20;
+	}
+
+	var = cf.getVarPtr("TileCacheDisk");
+	if (var) {
+		_TileCacheDisk = (uint64)var->asInt() << 20;
+	}
+
+	var = cf.getVarPtr("TileCacheDir");
+	if (var) {
+		_TileCacheDirectory = var->asString();
+	}
+
+	// single value for square tile, or width, height
+	var = cf.getVarPtr("TileSize");
+	if (var) {
+		_TileWidth = var->asInt(0);
+		_TileHeight = var->size() > 1 ? var->asInt(1) : _TileWidth;
+	}
 }
 //----------------------------------------------------------------------------
 float CMapRenderer::parseScale(const std::string &val)
@@ -505,12 +722,12 @@ bool CMapRenderer::getContinentFromCoords(float x, float y, std::string &name, C
 }
 
 //----------------------------------------------------------------------------
-bool CMapRenderer::loadContinent(std::string name)
+bool CMapRenderer::getMapArea(std::string name, std::string &continent, std::string &mapName, CVector2f &minPos, CVector2f &maxPos) const
 {
 	sint xmin, xmax, ymin, ymax;
 	bool hasCoords = false;
 
-	_MapName = name;
+	mapName = name;
 
 	//------------------------------------------------------------------------
 	const CWorldSheet *world = dynamic_cast<const CWorldSheet *>(SheetMngr.get(CSheetId("ryzom.world")));
@@ -526,10 +743,10 @@ bool CMapRenderer::loadContinent(std::string name)
 			ymin = std::min(cl.MinY, cl.MaxY);
 			ymax = std::max(cl.MinY, cl.MaxY);
 			// BitmapName = 'zorai_map.tga'
-			_MapName = CFile::getFilenameWithoutExtension(toLower(cl.BitmapName));
+			mapName = CFile::getFilenameWithoutExtension(toLower(cl.BitmapName));
 			// fallback if there is no ingame map texture
-			if (_MapName.empty()) {
-				_MapName = name;
+			if (mapName.empty()) {
+				mapName = name;
 			}
 			hasCoords = true;
 			// remap continent name
@@ -544,45 +761,72 @@ bool CMapRenderer::loadContinent(std::string name)
 	}
 
 	//------------------------------------------------------------------------
-	CEntitySheet *sheet = SheetMngr.get(CSheetId(name + ".continent"));
+	const CEntitySheet *sheet = SheetMngr.get(CSheetId(name + ".continent"));
 	if (!sheet || sheet->type() != CEntitySheet::CONTINENT) {
 		nlinfo("continent sheet not found or bad type (%s.continent)", name.c_str());
 		return false;
 	}
+	const CContinentSheet *cont = dynamic_cast<const CContinentSheet *>(sheet);
+	continent = name;
 
-	unloadContinent();
-
-	_ContinentSheet = name;
-	_ActiveContinent = dynamic_cast<CContinentSheet *>(sheet);
-
-	if (!getPosFromZoneName(_ActiveContinent->Continent.ZoneMin, _ZoneMin)) {
-		nlerror("failed to convert ZoneMin (%s) to xy for continent '%s'",
-		    _ActiveContinent->Continent.ZoneMin.c_str(), _ActiveContinent->Continent.Name.c_str());
+	CVector2f zoneMin, zoneMax;
+	if (!getPosFromZoneName(cont->Continent.ZoneMin, zoneMin)) {
+		nlwarning("failed to convert ZoneMin (%s) to xy for continent '%s'",
+		    cont->Continent.ZoneMin.c_str(), cont->Continent.Name.c_str());
 		return false;
 	}
 
-	if (!getPosFromZoneName(_ActiveContinent->Continent.ZoneMax, _ZoneMax)) {
-		nlerror("failed to convert ZoneMax (%s) to xy for continent '%s'",
-		    _ActiveContinent->Continent.ZoneMax.c_str(), _ActiveContinent->Continent.Name.c_str());
+	if (!getPosFromZoneName(cont->Continent.ZoneMax, zoneMax)) {
+		nlwarning("failed to convert ZoneMax (%s) to xy for continent '%s'",
+		    cont->Continent.ZoneMax.c_str(), cont->Continent.Name.c_str());
 		return false;
 	}
 
 	if (!hasCoords) {
-		xmin = std::min(_ZoneMin.x, _ZoneMax.x);
-		xmax = std::max(_ZoneMin.x, _ZoneMax.x) + ZONE_TILE_WH;
+		xmin = std::min(zoneMin.x, zoneMax.x);
+		xmax = std::max(zoneMin.x, zoneMax.x) + ZONE_TILE_WH;
 
-		ymin = std::min(_ZoneMin.y, _ZoneMax.y);
-		ymax = std::max(_ZoneMin.y, _ZoneMax.y) + ZONE_TILE_WH;
+		ymin = std::min(zoneMin.y, zoneMax.y);
+		ymax = std::max(zoneMin.y, zoneMax.y) + ZONE_TILE_WH;
 	}
-	nlinfo("continent(%s), map(%s), ZoneMin(%s), ZoneMax(%s), area(%d, %d)(%d,%d)\n", name.c_str(), _MapName.c_str(),
-	    _ActiveContinent->Continent.ZoneMin.c_str(), _ActiveContinent->Continent.ZoneMax.c_str(),
+	nlinfo("continent(%s), map(%s), ZoneMin(%s), ZoneMax(%s), area(%d, %d)(%d,%d)\n", name.c_str(), mapName.c_str(),
+	    cont->Continent.ZoneMin.c_str(), cont->Continent.ZoneMax.c_str(),
 	    xmin, ymin, xmax, ymax);
 
-	_ZoneMin = CVector2f(xmin - _Padding, ymin - (sint)_Padding);
-	_ZoneMax = CVector2f(xmax + _Padding, ymax + (sint)_Padding);
+	minPos = CVector2f(xmin - _Padding, ymin - (sint)_Padding);
+	maxPos = CVector2f(xmax + _Padding, ymax + (sint)_Padding);
+	return true;
+}
+
+//----------------------------------------------------------------------------
+bool CMapRenderer::loadContinent(std::string name)
+{
+	std::string continent;
+	CVector2f minPos, maxPos;
+	if (!getMapArea(name, continent, _MapName, minPos, maxPos)) {
+		return false;
+	}
+
+	CEntitySheet *sheet = SheetMngr.get(CSheetId(continent + ".continent"));
+
+	// zones, igs and pacs stay loaded for maps on same continent and season (daemon jobs)
+	bool warm = _ActiveContinent && _ActiveContinent == sheet && _LoadedSeason == _Season;
+	if (!warm) {
+		unloadContinent();
+	}
+
+	_ContinentSheet = continent;
+	_ActiveContinent = dynamic_cast<CContinentSheet *>(sheet);
+
+	_ZoneMin = minPos;
+	_ZoneMax = maxPos;
 
 	// Z in here determines invZTest cutoff
-	_ZoneCenter = CVector(((float)(xmax + xmin)) / 2, ((float)(ymax + ymin)) / 2, 0.f);
+	_ZoneCenter = CVector((minPos.x + maxPos.x) / 2, (minPos.y + maxPos.y) / 2, 0.f);
+
+	if (warm) {
+		return true;
+	}
 
 	//------------------------------------------------------------------------
 	_Direction = _ActiveContinent->Continent.LandscapeLightDay.Direction;
@@ -593,13 +837,13 @@ bool CMapRenderer::loadContinent(std::string name)
 	//------------------------------------------------------------------------
 	// villages are already in correct place (.ig has proper coords)
 	// towns, camps, bridges, water
+	// igs are streamed in from refreshLandscapeTiles() when close to render position
 	for (auto const &village : _ActiveContinent->Villages) {
-		std::string zone = toLower(village.Zone);
 		for (auto const &ig : village.IGs) {
 			_VillageIGs.emplace_back(CInstanceIG(ig.IgName, ig.ParentName));
 		}
 	}
-	addToScene(_VillageIGs);
+	indexVillageIGs();
 
 	//------------------------------------------------------------------------
 	/*
@@ -615,14 +859,20 @@ bool CMapRenderer::loadContinent(std::string name)
 	// TODO: need to load zone.ig for proper pos(x,y,z) and scale(sx, sy, sz)
 	// 'bat_zc_01/02/03/04' for bt_ruines.ig position
 	// 'flag_zc' for outpost flag position
-	uint i = 0;
 	for (auto const &zc : _ActiveContinent->Continent.ZCList) {
-		std::string lcTile = toLower(zc.Name);
-		// TODO: outpost construction building shapes if EnableRuins == false
-		std::string igName = zc.EnableRuins ? "gen_bt_ruines.ig" : "gen_bt_ruines.ig";
+		TZoneId zoneId = getZoneIdFromName(zc.Name);
+		if (zoneId == ZONE_ID_INVALID) {
+			nlwarning("(%s) invalid outpost zone name '%s'", _ActiveContinent->Continent.Name.c_str(), zc.Name.c_str());
+			continue;
+		}
+		// construction plots when set, ruins otherwise (there is no stock construction .ig)
+		std::string igName = _OutpostRuinsIG;
+		if (!zc.EnableRuins && !_OutpostConstructionIG.empty()) {
+			igName = _OutpostConstructionIG;
+		}
 
-		// TODO: if (!zc.EnableRuins) -> use construction plots instead ruins + outpost flag
-		_OutpostIGs.emplace(lcTile, CInstanceIG(igName, ""));
+		// TODO: outpost flag
+		_OutpostIGs[zoneId] = COutpostIG(igName);
 	}
 
 	//printf(" - createRetrieverBank: %s\n", _ActiveContinent->Continent.PacsRBank.c_str());
@@ -670,22 +920,15 @@ bool CMapRenderer::loadContinent(std::string name)
 //----------------------------------------------------------------------------
 void CMapRenderer::unloadContinent()
 {
-	for (auto it : _VillageIGs) {
-		if (it.IG) {
-			it.IG->removeFromScene(*scene);
-			delete (it.IG);
-			it.IG = nullptr;
-		}
+	for (auto &it : _VillageIGs) {
+		removeVillageFromScene(it);
 	}
 	_VillageIGs.clear();
+	_VillageGrid.clear();
 
-	for (auto it : _OutpostIGs) {
-		if (it.second.IG) {
-			it.second.IG->removeFromScene(*scene);
-			delete (it.second.IG);
-			it.second.IG = nullptr;
-		}
-	}
+	_OutpostIGs.forEach([this](TZoneId, COutpostIG &outpost) {
+		removeOutpostBuildings(outpost);
+	});
 	_OutpostIGs.clear();
 
 	if (_PACS) {
@@ -706,7 +949,12 @@ void CMapRenderer::unloadContinent()
 		landscape->removeAllZones();
 	}
 
+	// village and outpost igs in scene were deserialized from own copy
+	releaseInstanceGroupTemplates();
+	_GridLabels.clear();
+	_LayeredZones.clear();
 	_ActiveContinent = nullptr;
+	_LoadedSeason.clear();
 }
 
 //----------------------------------------------------------------------------
@@ -718,46 +966,52 @@ void CMapRenderer::debugClusters()
 		}
 	}
 
-	for (auto &it : _OutpostIGs) {
-		if (it.second.IG) {
-			it.second.IG->displayDebugClusters(driver, text);
+	_OutpostIGs.forEach([this](TZoneId, COutpostIG &outpost) {
+		for (auto *ig : outpost.IGs) {
+			ig->displayDebugClusters(driver, text);
 		}
-	}
+	});
 
 	// TODO: landscapeManager igs
 }
 
 //----------------------------------------------------------------------------
 // outposts
-void CMapRenderer::addOutpostBuildings(CInstanceIG &ig, UInstanceGroup *zoneIg)
+void CMapRenderer::addOutpostBuildings(COutpostIG &outpost, UInstanceGroup *zoneIg)
 {
 	if (!zoneIg) {
 		nlwarning("called with zoneIg == null");
 		return;
 	}
+	if (!outpost.IGs.empty()) {
+		// already in scene
+		return;
+	}
 	for (uint i = 0; i < zoneIg->getNumInstance(); ++i) {
 		std::string name = toLower(zoneIg->getInstanceName(i));
 		//std::string shape = ig.IG->getShapeName(i);
 		if (startsWith(name, "bat_zc_")) {
 			// TODO: check if possible to directly insert .shape for ruings/construction/flag
-			ig.IG = UInstanceGroup::createInstanceGroup(CFile::getFilenameWithoutExtension(ig.Name) + ".ig");
-			if (ig.IG == nullptr) {
-				nlwarning("Instance group '%s' not found", ig.Name.c_str());
+			UInstanceGroup *ig = createInstanceGroupFromTemplate(CFile::getFilenameWithoutExtension(outpost.Name) + ".ig");
+			if (ig == nullptr) {
+				nlwarning("Instance group '%s' not found", outpost.Name.c_str());
 				continue;
 			}
 			// remap into proper position
 
-			ig.IG->createRoot(*scene);
-			//ig.IG->unfreezeHRC(); // TODO: dunno
+			ig->createRoot(*scene);
+			//ig->unfreezeHRC(); // TODO: dunno
 
 			// set global pos to zone tile
-			ig.IG->setPos(zoneIg->getInstancePos(i));
+			ig->setPos(zoneIg->getInstancePos(i));
 
-			ig.IG->addToScene(*scene);
-			scene->setToGlobalInstanceGroup(ig.IG);
+			ig->addToScene(*scene);
+			scene->setToGlobalInstanceGroup(ig);
 
 			// root->clipUnlinkFromAll();
-			updateIGDistance(ig.IG);
+			updateIGDistance(ig);
+
+			outpost.IGs.push_back(ig);
 		} else if (name == "flag_zc") {
 			// TODO: add outpost flag
 			//CVector pos = zoneIg->getInstancePos(i);
@@ -765,25 +1019,252 @@ void CMapRenderer::addOutpostBuildings(CInstanceIG &ig, UInstanceGroup *zoneIg)
 	}
 }
 
+//----------------------------------------------------------------------------
+void CMapRenderer::removeOutpostBuildings(COutpostIG &outpost)
+{
+	for (auto *ig : outpost.IGs) {
+		ig->removeFromScene(*scene);
+		delete ig;
+	}
+	outpost.IGs.clear();
+}
+
+//----------------------------------------------------------------------------
+const CInstanceGroup *CMapRenderer::getInstanceGroupTemplate(const std::string &filename)
+{
+	auto it = _IGTemplates.find(filename);
+	if (it == _IGTemplates.end()) {
+		CIGTemplate tpl;
+		tpl.IG = nullptr;
+
+		std::string path = CPath::lookup(filename, false, false);
+		CIFile file;
+		if (!path.empty() && file.open(path)) {
+			tpl.Data.resize(file.getFileSize());
+			tpl.IG = new CInstanceGroup;
+			try {
+				if (!tpl.Data.empty()) {
+					file.serialBuffer(&tpl.Data[0], tpl.Data.size());
+				}
+				CMemStream stream(true);
+				stream.fill(tpl.Data.empty() ? nullptr : &tpl.Data[0], tpl.Data.size());
+				tpl.IG->serial(stream);
+			} catch (const EStream &e) {
+				nlwarning("Failed to read instance group '%s' (%s)", path.c_str(), e.what());
+				delete tpl.IG;
+				tpl.IG = nullptr;
+				tpl.Data.clear();
+			}
+		}
+
+		// also remember missing files
+		it = _IGTemplates.emplace(filename, std::move(tpl)).first;
+	}
+
+	return it->second.IG;
+}
+
+//----------------------------------------------------------------------------
+UInstanceGroup *CMapRenderer::createInstanceGroupFromTemplate(const std::string &filename)
+{
+	if (!getInstanceGroupTemplate(filename)) {
+		return nullptr;
+	}
+
+	// same as UInstanceGroup::createInstanceGroup() without file io,
+	// serial() builds internal state (surface light owner, ...) for the new group
+	const CIGTemplate &tpl = _IGTemplates[filename];
+	auto *ig = new CInstanceGroupUser;
+	try {
+		CMemStream stream(true);
+		stream.fill(&tpl.Data[0], tpl.Data.size());
+		ig->getInternalIG().serial(stream);
+	} catch (const EStream &e) {
+		nlwarning("Failed to create instance group '%s' (%s)", filename.c_str(), e.what());
+		delete ig;
+		return nullptr;
+	}
+	ig->getInternalIG().setUserInterface(ig);
+	return ig;
+}
+
+//----------------------------------------------------------------------------
+bool CMapRenderer::getShapeBounds(const std::string &shape, CAABBox &box)
+{
+	auto it = _ShapeBounds.find(shape);
+	if (it == _ShapeBounds.end()) {
+		std::pair<bool, CAABBox> bounds(false, CAABBox());
+
+		// shape is only read for its box, scene loads it again when ig is added
+		std::string path = CPath::lookup(shape, false, false);
+		CIFile file;
+		if (!path.empty() && file.open(path)) {
+			try {
+				CShapeStream stream;
+				stream.serial(file);
+				IShape *ptr = stream.getShapePointer();
+				if (ptr) {
+					ptr->getAABBox(bounds.second);
+					bounds.first = true;
+					delete ptr;
+				}
+			} catch (const EStream &e) {
+				nlwarning("Failed to read shape '%s' (%s)", path.c_str(), e.what());
+			}
+		}
+
+		it = _ShapeBounds.emplace(shape, bounds).first;
+	}
+
+	box = it->second.second;
+	return it->second.first;
+}
+
+//----------------------------------------------------------------------------
+void CMapRenderer::releaseInstanceGroupTemplates()
+{
+	for (auto &it : _IGTemplates) {
+		delete it.second.IG;
+	}
+	_IGTemplates.clear();
+}
+
 //----------------------------------------------------------------------------
 // villages
-void CMapRenderer::addToScene(std::vector<CInstanceIG> &igs)
+void CMapRenderer::indexVillageIGs()
 {
-	for (CInstanceIG &ig : igs) {
-		ig.IG = UInstanceGroup::createInstanceGroup(CFile::getFilenameWithoutExtension(ig.Name) + ".ig");
-		if (ig.IG == nullptr) {
+	_VillageGrid.clear();
+	_VillagesInScene = 0;
+
+	// cpu overlay mode has no scene
+	if (!scene) return;
+
+	for (uint i = 0; i < _VillageIGs.size(); ++i) {
+		CInstanceIG &ig = _VillageIGs[i];
+
+		const CInstanceGroup *tpl = getInstanceGroupTemplate(CFile::getFilenameWithoutExtension(ig.Name) + ".ig");
+		if (!tpl) {
 			nlwarning("Instance group '%s' not found", ig.Name.c_str());
 			continue;
 		}
+		if (tpl->getNumInstance() == 0) {
+			continue;
+		}
+
+		// village igs have world coords for instances, bounds are from
+		// shape boxes so water planes, bridges and walls are kept in view
+		for (uint j = 0; j < tpl->getNumInstance(); ++j) {
+			const CInstanceGroup::CInstance &instance = tpl->getInstance(j);
+
+			CAABBox box;
+			if (getShapeBounds(instance.Name, box)) {
+				CMatrix mtx;
+				mtx.identity();
+				mtx.setPos(instance.Pos);
+				mtx.setRot(instance.Rot);
+				mtx.scale(instance.Scale);
+				box = CAABBox::transformAABBox(mtx, box);
+			} else {
+				// shape not found, pivot with one zone tile margin
+				box.setCenter(instance.Pos);
+				box.setHalfSize(CVector(ZONE_TILE_WH / 2, ZONE_TILE_WH / 2, ZONE_TILE_WH / 2));
+			}
+
+			CVector2f bmin(box.getMin().x, box.getMin().y);
+			CVector2f bmax(box.getMax().x, box.getMax().y);
+			if (j == 0) {
+				ig.Min = bmin;
+				ig.Max = bmax;
+			} else {
+				ig.Min.x = std::min(ig.Min.x, bmin.x);
+				ig.Min.y = std::min(ig.Min.y, bmin.y);
+				ig.Max.x = std::max(ig.Max.x, bmax.x);
+				ig.Max.y = std::max(ig.Max.y, bmax.y);
+			}
+		}
+		ig.HasBounds = true;
+
+		TZoneId topLeft = getZoneIdFromPos(std::max(0.f, ig.Min.x), std::min(0.f, ig.Max.y));
+		TZoneId bottomRight = getZoneIdFromPos(std::max(0.f, ig.Max.x), std::min(0.f, ig.Min.y));
+		if (topLeft == ZONE_ID_INVALID || bottomRight == ZONE_ID_INVALID) {
+			continue;
+		}
+		for (uint row = getZoneRow(topLeft); row <= getZoneRow(bottomRight); ++row) {
+			for (uint col = getZoneColumn(topLeft); col <= getZoneColumn(bottomRight); ++col) {
+				_VillageGrid[makeZoneId(col, row)].push_back(i);
+			}
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+void CMapRenderer::updateVillageIGs(const CVector &center, float radius)
+{
+	if (!scene) return;
+
+	// unload with one zone tile hysteresis, so igs do not flip on/off on tile borders
+	float unloadRadius = radius + ZONE_TILE_WH;
+	for (auto &ig : _VillageIGs) {
+		if (!ig.IG || !ig.HasBounds) continue;
+
+		if (ig.Max.x < center.x - unloadRadius || ig.Min.x > center.x + unloadRadius
+		    || ig.Max.y < center.y - unloadRadius || ig.Min.y > center.y + unloadRadius) {
+			removeVillageFromScene(ig);
+		}
+	}
+
+	TZoneId topLeft = getZoneIdFromPos(std::max(0.f, center.x - radius), std::min(0.f, center.y + radius));
+	TZoneId bottomRight = getZoneIdFromPos(std::max(0.f, center.x + radius), std::min(0.f, center.y - radius));
+	if (topLeft == ZONE_ID_INVALID || bottomRight == ZONE_ID_INVALID) {
+		return;
+	}
+
+	for (uint row = getZoneRow(topLeft); row <= getZoneRow(bottomRight); ++row) {
+		for (uint col = getZoneColumn(topLeft); col <= getZoneColumn(bottomRight); ++col) {
+			const std::vector<uint> *indices = _VillageGrid.find(makeZoneId(col, row));
+			if (!indices) continue;
 
-		ig.IG->createRoot(*scene);
-		ig.IG->unfreezeHRC(); // TODO: dunno
+			for (uint i : *indices) {
+				CInstanceIG &ig = _VillageIGs[i];
+				if (ig.IG) continue;
 
-		ig.IG->addToScene(*scene);
-		scene->setToGlobalInstanceGroup(ig.IG);
+				if (ig.Max.x >= center.x - radius && ig.Min.x <= center.x + radius
+				    && ig.Max.y >= center.y - radius && ig.Min.y <= center.y + radius) {
+					addVillageToScene(ig);
+				}
+			}
+		}
+	}
+}
 
-		updateIGDistance(ig.IG);
+//----------------------------------------------------------------------------
+void CMapRenderer::addVillageToScene(CInstanceIG &ig)
+{
+	ig.IG = createInstanceGroupFromTemplate(CFile::getFilenameWithoutExtension(ig.Name) + ".ig");
+	if (ig.IG == nullptr) {
+		nlwarning("Instance group '%s' not found", ig.Name.c_str());
+		return;
 	}
+
+	ig.IG->createRoot(*scene);
+	ig.IG->unfreezeHRC(); // TODO: dunno
+
+	ig.IG->addToScene(*scene);
+	scene->setToGlobalInstanceGroup(ig.IG);
+
+	updateIGDistance(ig.IG);
+	++_VillagesInScene;
+}
+
+//----------------------------------------------------------------------------
+void CMapRenderer::removeVillageFromScene(CInstanceIG &ig)
+{
+	if (!ig.IG) return;
+
+	ig.IG->removeFromScene(*scene);
+	delete ig.IG;
+	ig.IG = nullptr;
+	--_VillagesInScene;
 }
 
 //----------------------------------------------------------------------------
@@ -800,14 +1281,23 @@ void CMapRenderer::refreshLandscapeTiles(const CVector &center, uint32 vision)
 	std::vector<std::string> zonesRemoved;
 
 	// blocking call
+	_Stats.begin(StageZones);
 	landscape->refreshAllZonesAround(center, vision, zonesAdded, zonesRemoved, progress);
+	_Stats.end(StageZones);
+	_Stats.addZones(zonesAdded.size(), zonesRemoved.size());
+
+	_Stats.begin(StageZoneIG);
 	if (!zonesRemoved.empty()) {
 		unloadZoneIG(zonesRemoved);
 	}
 
-	if (!zonesAdded.empty()) {
-		loadZoneIG(zonesAdded);
+	if (!_SkipIGs) {
+		if (!zonesAdded.empty()) {
+			loadZoneIG(zonesAdded);
+		}
+		updateVillageIGs(center, vision);
 	}
+	_Stats.end(StageZoneIG);
 
 	landscape->setRefineCenterUser(center);
 	landscape->setupStaticLight(_Diffuse, _Ambiant, 1.0f);
@@ -826,6 +1316,7 @@ void CMapRenderer::changeLandscapeSeason()
 	LandscapeIGManager.reset();
 	landscape->removeAllZones();
 	// todo: reset and reload pacs?
+	_LoadedSeason = _Season;
 
 	std::string coarseMeshFile = filenameWithSeasonSuffix(_ActiveContinent->Continent.CoarseMeshMap);
 	std::string farBank = filenameWithSeasonSuffix(_ActiveContinent->Continent.FarBank);
@@ -834,7 +1325,7 @@ void CMapRenderer::changeLandscapeSeason()
 
 	//printf(": coarseMeshFile '%s'\n", coarseMeshFile.c_str());
 	scene->setCoarseMeshManagerTexture(coarseMeshFile.c_str());
-	scene->setCoarseMeshLightingUpdate(1);
+	applySceneProfile();
 
 	//printf(": farBank '%s'\n", farBank.c_str());
 	landscape->loadBankFiles(_ActiveContinent->Continent.SmallBank, farBank);
@@ -859,8 +1350,19 @@ void CMapRenderer::changeLandscapeSeason()
 }
 
 //----------------------------------------------------------------------------
-void CMapRenderer::autoRender()
+std::string CMapRenderer::autoRender(bool savePng, CBitmap *result, bool *complete)
 {
+	std::string checkpointDir = _OutputDirectory + "/" + _MapName + ".checkpoint";
+	if (savePng && _Resume) {
+		// finished in earlier run, checkpoint is removed only after png is written
+		std::string txName = getAutoRenderFilename();
+		if (CFile::fileExists(txName) && !CFile::isDirectory(checkpointDir)) {
+			nlinfo("'%s' already rendered, skipping", txName.c_str());
+			_Progress.mapDone(txName);
+			return txName;
+		}
+	}
+
 	//------------------------------------------------------------------------
 	// backup
 	UCamera cam = scene->getCam();
@@ -872,6 +1374,8 @@ void CMapRenderer::autoRender()
 	float threshold = landscape->getThreshold();
 	bool refineAuto = landscape->getRefineCenterAuto();
 	uint vision = _LandscapeVision;
+	uint tileWidth = _TileWidth;
+	uint tileHeight = _TileHeight;
 
 	//------------------------------------------------------------------------
 	// make sure landscape loads enough tiles to avoid tearing
@@ -879,98 +1383,402 @@ void CMapRenderer::autoRender()
 		// sanity check
 		_Scale = 0.1f;
 	}
-	uint scaledWidth = driver->getWindowWidth() / _Scale;
-	uint scaledHeight = driver->getWindowHeight() / _Scale;
 
-	_LandscapeVision = ((std::max(scaledWidth, scaledHeight) / ZONE_TILE_WH) * ZONE_TILE_WH) / 2 + ZONE_TILE_WH * 4;
+	// from --auto-tune for this continent and scale, tile size only applies to offscreen target
+	CRenderTuning tuning;
+	bool tuned = _ForcedVision == 0 && getRenderTuning(tuning);
+	if (tuned && _Headless && !_TileSizeLocked) {
+		_TileWidth = tuning.TileWidth;
+		_TileHeight = tuning.TileHeight;
+	}
+
+	uint scaledWidth = _TileWidth / _Scale;
+	uint scaledHeight = _TileHeight / _Scale;
+
+	if (_ForcedVision > 0) {
+		_LandscapeVision = _ForcedVision;
+	} else if (tuned) {
+		_LandscapeVision = tuning.Vision;
+	} else {
+		_LandscapeVision = ((std::max(scaledWidth, scaledHeight) / ZONE_TILE_WH) * ZONE_TILE_WH) / 2 + ZONE_TILE_WH * 4;
+	}
+
+	// lod bias drops detail at low scale
+	CQualityPreset quality = getQualityPreset();
 	if (!_TileNearLocked) {
-		_LandscapeTileNear = _LandscapeVision / 2.f;
+		if (tuned) {
+			_LandscapeTileNear = tuning.TileNear;
+		} else {
+			_LandscapeTileNear = quality.FarBank ? 0 : _LandscapeVision / 2.f;
+		}
 	}
+	float vegetableDensity = landscape->getVegetableDensity();
+	landscape->setVegetableDensity(quality.VegetableDensity);
 	landscape->setTileNear(_LandscapeTileNear);
 	landscape->setRefineCenterAuto(false); // true == use camera for center pos
-	landscape->setThreshold(0.00005f);
+	landscape->setThreshold(quality.Threshold);
+	nlinfo("quality: scale %.2f, lod bias %.2f, threshold %g, tilenear %u, veget density %.2f",
+	    _Scale, getLodBias(), quality.Threshold, _LandscapeTileNear, quality.VegetableDensity);
 
 	// tryker island 5 has water on center tile which will be unloaded
 	// on last row screenshots if vision is not increased
-	if (_ContinentSheet == "tryker_island" && _LandscapeVision < 1000) {
+	if (!tuned && _ForcedVision == 0 && _ContinentSheet == "tryker_island" && _LandscapeVision < 1000) {
 		_LandscapeVision = 1000;
 	}
 
 	//------------------------------------------------------------------------
+	// overlays go into separate layers, keep them out from terrain render
+	bool drawPacs = _DrawPacs;
+	bool drawGrid = _DrawGrid;
+	bool drawGridNames = _DrawGridNames;
+	if (_OverlayLayers) {
+		_DrawPacs = false;
+		_DrawGrid = false;
+		_DrawGridNames = false;
+	}
+
 	CBitmap renderBuffer;
-	renderScreenshot(renderBuffer);
+	uint width = (_ZoneMax.x - _ZoneMin.x) * _Scale;
+	uint height = (_ZoneMax.y - _ZoneMin.y) * _Scale;
+	bool bands = savePng && useBandStreaming(width, height);
+	_Stats.setBandStreaming(bands);
+
+	std::string txName;
+	if (savePng) {
+		txName = getAutoRenderFilename();
+	}
 
-	//------------------------------------------------------------------------
-	// save
-	if (!CFile::isExists(_OutputDirectory)) {
-		nlinfo(">> creating directory {%s}", _OutputDirectory.c_str());
-		CFile::createDirectoryTree(_OutputDirectory);
+	// finished tiles go to disk as they are rendered
+	CRenderCheckpoint checkpoint;
+	if (savePng && _Resume) {
+		uint tilesX = (width + _TileWidth - 1) / _TileWidth;
+		uint tilesY = (height + _TileHeight - 1) / _TileHeight;
+		checkpoint.open(checkpointDir, _MapName, getRenderSettings(), tilesX, tilesY);
 	}
+	CRenderCheckpoint *resume = checkpoint.isOpen() ? &checkpoint : nullptr;
 
-	std::string txName = _OutputDirectory + "/" + _MapName + ".png";
-	if (CFile::fileExists(txName)) {
-		txName = CFile::findNewFile(txName);
+	bool done = false;
+	if (bands) {
+		// rows are written to png as soon as tile row is rendered
+		CPngBandWriter png;
+		if (png.open(txName, width, height)) {
+			done = renderScreenshot(renderBuffer, &png, resume);
+
+			CStageTimer timer(_Stats, StageWritePng);
+			png.close();
+		}
+	} else {
+		done = renderScreenshot(renderBuffer, nullptr, resume);
+	}
+	if (complete) {
+		*complete = done;
 	}
 
-	COFile fsDest(txName);
-	renderBuffer.writePNG(fsDest, 24);
+	_DrawPacs = drawPacs;
+	_DrawGrid = drawGrid;
+	_DrawGridNames = drawGridNames;
+
+	//------------------------------------------------------------------------
+	// save
+	if (savePng) {
+		if (!bands) {
+			CStageTimer timer(_Stats, StageWritePng);
+			COFile fsDest(txName);
+			renderBuffer.writePNG(fsDest, 24);
+		}
+		if (done) {
+			if (checkpoint.getResumed() > 0) {
+				nlinfo("'%s': %u tiles taken from checkpoint", txName.c_str(), checkpoint.getResumed());
+			}
+			checkpoint.remove();
+		}
+		// release canvas before overlay layers
+		renderBuffer.reset();
+
+		writeTimingReport();
+
+		if (_Heatmap) {
+			std::string baseName = _OutputDirectory + "/" + _MapName;
+			writeHeatmapCsv(baseName + ".heatmap.csv", _Stats);
+			writeHeatmapPng(baseName + ".heatmap.png", _Stats, _HeatmapMetric,
+			    width, height, _TileWidth, _TileHeight, 16);
+		}
+
+		if (_OverlayLayers) {
+			renderOverlayLayers(_TileWidth, _TileHeight);
+		}
+
+		_Progress.mapDone(txName);
+	} else if (result) {
+		// canvas is always full size without png
+		*result = renderBuffer;
+	}
 
 	//------------------------------------------------------------------------
 	// restore
 	_LandscapeTileNear = tileNear;
 	_LandscapeThreshold = threshold;
 	_LandscapeVision = vision;
+	_TileWidth = tileWidth;
+	_TileHeight = tileHeight;
 
 	landscape->setRefineCenterAuto(_RefineCenterAuto);
 	landscape->setTileNear(_LandscapeTileNear);
 	landscape->setThreshold(_LandscapeThreshold);
+	landscape->setVegetableDensity(vegetableDensity);
 
 	cam.setMatrix(mtx);
 	cam.setFrustum(frustum);
 	scene->setViewport(viewport);
+
+	return txName;
 }
 
 //----------------------------------------------------------------------------
-void CMapRenderer::renderScreenshot(CBitmap &btm)
+CMapRenderer::CQualityPreset CMapRenderer::getQualityPreset() const
 {
-	//------------------------------------------------------------------------
-	// setup camera
-	uint windowWidth = driver->getWindowWidth();
-	uint windowHeight = driver->getWindowHeight();
-	uint scaledWidth = (float)windowWidth / _Scale;
-	uint scaledHeight = (float)windowHeight / _Scale;
-	// frustum sets visible area in meters (-400, 400)
-	scene->getCam().setFrustum(scaledWidth, scaledHeight, _ZNear, _ZFar, false);
-	scene->setViewport(CViewport());
+	CQualityPreset preset;
+	preset.Threshold = _RenderThreshold;
+	preset.FarBank = false;
+	preset.VegetableDensity = 1.f;
+	float bias = getLodBias();
+	if (bias <= 0.f) {
+		return preset;
+	}
 
-	//------------------------------------------------------------------------
-	float width = _ZoneMax.x - _ZoneMin.x;
-	float height = _ZoneMax.y - _ZoneMin.y;
+	// 1:4 with bias 1 is same as 1:2 with bias 2
+	float scale = _Scale / bias;
 
-	uint32 ScreenShotWidth = width * _Scale;
-	uint32 ScreenShotHeight = height * _Scale;
+	// coarser tessellation for larger pixels, full quality is kept above 1:1
+	preset.Threshold = _RenderThreshold * std::max(1.f, 1.f / scale);
+	preset.FarBank = scale <= farBankMaxScale;
+	preset.VegetableDensity = scale < vegetableMinScale ? 0.f : std::min(1.f, scale);
+	return preset;
+}
 
-	nlinfo("render: continent '%s' (%.2f,%.2f), output(%s), size(%d,%d), scale(%.2f)\n",
-	    _ContinentSheet.c_str(), width, height,
-	    _MapName.c_str(), ScreenShotWidth, ScreenShotHeight, _Scale);
+//----------------------------------------------------------------------------
+float CMapRenderer::getLodBias() const
+{
+	if (_LodBias >= 0.f) {
+		return _LodBias;
+	}
 
-	CBitmap dest;
-	btm.resize(ScreenShotWidth, ScreenShotHeight, CBitmap::RGBA);
+	// auto, only bias that --auto-tune checked against full quality render
+	CRenderTuning tuning;
+	if (_ForcedVision == 0 && getRenderTuning(tuning)) {
+		return tuning.AutoLodBias;
+	}
+	return 0.f;
+}
 
-	//UMovePrimitive *movePrimitive = nullptr;
-	//if (_PACS) {
-	//	movePrimitive = _PACS->addCollisionablePrimitive(0, 1);
-	//}
+//----------------------------------------------------------------------------
+std::string CMapRenderer::getAutoRenderFilename()
+{
+	if (!CFile::isExists(_OutputDirectory)) {
+		nlinfo(">> creating directory {%s}", _OutputDirectory.c_str());
+		CFile::createDirectoryTree(_OutputDirectory);
+	}
 
-	CVector screenShotCenter = _ZoneCenter;
-	float renderX = screenShotCenter.x - width / 2.f + scaledWidth / 2;
-	float renderY = screenShotCenter.y + height / 2.f - scaledHeight / 2;
+	std::string txName = _OutputDirectory + "/" + _MapName + ".png";
+	// resumed render replaces its own output
+	if (!_Resume && CFile::fileExists(txName)) {
+		txName = CFile::findNewFile(txName);
+	}
+	return txName;
+}
+
+//----------------------------------------------------------------------------
+std::string CMapRenderer::getRenderSettings() const
+{
+	std::string pacsFilter;
+	for (bool b : _PacsFilter) {
+		pacsFilter += b ? '1' : '0';
+	}
+
+	return toString("continent=%s season=%s area=%.2f,%.2f,%.2f,%.2f scale=%.4f tile=%ux%u vision=%u tilenear=%.2f z=%.2f,%.2f "
+	                "lod_bias=%.2f ssaa=%u fxaa=%d inverse_z=%d,%d tight_depth=%d no_trees=%d static=%d pacs=%d,%s grid=%d,%d bg=%u,%u,%u,%u",
+	    _ContinentSheet.c_str(), _Season.c_str(), _ZoneMin.x, _ZoneMin.y, _ZoneMax.x, _ZoneMax.y, _Scale,
+	    _TileWidth, _TileHeight, _LandscapeVision, _LandscapeTileNear, _ZNear, _ZFar,
+	    getLodBias(), getSupersample(), _UseFXAA && getSupersample() == 1, _InverseZ, _InverseZAuto, _TightDepth, _HideTrees, _StaticMap, _DrawPacs, pacsFilter.c_str(),
+	    _DrawGrid, _DrawGridNames, _BackgroundColor.R, _BackgroundColor.G, _BackgroundColor.B, _BackgroundColor.A);
+}
+
+//----------------------------------------------------------------------------
+bool CMapRenderer::useBandStreaming(uint width, uint height)
+{
+	if (_BandStreaming) {
+		return true;
+	}
+	if (_MemoryBudget == 0) {
+		return false;
+	}
+
+	// full canvas and png encoder copy of it
+	uint64 canvas = (uint64)width * height * 4;
+	uint64 rss, peakRss;
+	getProcessMemory(rss, peakRss);
+	if (rss + canvas * 2 > _MemoryBudget) {
+		nlinfo("'%s': %dx%d canvas (%" NL_I64 "u MB) does not fit memory budget, streaming png rows",
+		    _MapName.c_str(), width, height, canvas >> 20);
+		return true;
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------------
+template <class F>
+void CMapRenderer::forEachSceneIG(F f)
+{
+	std::vector<std::pair<UInstanceGroup *, std::string>> zoneIGs;
+	LandscapeIGManager.getAllIGWithNames(zoneIGs);
+	for (const auto &it : zoneIGs) {
+		if (it.first && LandscapeIGManager.isIGAddedToScene(it.second)) {
+			f(it.first);
+		}
+	}
+	for (const auto &it : _VillageIGs) {
+		if (it.IG) {
+			f(it.IG);
+		}
+	}
+	_OutpostIGs.forEach([&f](TZoneId, COutpostIG &outpost) {
+		for (auto *ig : outpost.IGs) {
+			f(ig);
+		}
+	});
+}
+
+//----------------------------------------------------------------------------
+CMemoryStats CMapRenderer::sampleMemory(const CBitmap &canvas)
+{
+	CMemoryStats mem;
+	getProcessMemory(mem.Rss, mem.PeakRss);
+	mem.Canvas = (uint64)canvas.getWidth() * canvas.getHeight() * 4;
+	mem.Texture = driver ? driver->profileAllocatedTextureMemory() : 0;
+
+	if (landscape) {
+		std::vector<std::string> zones;
+		landscape->getAllZoneLoaded(zones);
+		mem.Zones = zones.size();
+	}
+
+	forEachSceneIG([&mem](UInstanceGroup *ig) {
+		mem.IGs++;
+		mem.Instances += ig->getNumInstance();
+	});
+
+	return mem;
+}
+
+//----------------------------------------------------------------------------
+void CMapRenderer::enforceMemoryBudget(const CMemoryStats &mem)
+{
+	if (_MemoryBudget == 0 || mem.Rss <= _MemoryBudget) {
+		return;
+	}
+
+	// evict again only if memory keeps growing
+	if (_EvictionRss > 0 && mem.Rss < _EvictionRss + _MemoryBudget / 20) {
+		return;
+	}
+
+	nlwarning("memory %" NL_I64 "u MB over budget %" NL_I64 "u MB, evicting caches", mem.Rss >> 20, _MemoryBudget >> 20);
+	evictCaches();
+	_Stats.addEviction();
+
+	uint64 peakRss;
+	getProcessMemory(_EvictionRss, peakRss);
+}
+
+//----------------------------------------------------------------------------
+void CMapRenderer::evictCaches()
+{
+	// outpost igs in scene keep their own copy, shape boxes are small and kept
+	releaseInstanceGroupTemplates();
+	_GridLabels.clear();
+
+#ifdef __GLIBC__
+	// return freed heap to os
+	malloc_trim(0);
+#endif
+}
+
+//----------------------------------------------------------------------------
+void CMapRenderer::writeTimingReport()
+{
+	std::string baseName = _OutputDirectory + "/" + _MapName;
+
+	_Stats.setTileSize(_TileWidth, _TileHeight, getSupersample());
+	_Stats.writeJson(baseName + ".timing.json");
+	_Stats.writeCsv(baseName + ".timing.csv");
+	if (_Stats.isTraceEnabled()) {
+		_Stats.writeChromeTrace(baseName + ".trace.json");
+	}
+
+	nlinfo("timing: '%s' %d tiles in %.2fs, tile p50 %.1fms, p99 %.1fms", _MapName.c_str(),
+	    _Stats.getTileCount(), _Stats.getElapsed(),
+	    _Stats.getTilePercentile(50) * 1000.0, _Stats.getTilePercentile(99) * 1000.0);
+	if (_InverseZ && _InverseZAuto) {
+		nlinfo("inverse z: '%s' skipped passes on %d of %d tiles", _MapName.c_str(), _Stats.getInverseZSkipped(), _Stats.getTileCount());
+	}
+}
+
+//----------------------------------------------------------------------------
+bool CMapRenderer::renderScreenshot(CBitmap &btm, CPngBandWriter *bands, CRenderCheckpoint *checkpoint)
+{
+	//------------------------------------------------------------------------
+	// setup camera
+	uint windowWidth = _TileWidth;
+	uint windowHeight = _TileHeight;
+	uint scaledWidth = (float)windowWidth / _Scale;
+	uint scaledHeight = (float)windowHeight / _Scale;
+	// frustum sets visible area in meters (-400, 400)
+	scene->getCam().setFrustum(scaledWidth, scaledHeight, _ZNear, _ZFar, false);
+	scene->setViewport(CViewport());
+
+	//------------------------------------------------------------------------
+	float width = _ZoneMax.x - _ZoneMin.x;
+	float height = _ZoneMax.y - _ZoneMin.y;
+
+	uint32 ScreenShotWidth = width * _Scale;
+	uint32 ScreenShotHeight = height * _Scale;
+
+	nlinfo("render: continent '%s' (%.2f,%.2f), output(%s), size(%d,%d), scale(%.2f)\n",
+	    _ContinentSheet.c_str(), width, height,
+	    _MapName.c_str(), ScreenShotWidth, ScreenShotHeight, _Scale);
+
+	CBitmap dest;
+	if (bands) {
+		// single row of tiles
+		btm.resize(ScreenShotWidth, std::min(windowHeight, ScreenShotHeight), CBitmap::RGBA);
+	} else {
+		btm.resize(ScreenShotWidth, ScreenShotHeight, CBitmap::RGBA);
+	}
+
+	//UMovePrimitive *movePrimitive = nullptr;
+	//if (_PACS) {
+	//	movePrimitive = _PACS->addCollisionablePrimitive(0, 1);
+	//}
+
+	CVector screenShotCenter = _ZoneCenter;
+	float renderX = screenShotCenter.x - width / 2.f + scaledWidth / 2;
+	float renderY = screenShotCenter.y + height / 2.f - scaledHeight / 2;
 	float renderZ = screenShotCenter.z;
 
 	CVector viewCenter(renderX, renderY, renderZ);
 
+	if (_StaticMap) {
+		// same time for every tile, nothing to update between them
+		scene->animate(0);
+	}
+
 	bool mustQuit = false;
 
+	uint tilesX = (ScreenShotWidth + windowWidth - 1) / windowWidth;
+	uint tilesY = (ScreenShotHeight + windowHeight - 1) / windowHeight;
+	// preview stages render before full pass
+	_Progress.passStart();
+
 	uint top = 0;
 	uint bottom = std::min(windowHeight, ScreenShotHeight);
 	for (top = 0; top < ScreenShotHeight; top += windowHeight) {
@@ -981,54 +1789,105 @@ void CMapRenderer::renderScreenshot(CBitmap &btm)
 		uint left;
 		uint right = std::min(windowWidth, ScreenShotWidth);
 		for (left = 0; left < ScreenShotWidth; left += windowWidth) {
-			driver->EventServer.pump();
-			if (driver->AsyncListener.isKeyPushed(KeyESCAPE)) {
-				mustQuit = true;
-				break;
+			if (!_Headless) {
+				driver->EventServer.pump();
+				if (driver->AsyncListener.isKeyPushed(KeyESCAPE)) {
+					mustQuit = true;
+					break;
+				}
 			}
 
-			// TODO: allow to keep camera tilt from manual mode (ie 2.5D render)
-			//---------------------------------------------------------------------------
-			// setup camera at next tile
-			CMatrix mtx = scene->getCam().getMatrix();
-			mtx.identity();
-			mtx.rotateX(-(float)Pi / 2);
-			mtx.setPos(viewCenter);
-			scene->getCam().setTransformMode(UTransformable::DirectMatrix);
-			scene->getCam().setMatrix(mtx);
-
-			//---------------------------------------------------------------------------
-			// animate veget, trees
-			scene->animate(0);
-			renderScene(viewCenter);
-
-			driver->clearZBuffer();
-			if (_DrawPacs) {
-				drawPacs(viewCenter);
-			}
-			if (_DrawGrid || _DrawGridNames) {
-				drawGrid(viewCenter);
-			}
+			uint tileIndex = (top / windowHeight) * tilesX + left / windowWidth;
+			if (checkpoint && checkpoint->loadTile(tileIndex, dest)) {
+				// finished by earlier run
+				btm.blit(dest, 0, 0, right - left, bottom - top, left, bands ? 0 : top);
+				_Progress.tile(tileIndex, tilesX * tilesY, false);
+			} else {
+				_Stats.beginTile(left / windowWidth, top / windowHeight);
+
+				// TODO: allow to keep camera tilt from manual mode (ie 2.5D render)
+				//---------------------------------------------------------------------------
+				// setup camera at next tile
+				CMatrix mtx = scene->getCam().getMatrix();
+				mtx.identity();
+				mtx.rotateX(-(float)Pi / 2);
+				mtx.setPos(viewCenter);
+				scene->getCam().setTransformMode(UTransformable::DirectMatrix);
+				scene->getCam().setMatrix(mtx);
+
+				//---------------------------------------------------------------------------
+				// animate veget, trees
+				if (!_StaticMap) {
+					scene->animate(0);
+				}
+				if (_Heatmap) {
+					scene->profileNextRender();
+				}
+				renderScene(viewCenter);
 
-			//
-			driver->flush();
-			driver->getBuffer(dest);
+				driver->clearZBuffer();
+				if (_DrawPacs) {
+					drawPacs(viewCenter);
+				}
+				if (_DrawGrid || _DrawGridNames) {
+					drawGrid(viewCenter);
+				}
 
-			//std::cout << toString(":: blit(%d, %d, %d, %d, %d, %d) {%.2f, %.2f}", 0, 0, right-left, bottom-top, left, top, viewCenter.x, viewCenter.y) << std::endl;
-			btm.blit(dest, 0, 0, right - left, bottom - top, left, top);
-			// TODO: individual tiles could be used for low memory mode (still needs blit/clip)
-			/*{
-				std::string outFileName = toString("landscape-%d-%d.png", left, top);
-				COFile pngTile(outFileName);
-				dest.writePNG(pngTile, 24);
-			}*/
+				if (_Heatmap) {
+					// primitives since last swapBuffers
+					CPrimitiveProfile in, out;
+					driver->profileRenderedPrimitives(in, out);
+					UScene::CBenchResults bench;
+					scene->getProfileResults(bench);
+					uint meshes = bench.NumMeshRdrNormal + bench.NumMeshRdrBlock + bench.NumMeshMRMRdrNormal + bench.NumMeshMRMRdrBlock;
+					_Stats.setTileComplexity(out.NTriangles + out.NQuads * 2 + out.NTriangleStrips, meshes);
+				}
 
-			renderOverlayAuto(viewCenter);
-			driver->swapBuffers();
+				//
+				_Stats.begin(StageReadback);
+				readTile(dest);
+				_Stats.end(StageReadback);
+
+				//std::cout << toString(":: blit(%d, %d, %d, %d, %d, %d) {%.2f, %.2f}", 0, 0, right-left, bottom-top, left, top, viewCenter.x, viewCenter.y) << std::endl;
+				_Stats.begin(StageBlit);
+				btm.blit(dest, 0, 0, right - left, bottom - top, left, bands ? 0 : top);
+				_Stats.end(StageBlit);
+				if (checkpoint) {
+					CStageTimer timer(_Stats, StageWritePng);
+					checkpoint->saveTile(tileIndex, dest);
+				}
+				// TODO: individual tiles could be used for low memory mode (still needs blit/clip)
+				/*{
+					std::string outFileName = toString("landscape-%d-%d.png", left, top);
+					COFile pngTile(outFileName);
+					dest.writePNG(pngTile, 24);
+				}*/
+
+				CMemoryStats mem = sampleMemory(btm);
+				_Stats.setMemory(mem);
+				_Stats.endTile();
+				enforceMemoryBudget(mem);
+
+				_Progress.tile(tileIndex, tilesX * tilesY, true);
+
+				if (!_Headless) {
+					renderOverlayAuto(viewCenter);
+				}
+				driver->swapBuffers();
+			}
 
 			right = std::min(right + windowWidth, ScreenShotWidth);
 			viewCenter.x += scaledWidth;
 		}
+		if (bands && !mustQuit) {
+			CStageTimer timer(_Stats, StageWritePng);
+			bands->writeRows(btm, bottom - top);
+		}
+		if (!_PreviewFile.empty() && !mustQuit) {
+			CStageTimer timer(_Stats, StageWritePng);
+			updatePreview(btm, bands ? 0 : top, top, bottom - top, ScreenShotHeight);
+		}
+
 		bottom = std::min(bottom + windowHeight, ScreenShotHeight);
 		viewCenter.x = renderX;
 		viewCenter.y -= scaledHeight;
@@ -1039,6 +1898,8 @@ void CMapRenderer::renderScreenshot(CBitmap &btm)
 	//}
 
 	driver->AsyncListener.reset();
+
+	return !mustQuit;
 }
 
 //---------------------------------------------------------------------------
@@ -1067,16 +1928,49 @@ void CMapRenderer::renderScene(const CVector &viewCenter)
 		landscape->setZFunc(UMaterial::lessequal);
 	}
 
-	if (fxaa) {
+	// camera is top-down only without mouse (auto render, benchmark, screenshot)
+	bool topDown = !mouse;
+	bool inverseZ = _InverseZ;
+	CFrustum slab = camera.getFrustum();
+	if (topDown && ((inverseZ && _InverseZAuto) || _TightDepth)) {
+		std::vector<CDepthRange> bounds;
+		getTileDepthBounds(viewCenter, slab.Right - slab.Left, slab.Top - slab.Bottom, bounds);
+
+		if (_TightDepth) {
+			applyTightDepth(camera, viewCenter, bounds, _InverseZ);
+			_Stats.setTileDepth(camera.getFrustum().Far - camera.getFrustum().Near);
+		}
+		// cutoff follows final slab
+		if (inverseZ && _InverseZAuto) {
+			inverseZ = needInverseZ(viewCenter, camera.getFrustum(), bounds);
+			_Stats.addInverseZ(inverseZ);
+		}
+	}
+
+	if (_Headless) {
+		// kept until readTile()
+		uint ssaa = getSupersample();
+		resizeHeadlessWindow(_TileWidth * ssaa, _TileHeight * ssaa);
+		driver->beginDefaultRenderTarget(_TileWidth * ssaa, _TileHeight * ssaa);
+	} else if (useFXAA()) {
 		driver->beginDefaultRenderTarget();
 	}
 	driver->clearBuffers(_BackgroundColor);
 
+	// with trace, wait for gpu so stage times are not only cpu submit
+	bool gpuSync = _Stats.isGpuSynced();
+
+	_Stats.begin(StageRender);
 	scene->render();
+	if (gpuSync) {
+		driver->finish();
+	}
+	_Stats.end(StageRender);
 
 	// second pass - overlay over current buffer
 	// render scene with inversed ZBuffer test
-	if (_InverseZ) {
+	if (inverseZ) {
+		CStageTimer timer(_Stats, StageInverseZ);
 		driver->setColorMask(false, false, false, false);
 
 		if (landscape) {
@@ -1104,14 +1998,28 @@ void CMapRenderer::renderScene(const CVector &viewCenter)
 		scene->enableElementRender(UScene::FilterLandscape, true);
 
 		scene->render();
+		if (gpuSync) {
+			driver->finish();
+		}
 	}
 
-	if (fxaa) {
+	if (useFXAA()) {
+		CStageTimer timer(_Stats, StageFxaa);
 		driver->setMatrixMode2D11();
 		fxaa->applyEffect();
+		if (gpuSync) {
+			driver->finish();
+		}
 		driver->setMatrixMode3D(camera);
 
-		driver->endDefaultRenderTarget(scene);
+		if (!_Headless) {
+			driver->endDefaultRenderTarget(scene);
+		}
+	}
+
+	if (topDown && _TightDepth) {
+		// overlays are drawn at z=0
+		camera.setFrustum(slab);
 	}
 
 	if (_DrawGrid || _DrawGridNames) {
@@ -1137,6 +2045,219 @@ void CMapRenderer::renderScene(const CVector &viewCenter)
 	}
 }
 
+//---------------------------------------------------------------------------
+void CMapRenderer::applySceneProfile()
+{
+	if (!scene || !landscape) return;
+
+	// static map: captures are single frame, only skip work repeated per frame
+	// sun lighting and shadows stay enabled, they are part of the image
+	bool dynamic = !_StaticMap;
+	scene->enableLightingSystem(true);
+	scene->setCoarseMeshLightingUpdate(dynamic ? 1 : 255);
+	landscape->enableReceiveShadowMap(true);
+	if (dynamic) {
+		landscape->setVegetableWind(CVector(0.5, 0.5, 0).normed(), 0.5, 1, 0);
+		landscape->setVegetableUpdateLightingFrequency(1 / 20.f);
+	} else {
+		// no bending, vegetables keep lighting from creation
+		landscape->setVegetableWind(CVector(0.5, 0.5, 0).normed(), 0, 0, 0);
+		landscape->setVegetableUpdateLightingFrequency(0);
+	}
+}
+
+//---------------------------------------------------------------------------
+void CMapRenderer::getTileDepthBounds(const CVector &viewCenter, float width, float height, std::vector<CDepthRange> &bounds)
+{
+	bounds.clear();
+
+	CVector2f tileMin(viewCenter.x - width / 2, viewCenter.y - height / 2);
+	CVector2f tileMax(viewCenter.x + width / 2, viewCenter.y + height / 2);
+	auto add = [&](const CVector &bmin, const CVector &bmax, bool layered) {
+		if (bmax.x >= tileMin.x && bmin.x <= tileMax.x && bmax.y >= tileMin.y && bmin.y <= tileMax.y) {
+			bounds.push_back({ bmin.z, bmax.z, layered });
+		}
+	};
+
+	if (landscape) {
+		const CLandscape &land = ((CLandscapeUser *)landscape)->getLandscape()->Landscape;
+		std::vector<uint16> zoneIds;
+		land.getZoneList(zoneIds);
+		for (uint16 id : zoneIds) {
+			const CZone *zone = land.getZone(id);
+			if (zone) {
+				const CAABBoxExt &bb = zone->getZoneBB();
+				bool touches = bb.getMax().x >= tileMin.x && bb.getMin().x <= tileMax.x && bb.getMax().y >= tileMin.y && bb.getMin().y <= tileMax.y;
+				add(bb.getMin(), bb.getMax(), touches && isZoneLayered(zone));
+			}
+		}
+	}
+
+	forEachSceneIG([&](UInstanceGroup *ig) {
+		CVector igPos = ig->getPos();
+		for (uint i = 0; i < ig->getNumInstance(); ++i) {
+			UInstance instance = ig->getInstance(i);
+			if (instance.empty()) continue;
+
+			CAABBox box;
+			instance.getShapeAABBox(box);
+			// shape box into world with instance pos/rot/scale, box of the rotated box is conservative
+			CMatrix mtx;
+			mtx.identity();
+			mtx.setPos(igPos + ig->getInstancePos(i));
+			mtx.setRot(ig->getInstanceRot(i));
+			mtx.scale(ig->getInstanceScale(i));
+			box = CAABBox::transformAABBox(mtx, box);
+			// meshes use normal depth test in both passes
+			add(box.getMin(), box.getMax(), false);
+		}
+	});
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::needInverseZ(const CVector &viewCenter, const CFrustum &frustum, const std::vector<CDepthRange> &bounds)
+{
+	// cutoff quad is at depth 0.5, middle of near/far slab
+	float cutoff = viewCenter.z - (frustum.Near + frustum.Far) / 2;
+	float top = viewCenter.z - frustum.Near;
+	float bottom = viewCenter.z - frustum.Far;
+	for (const auto &it : bounds) {
+		if (it.Max < bottom || it.Min > top) continue;
+
+		// geometry above cutoff is removed by the pass
+		if (it.Max >= cutoff) {
+			return true;
+		}
+		// below cutoff the pass keeps farthest landscape surface, normal
+		// pass the nearest, same image only with single surface
+		if (it.Layered) {
+			return true;
+		}
+	}
+	return false;
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::isZoneLayered(const CZone *zone)
+{
+	auto it = _LayeredZones.find(zone->getZoneId());
+	if (it != _LayeredZones.end()) {
+		return it->second;
+	}
+
+	// patch boxes are loose (bezier control points), overlap only means surfaces
+	// may stack, which keeps inverse z pass on
+	std::vector<CAABBox> boxes(zone->getNumPatchs());
+	for (uint i = 0; i < boxes.size(); ++i) {
+		boxes[i] = zone->getPatch(i)->buildBBox();
+	}
+	// neighbour patches share edges
+	const float edge = 0.5f;
+	bool layered = false;
+	for (uint i = 0; i < boxes.size() && !layered; ++i) {
+		for (uint j = i + 1; j < boxes.size() && !layered; ++j) {
+			const CAABBox &a = boxes[i];
+			const CAABBox &b = boxes[j];
+			layered = std::min(a.getMax().x, b.getMax().x) - std::max(a.getMin().x, b.getMin().x) > edge
+			    && std::min(a.getMax().y, b.getMax().y) - std::max(a.getMin().y, b.getMin().y) > edge;
+		}
+	}
+
+	_LayeredZones[zone->getZoneId()] = layered;
+	return layered;
+}
+
+//---------------------------------------------------------------------------
+void CMapRenderer::applyTightDepth(UCamera &camera, const CVector &viewCenter, const std::vector<CDepthRange> &bounds, bool symmetric)
+{
+	// --znear/--zfar slab stays the outer limit
+	float top = viewCenter.z - _ZNear;
+	float bottom = viewCenter.z - _ZFar;
+
+	float minZ = top;
+	float maxZ = bottom;
+	for (const auto &it : bounds) {
+		if (it.Max < bottom || it.Min > top) continue;
+		minZ = std::min(minZ, it.Min);
+		maxZ = std::max(maxZ, it.Max);
+	}
+
+	CFrustum frustum = camera.getFrustum();
+	if (minZ > maxZ) {
+		// empty tile
+		frustum.Near = _ZNear;
+		frustum.Far = _ZFar;
+	} else if (symmetric) {
+		// inverse z quad is drawn at depth 0.5, that must stay on camera plane
+		float half = std::max(viewCenter.z - minZ, maxZ - viewCenter.z) + depthMargin;
+		frustum.Near = std::max(_ZNear, -half);
+		frustum.Far = std::min(_ZFar, half);
+	} else {
+		// micro vegetation is not part of zone bounds
+		frustum.Near = std::max(_ZNear, viewCenter.z - maxZ - depthMargin);
+		frustum.Far = std::min(_ZFar, viewCenter.z - minZ + depthMargin);
+	}
+	camera.setFrustum(frustum);
+}
+
+//---------------------------------------------------------------------------
+void CMapRenderer::readTile(CBitmap &dest)
+{
+	driver->flush();
+	uint ssaa = getSupersample();
+	if (_Headless && ssaa > 1) {
+		CRect rect(0, 0, _TileWidth * ssaa, _TileHeight * ssaa);
+		driver->getBufferPart(_SupersampleBuffer, rect);
+		endTileTarget();
+
+		_Stats.begin(StageDownsample);
+		downsampleBitmap(_SupersampleBuffer, ssaa, dest);
+		_Stats.end(StageDownsample);
+		// getBufferPart() is bottom-up, getBuffer() flips it
+		dest.flipV();
+	} else if (_Headless) {
+		// target is window sized, so rect is not clipped
+		CRect rect(0, 0, _TileWidth, _TileHeight);
+		driver->getBufferPart(dest, rect);
+		endTileTarget();
+		dest.flipV();
+	} else {
+		driver->getBuffer(dest);
+	}
+}
+
+//---------------------------------------------------------------------------
+void CMapRenderer::resizeHeadlessWindow(uint width, uint height)
+{
+	if (driver->getWindowWidth() == width && driver->getWindowHeight() == height) {
+		return;
+	}
+
+	// window is never shown, size only sets getBufferPart() clip rect
+	if (!driver->setMode(UDriver::CMode(width, height, 32, true))) {
+		nlwarning("failed to resize hidden window to %dx%d", width, height);
+	}
+}
+
+//---------------------------------------------------------------------------
+uint CMapRenderer::getSupersample() const
+{
+	// tile size can change per render (preview, auto tune), keep target within limit
+	uint ssaa = _Headless ? _Supersample : 1;
+	while (ssaa > 1 && (_TileWidth * ssaa > maxTileWH || _TileHeight * ssaa > maxTileWH)) {
+		ssaa /= 2;
+	}
+	return std::max(1u, ssaa);
+}
+
+//---------------------------------------------------------------------------
+void CMapRenderer::endTileTarget()
+{
+	if (_Headless) {
+		driver->endDefaultRenderTarget(scene);
+	}
+}
+
 //---------------------------------------------------------------------------
 void CMapRenderer::setPacs(const std::vector<uint> &indices)
 {
@@ -1155,8 +2276,8 @@ void CMapRenderer::drawPacs(const CVector &viewCenter)
 {
 	if (!_GlobalRetriever) return;
 
-	uint halfWindowWidth = driver->getWindowWidth() / 2;
-	uint halfWindowHeight = driver->getWindowHeight() / 2;
+	uint halfWindowWidth = _TileWidth / 2;
+	uint halfWindowHeight = _TileHeight / 2;
 
 	CAABBox box;
 	//box.setCenter(viewCenter);
@@ -1174,37 +2295,7 @@ void CMapRenderer::drawPacs(const CVector &viewCenter)
 
 		CLineColor line;
 		line = edge.first;
-		CRGBA color;
-		switch (edge.second) {
-		// Block
-		case 0:
-			color = CRGBA::Red;
-			break;
-		// Surmountable
-		case 1:
-			color = CRGBA::Green;
-			break;
-		// Link
-		case 2:
-			color = CRGBA::Yellow;
-			break;
-		// Waterline
-		case 3:
-			color = CRGBA::Blue;
-			break;
-		// Exterior
-		case 4:
-			color = CRGBA::Magenta;
-			break;
-		// Exterior door
-		case 5:
-			color = CRGBA(127, 127, 127);
-			break;
-		// Unknown
-		default:
-			color = CRGBA(255, 100, 100);
-			break;
-		}
+		CRGBA color = getPacsEdgeColor(edge.second);
 
 		line.Color0 = color;
 		line.Color1 = color;
@@ -1215,8 +2306,8 @@ void CMapRenderer::drawPacs(const CVector &viewCenter)
 //---------------------------------------------------------------------------
 void CMapRenderer::drawGrid(const CVector &viewCenter)
 {
-	uint windowWidth = driver->getWindowWidth();
-	uint windowHeight = driver->getWindowHeight();
+	uint windowWidth = _TileWidth;
+	uint windowHeight = _TileHeight;
 
 	uint tilesX = windowWidth / ZONE_TILE_WH + 1;
 	uint tilesY = windowHeight / ZONE_TILE_WH + 1;
@@ -1269,67 +2360,204 @@ void CMapRenderer::drawGrid(const CVector &viewCenter)
 
 				fontMatrix.setPos(CVector(tx, ty, 5.f));
 
-				std::string zoneName = landscape->getZoneName(CVector(tx, ty, 0));
+				// computeString is expensive, zone label is built once per continent
+				TZoneId zoneId = getZoneIdFromPos(tx, ty);
+				auto it = _GridLabels.find(zoneId);
+				if (it == _GridLabels.end()) {
+					ucstring zoneTile;
+					zoneTile.fromUtf8(getZoneNameFromId(zoneId));
 
-				ucstring zoneTile;
-				zoneTile.fromUtf8(zoneName);
-
-				//text->render3D(fontMatrix, zoneTile);
-
-				CComputedString cs;
-				ctx->computeString(zoneTile, cs);
+					it = _GridLabels.emplace(zoneId, CComputedString()).first;
+					ctx->computeString(zoneTile, it->second);
+				}
+				CComputedString &cs = it->second;
 				cs.render3D(*drv, fontMatrix);
 			}
 		}
 	}
 }
 
-//----------------------------------------------------------------------------
-void CMapRenderer::loadZoneIG(const std::vector<std::string> &zoneTiles)
+//---------------------------------------------------------------------------
+std::vector<std::string> CMapRenderer::renderOverlayLayers(uint tileWidth, uint tileHeight)
 {
-	LandscapeIGManager.loadArrayZoneIG(zoneTiles);
+	std::vector<std::string> files;
+	if (!_DrawPacs && !_DrawGrid && !_DrawGridNames) {
+		nlinfo("no overlays enabled, use --pacs, --grid, --grid-names");
+		return files;
+	}
 
-	// TODO: calculate LoadDist from current ViewCenter and update VillageIGs whos LoadDist is in range
-	/* TODO: does not belong here as village igs does not depend on zone tiles
-	auto itVillages = _VillageIGs.find(lcTile);
-	if (itVillages != _VillageIGs.end()) {
-		printf(":: add %ld village igs for zone '%s'\n", itVillages->second.size(), tile.c_str());
-		addToScene(itVillages->second);
+	if (_Scale < 0.1f) {
+		// sanity check
+		_Scale = 0.1f;
 	}
-	*/
 
-	for (const auto &tile : zoneTiles) {
-		std::string lcTile = toLower(tile);
-		UInstanceGroup *zoneIg = LandscapeIGManager.getIG(tile);
+	// same tile step as renderScreenshot(), so pixels line up with terrain
+	uint scaledWidth = (float)tileWidth / _Scale;
+	uint scaledHeight = (float)tileHeight / _Scale;
+	float scaleX = (float)tileWidth / scaledWidth;
+	float scaleY = (float)tileHeight / scaledHeight;
 
-		// make sure tile has placeholder names
-		// (ie fyros_newbie has invalid outpost records from fyros continent)
-		if (!zoneIg) {
-			continue;
-		}
+	float width = _ZoneMax.x - _ZoneMin.x;
+	float height = _ZoneMax.y - _ZoneMin.y;
+	uint32 imageWidth = width * _Scale;
+	uint32 imageHeight = height * _Scale;
 
-		// outpost ruins
-		auto itOutposts = _OutpostIGs.find(lcTile);
-		if (itOutposts != _OutpostIGs.end()) {
-			addOutpostBuildings(itOutposts->second, zoneIg);
+	TTicks startTick = CTime::getPerformanceTime();
+
+	COverlayRasterizer raster(imageWidth, imageHeight, CVector2f(_ZoneMin.x, _ZoneMax.y), scaleX, scaleY);
+	CBitmap layer;
+
+	//------------------------------------------------------------------------
+	if (_DrawPacs && _GlobalRetriever) {
+		struct CEdge
+		{
+			CVector V0, V1;
+			uint8 Type;
+			bool operator<(const CEdge &o) const
+			{
+				if (V0.x != o.V0.x) return V0.x < o.V0.x;
+				if (V0.y != o.V0.y) return V0.y < o.V0.y;
+				if (V1.x != o.V1.x) return V1.x < o.V1.x;
+				if (V1.y != o.V1.y) return V1.y < o.V1.y;
+				return Type < o.Type;
+			}
+			bool operator==(const CEdge &o) const
+			{
+				return V0.x == o.V0.x && V0.y == o.V0.y && V1.x == o.V1.x && V1.y == o.V1.y && Type == o.Type;
+			}
+		};
+
+		// retriever only has local retrievers around refresh position loaded,
+		// so collect borders tile by tile as renderScreenshot() would
+		std::vector<CEdge> allEdges;
+		std::vector<std::pair<CLine, uint8>> edges;
+		uint32 vision = std::max(scaledWidth, scaledHeight);
+		for (float top = _ZoneMax.y; top > _ZoneMin.y; top -= scaledHeight) {
+			for (float left = _ZoneMin.x; left < _ZoneMax.x; left += scaledWidth) {
+				CVector center(left + scaledWidth / 2.f, top - scaledHeight / 2.f, 0.f);
+				_GlobalRetriever->refreshLrAroundNow(center, vision);
+
+				CAABBox box;
+				box.setCenter(center);
+				box.extend(CVector(left, top - scaledHeight, 0.f));
+				box.extend(CVector(left + scaledWidth, top, 0.f));
+
+				edges.clear();
+				_GlobalRetriever->getBorders(box, edges);
+				for (const auto &edge : edges) {
+					if (edge.second >= _PacsFilter.size() || !_PacsFilter[edge.second]) {
+						continue;
+					}
+					allEdges.push_back({ edge.first.V0, edge.first.V1, edge.second });
+				}
+			}
 		}
 
-		// igs in zone
-		updateIGDistance(zoneIg);
-	}
-}
+		// neighbour tiles return same borders
+		std::sort(allEdges.begin(), allEdges.end());
+		allEdges.erase(std::unique(allEdges.begin(), allEdges.end()), allEdges.end());
+
+		raster.clear();
+		for (const auto &edge : allEdges) {
+			raster.addLine(edge.V0, edge.V1, getPacsEdgeColor(edge.Type));
+		}
+		raster.rasterize(layer);
+		files.push_back(saveOverlayLayer(layer, "pacs"));
+	}
+
+	//------------------------------------------------------------------------
+	// zone tile borders snapped to 160m grid
+	float gridMinX = floor(_ZoneMin.x / ZONE_TILE_WH) * ZONE_TILE_WH;
+	float gridMaxX = ceil(_ZoneMax.x / ZONE_TILE_WH) * ZONE_TILE_WH;
+	float gridMinY = floor(_ZoneMin.y / ZONE_TILE_WH) * ZONE_TILE_WH;
+	float gridMaxY = ceil(_ZoneMax.y / ZONE_TILE_WH) * ZONE_TILE_WH;
+
+	if (_DrawGrid) {
+		CRGBA color(100, 100, 100, 255);
+
+		raster.clear();
+		for (float y = gridMinY; y <= gridMaxY; y += ZONE_TILE_WH) {
+			raster.addLine(CVector(gridMinX, y, 0.f), CVector(gridMaxX, y, 0.f), color);
+		}
+		for (float x = gridMinX; x <= gridMaxX; x += ZONE_TILE_WH) {
+			raster.addLine(CVector(x, gridMinY, 0.f), CVector(x, gridMaxY, 0.f), color);
+		}
+		raster.rasterize(layer);
+		files.push_back(saveOverlayLayer(layer, "grid"));
+	}
+
+	if (_DrawGridNames) {
+		CRGBA color(250, 250, 250, 255);
+		// roughly 1/4 of tile width for '12_AB'
+		uint glyphScale = std::max(1u, (uint)(ZONE_TILE_WH * scaleX / 120.f));
+
+		raster.clear();
+		for (float y = gridMaxY; y > gridMinY; y -= ZONE_TILE_WH) {
+			for (float x = gridMinX; x < gridMaxX; x += ZONE_TILE_WH) {
+				float tx = x + ZONE_TILE_WH / 2.f;
+				float ty = y - ZONE_TILE_WH / 2.f;
+				raster.addLabel(CVector(tx, ty, 0.f), getZoneNameFromId(getZoneIdFromPos(tx, ty)), color, glyphScale);
+			}
+		}
+		raster.rasterize(layer);
+		files.push_back(saveOverlayLayer(layer, "grid_names"));
+	}
+
+	nlinfo("overlay layers for '%s' done in %.2fs", _MapName.c_str(), CTime::ticksToSecond(CTime::getPerformanceTime() - startTick));
+	return files;
+}
+
+//---------------------------------------------------------------------------
+std::string CMapRenderer::saveOverlayLayer(CBitmap &btm, const std::string &suffix)
+{
+	if (!CFile::isExists(_OutputDirectory)) {
+		nlinfo(">> creating directory {%s}", _OutputDirectory.c_str());
+		CFile::createDirectoryTree(_OutputDirectory);
+	}
+
+	std::string txName = _OutputDirectory + "/" + _MapName + "_" + suffix + ".png";
+	if (CFile::fileExists(txName)) {
+		txName = CFile::findNewFile(txName);
+	}
+
+	COFile fsDest(txName);
+	btm.writePNG(fsDest, 32);
+	return txName;
+}
+
+//----------------------------------------------------------------------------
+void CMapRenderer::loadZoneIG(const std::vector<std::string> &zoneTiles)
+{
+	LandscapeIGManager.loadArrayZoneIG(zoneTiles);
+
+	for (const auto &tile : zoneTiles) {
+		UInstanceGroup *zoneIg = LandscapeIGManager.getIG(tile);
+
+		// make sure tile has placeholder names
+		// (ie fyros_newbie has invalid outpost records from fyros continent)
+		if (!zoneIg) {
+			continue;
+		}
+
+		// outpost ruins
+		COutpostIG *outpost = _OutpostIGs.find(getZoneIdFromName(tile));
+		if (outpost) {
+			addOutpostBuildings(*outpost, zoneIg);
+		}
+
+		// igs in zone
+		updateIGDistance(zoneIg);
+	}
+}
 
 //----------------------------------------------------------------------------
 void CMapRenderer::unloadZoneIG(const std::vector<std::string> &zoneTiles)
 {
 	LandscapeIGManager.unloadArrayZoneIG(zoneTiles);
 	for (const auto &tile : zoneTiles) {
-		std::string lcTile = toLower(tile);
-		auto itOutpost = _OutpostIGs.find(lcTile);
-		if (itOutpost != _OutpostIGs.end() && itOutpost->second.IG) {
-			itOutpost->second.IG->removeFromScene(*scene);
-			delete (itOutpost->second.IG);
-			itOutpost->second.IG = nullptr;
+		COutpostIG *outpost = _OutpostIGs.find(getZoneIdFromName(tile));
+		if (outpost) {
+			removeOutpostBuildings(*outpost);
 		}
 	}
 }
@@ -1423,24 +2651,118 @@ std::string CMapRenderer::filenameWithSeasonSuffix(const std::string &filename)
 //----------------------------------------------------------------------------
 bool CMapRenderer::run()
 {
+	if (_Plan) {
+		// sheets only, no driver
+		loadSheets();
+		return runPlan();
+	}
+
+	if (_Jobs > 1 && !_Headless) {
+		// workers keep parent mode, output matches serial render only with the same render path
+		nlwarning("--jobs needs headless mode, rendering serially");
+		_Jobs = 1;
+	}
+	// map indices for in-process render
+	std::vector<uint> serialMaps;
+	for (uint i = 0; i < _Maps.size(); ++i) {
+		serialMaps.push_back(i);
+	}
+	bool batchStarted = false;
+	if (_Jobs > 1 && _AutoRender && !_OverlayLayersOnly && _Maps.size() > 1) {
+		// sheets are loaded once and shared with workers
+		loadSheets();
+		if (!startWorkers()) {
+			bool ok = runScheduler(serialMaps);
+			if (serialMaps.empty()) {
+				return ok;
+			}
+			nlwarning("no worker processes running, rendering %u maps serially", (uint)serialMaps.size());
+			batchStarted = true;
+			_Jobs = 1;
+		}
+	}
+
 	init();
 
 	//-----------------------------------------------------------------------
 	bool show = true;
 	bool resizable = false;
 	bool windowed = true;
-	driver->setDisplay(UDriver::CMode(800, 800, 32, windowed), show, resizable);
+	if (_OverlayLayersOnly) {
+		// cpu only, continent is loaded without scene/landscape
+		_Progress.batchStart(_Maps.size());
+		for (uint i = 0; i < _Maps.size(); ++i) {
+			_Progress.mapStart(_Maps[i], i);
+			if (loadContinent(_Maps[i])) {
+				// first written layer, pacs is skipped without retriever
+				std::vector<std::string> layers = renderOverlayLayers(_TileWidth, _TileHeight);
+				if (layers.empty()) {
+					_Progress.mapFailed("no overlay layer written");
+				} else {
+					_Progress.mapDone(layers.front());
+				}
+
+				unloadContinent();
+			} else {
+				_Progress.mapFailed("continent not found");
+			}
+		}
+		_Progress.batchDone();
+		return true;
+	}
+
+	if (_TileWidth == 0 || _TileHeight == 0) {
+		_TileWidth = defaultWindowWH;
+		_TileHeight = defaultWindowWH;
+	}
+
+	uint displayWidth = _TileWidth;
+	uint displayHeight = _TileHeight;
+	if (_Headless) {
+		if (!_AutoRender && !_Benchmark && _SingleScreenshot.empty() && _DaemonSource.empty() && _TileServerAddress.empty() && !_World && !_AutoTune) {
+			std::cout << "ERR: headless mode needs --auto-render, --render, --benchmark, --screenshot, --daemon, --tile-server, --world or --auto-tune" << std::endl;
+			return false;
+		}
+		if (_TileWidth > maxTileWH || _TileHeight > maxTileWH) {
+			nlwarning("tile size %dx%d over %d limit, clamping", _TileWidth, _TileHeight, maxTileWH);
+			_TileWidth = std::min(_TileWidth, maxTileWH);
+			_TileHeight = std::min(_TileHeight, maxTileWH);
+		}
+		// window is never shown, tiles go into offscreen target
+		// readback is clipped to window size, so window follows target size
+		show = false;
+		uint ssaa = getSupersample();
+		displayWidth = _TileWidth * ssaa;
+		displayHeight = _TileHeight * ssaa;
+	}
+
+	driver->setDisplay(UDriver::CMode(displayWidth, displayHeight, 32, windowed), show, resizable);
 	if (!driver->activate()) {
 		nlinfo("Failed to activate display");
 		std::cout << "Failed to activete display" << '\n';
 		return false;
 	}
 
-	uint windowWidth = driver->getWindowWidth();
-	uint windowHeight = driver->getWindowHeight();
+	if (!_Headless) {
+		// window manager may not give requested size
+		_TileWidth = driver->getWindowWidth();
+		_TileHeight = driver->getWindowHeight();
+	}
+	nlinfo("tile size %dx%d%s", _TileWidth, _TileHeight, _Headless ? " (headless)" : "");
+
+	uint windowWidth = _TileWidth;
+	uint windowHeight = _TileHeight;
 
+	if (_Supersample > 1 && !_Headless) {
+		nlwarning("ssaa needs offscreen target, use --headless, ssaa disabled");
+		_Supersample = 1;
+	}
 	if (_UseFXAA) {
+		// ssaa replaces fxaa, unless tile size limits it to 1x
 		fxaa = new NL3D::CFXAA(driver);
+		if (_Supersample > 1) {
+			nlinfo("ssaa %ux replaces fxaa", _Supersample);
+		}
 	}
 
 	driver->enableFog(false);
@@ -1475,7 +2797,6 @@ bool CMapRenderer::run()
 	scene->setMaxSkeletonsInNotCLodForm(1000000);
 	scene->setPolygonBalancingMode(UScene::PolygonBalancingOff);
 	// from old renderer
-	scene->enableLightingSystem(true);
 	scene->setAmbientGlobal(CRGBA::Black);
 	scene->enableShadowPolySmooth(true);
 	scene->setGroupLoadMaxPolygon("Fx", 100000);
@@ -1486,14 +2807,12 @@ bool CMapRenderer::run()
 	landscape = scene->createLandscape();
 	landscape->enableAdditive(true);
 	landscape->setUpdateLightingFrequency(0);
-	landscape->enableReceiveShadowMap(true);
 
 	// TODO: does not seem to be working,
 	// TODO: debug using getVisibleVeget (or smth)
 	landscape->enableVegetable(true);
-	landscape->setVegetableWind(CVector(0.5, 0.5, 0).normed(), 0.5, 1, 0);
-	landscape->setVegetableUpdateLightingFrequency(1 / 20.f);
 	landscape->setVegetableDensity(1.0f);
+	applySceneProfile();
 
 	if (_LandscapeVision == 0) {
 		_LandscapeVision = (std::max(windowWidth, windowHeight) + ZONE_TILE_WH) / 2;
@@ -1503,20 +2822,44 @@ bool CMapRenderer::run()
 	landscape->setRefineCenterAuto(_RefineCenterAuto); // true == use camera for center pos
 	landscape->setThreshold(_LandscapeThreshold);
 
+	//-----------------------------------------------------------------------
+	if (_Benchmark) {
+		return runBenchmark();
+	}
+
+	if (!_DaemonSource.empty()) {
+		return runDaemon();
+	}
+
+	if (!_TileServerAddress.empty()) {
+		return runTileServer();
+	}
+
+	if (_World) {
+		return runWorld();
+	}
+
+	if (_AutoTune) {
+		return runAutoTune();
+	}
+
 	//-----------------------------------------------------------------------
 	if (_AutoRender) {
 		if (_Maps.empty()) {
 			std::string msg = "No maps to render. Use '--render map1,map2,..' or set Maps={'map1,'map2'..} maps from cfg file.";
 			nlinfo("%s", msg.c_str());
 			std::cout << msg << std::endl;
+		} else if (_WorkerIn >= 0) {
+			return runWorker();
 		} else {
-			for (const auto &name : _Maps) {
-				if (loadContinent(name)) {
-					autoRender();
-
-					unloadContinent();
-				}
+			// batch is already started when scheduler falls back to serial render
+			if (!batchStarted) {
+				_Progress.batchStart(_Maps.size());
+			}
+			for (uint i : serialMaps) {
+				renderMap(i);
 			}
+			_Progress.batchDone();
 		}
 		return true;
 	}
@@ -1536,14 +2879,12 @@ bool CMapRenderer::run()
 		//scene->getCam().setPerspective (90.f/*(float)Pi/2.f*/, 1.33f, 0.1f, 1000);
 		scene->animate(CTime::ticksToSecond(CTime::getPerformanceTime()));
 		renderScene(_ViewCenter);
-		frameEnd();
-
-		driver->flush();
 
 		CBitmap renderBuffer;
 		renderBuffer.resize(windowWidth, windowHeight, CBitmap::RGBA);
+		readTile(renderBuffer);
 
-		driver->getBuffer(renderBuffer);
+		frameEnd();
 
 		COFile fsDest(_SingleScreenshot);
 		renderBuffer.writePNG(fsDest, 24);
@@ -1597,16 +2938,27 @@ bool CMapRenderer::run()
 
 		handleKeyboard();
 
+		TTicks tick = CTime::getPerformanceTime();
 		refreshContinent();
+		_FrameHistory.addStageTime(FrameRefresh, CTime::ticksToSecond(CTime::getPerformanceTime() - tick));
 
 		updateCamera();
 
 		// animate veget, trees
 		scene->animate(CTime::ticksToSecond(CTime::getPerformanceTime()));
 
+		// landscape refresh and render are timed inside renderScene
+		double refreshTime = _Stats.getStageTime(StageZones) + _Stats.getStageTime(StageZoneIG);
+		double renderTime = _Stats.getStageTime(StageRender) + _Stats.getStageTime(StageInverseZ) + _Stats.getStageTime(StageFxaa);
+
 		renderScene(_ViewCenter);
 
+		_FrameHistory.addStageTime(FrameRefresh, _Stats.getStageTime(StageZones) + _Stats.getStageTime(StageZoneIG) - refreshTime);
+		_FrameHistory.addStageTime(FrameRender, _Stats.getStageTime(StageRender) + _Stats.getStageTime(StageInverseZ) + _Stats.getStageTime(StageFxaa) - renderTime);
+
+		tick = CTime::getPerformanceTime();
 		renderOverlay();
+		_FrameHistory.addStageTime(FrameOverlay, CTime::ticksToSecond(CTime::getPerformanceTime() - tick));
 
 		frameEnd();
 
@@ -1624,138 +2976,1640 @@ bool CMapRenderer::run()
 }
 
 //---------------------------------------------------------------------------
-void CMapRenderer::updateCamera()
+bool CMapRenderer::renderMap(uint index)
 {
-#if 1
-	if (mouse) {
-		scene->getCam().setTransformMode(UTransformable::DirectMatrix);
-		scene->getCam().setMatrix(mouse->getViewMatrix());
+	const std::string &name = _Maps[index];
+	_Progress.mapStart(name, index);
+	_Stats.reset(name);
+	_Stats.begin(StageContinent);
+	bool loaded = loadContinent(name);
+	_Stats.end(StageContinent);
+	if (loaded) {
+		bool full = true;
+		if (_Preview) {
+			std::string preview = renderPreview(name);
+			full = !preview.empty() && !_PreviewOnly;
+			if (!preview.empty() && _PreviewOnly) {
+				_Progress.mapDone(preview);
+			}
+			// timing report covers full render only
+			_Stats.reset(name);
+			// full render rows replace preview as they complete
+			if (full) {
+				_PreviewFile = preview;
+				_PreviewWritten = CTime::getPerformanceTime();
+			}
+		}
+		if (full) {
+			autoRender();
+		}
+		_PreviewFile.clear();
+		_PreviewBitmap.reset();
+
+		unloadContinent();
 	} else {
-		CMatrix mtx = scene->getCam().getMatrix();
-		mtx.identity();
-		mtx.rotateX(-(float)Pi / 2);
-		mtx.setPos(_ViewCenter);
-		scene->getCam().setTransformMode(UTransformable::DirectMatrix);
-		scene->getCam().setMatrix(mtx);
+		_Progress.mapFailed("continent not found");
 	}
-	//pCam.lookAt (plistener->getViewMatrix().getPos (), arrayObj[selected]->getPos());
-#else
-	UCamera cam = scene->getCam();
-	//cam.setTransformMode(UTransformable::RotQuat);
-
-	// TODO: target could be selected from loaded IGs? (with coords and name/shape on overlay)
-	CVector camPos = _ViewCenter;
 
-	// TODO: fixed target at pyr street
-	CVector targetPos = _ViewCenter;
-	targetPos.x = 18689;
-	targetPos.y = -24504;
-	targetPos.z = 0.f;
+	// memory left behind by continent
+	CBitmap empty;
+	enforceMemoryBudget(sampleMemory(empty));
 
-	cam.lookAt(camPos, targetPos);
-#endif
+	return loaded;
 }
+
 //---------------------------------------------------------------------------
-void CMapRenderer::renderOverlayAuto(const CVector &viewCenter)
+std::string CMapRenderer::renderPreview(const std::string &name)
 {
-	// TODO: implement this
-	if (!text) return;
+	float scale = _Scale;
+	uint tileWidth = _TileWidth;
+	uint tileHeight = _TileHeight;
+	uint tileNear = _LandscapeTileNear;
+	bool tileNearLocked = _TileNearLocked;
+	float threshold = _RenderThreshold;
 
-	driver->setMatrixMode2D11();
+	if (!CFile::isExists(_OutputDirectory)) {
+		CFile::createDirectoryTree(_OutputDirectory);
+	}
+	std::string filename = _OutputDirectory + "/" + _MapName + ".preview.png";
+
+	const uint stages = sizeof(previewStages) / sizeof(previewStages[0]);
+	bool complete = true;
+	for (uint i = 0; i < stages && complete; ++i) {
+		const CPreviewStage &stage = previewStages[i];
+
+		_Scale = std::max(0.1f, scale * stage.Scale);
+		if (_Headless) {
+			uint width = (_ZoneMax.x - _ZoneMin.x) * _Scale;
+			uint height = (_ZoneMax.y - _ZoneMin.y) * _Scale;
+			_TileWidth = std::max(1u, std::min(width, previewTileWH));
+			_TileHeight = std::max(1u, std::min(height, previewTileWH));
+		}
+		_TileNearLocked = stage.FarBank || tileNearLocked;
+		_LandscapeTileNear = stage.FarBank ? 0 : tileNear;
+		_RenderThreshold = stage.Threshold;
+		if (stage.IGs && _SkipIGs) {
+			// zones added without igs are reloaded with them, unload keeps ig bookkeeping in sync
+			_SkipIGs = false;
+			unloadContinent();
+			loadContinent(name);
+		}
+		_SkipIGs = !stage.IGs;
 
-	uint windowHeight = driver->getWindowHeight();
-	uint fontSize = 18;
+		TTicks start = CTime::getPerformanceTime();
+		CBitmap bitmap;
+		autoRender(false, &bitmap, &complete);
+		if (!complete) {
+			break;
+		}
 
-	text->setColor(CRGBA(255, 255, 255, 255));
-	text->setFontSize(fontSize);
+		_PreviewFile = filename;
+		writePreview(bitmap);
+		_PreviewBitmap = bitmap;
 
-	text->setHotSpot(UTextContext::TopLeft);
-	text->printfAt(0.01f, 0.99f, "%s", _ContinentSheet.c_str());
-	text->printfAt(0.01f, 0.96f, "zone {%.f, %.f} {%.f, %.f}", _ZoneMin.x, _ZoneMin.y, _ZoneMax.x, _ZoneMax.y);
+		std::string msg = toString("preview %u/%u: '%s' %ux%u in %.2fs", i + 1, stages,
+		    filename.c_str(), bitmap.getWidth(), bitmap.getHeight(), CTime::ticksToSecond(CTime::getPerformanceTime() - start));
+		nlinfo("%s", msg.c_str());
+		std::cout << msg << std::endl;
+	}
 
-	text->setHotSpot(UTextContext::BottomLeft);
-	text->printfAt(0.01f, 0.01f, "ESC - break");
+	_PreviewFile.clear();
+	if (_SkipIGs) {
+		_SkipIGs = false;
+		unloadContinent();
+		loadContinent(name);
+	}
+	_Scale = scale;
+	_TileWidth = tileWidth;
+	_TileHeight = tileHeight;
+	_LandscapeTileNear = tileNear;
+	_TileNearLocked = tileNearLocked;
+	_RenderThreshold = threshold;
 
-	text->setHotSpot(UTextContext::BottomRight);
-	text->printfAt(0.99f, 0.01f, "{%.2f, %.2f}",
-	    (viewCenter.x - _ZoneMin.x) / (_ZoneMax.x - _ZoneMin.x),
-	    (_ZoneMax.y - viewCenter.y) / (_ZoneMax.y - _ZoneMin.y));
+	return complete ? filename : std::string();
 }
 
 //---------------------------------------------------------------------------
-void CMapRenderer::renderOverlay()
+void CMapRenderer::updatePreview(const CBitmap &rows, uint srcTop, uint top, uint height, uint fullHeight)
 {
-	if (!text) return;
+	uint width = rows.getWidth();
+	uint previewWidth = _PreviewBitmap.getWidth();
+	uint previewHeight = _PreviewBitmap.getHeight();
+	if (width == 0 || fullHeight == 0 || previewWidth == 0 || previewHeight == 0) {
+		return;
+	}
 
-	driver->setMatrixMode2D11();
+	// rows thinner than preview pixel are covered by next row
+	uint y0 = (uint64)top * previewHeight / fullHeight;
+	uint y1 = (uint64)(top + height) * previewHeight / fullHeight;
+	if (y1 > y0) {
+		CBitmap strip;
+		strip.resize(width, height, CBitmap::RGBA);
+		strip.blit(rows, 0, srcTop, width, height, 0, 0);
+		strip.resample(previewWidth, y1 - y0);
+		_PreviewBitmap.blit(strip, 0, 0, previewWidth, y1 - y0, 0, y0);
+	}
 
-	uint fontSize = 10;
-	uint windowHeight = driver->getWindowHeight();
-	float oow = 1.f / windowHeight;
-	float lineH = fontSize * oow;
+	// png encode of whole preview per row would slow down full render
+	TTicks now = CTime::getPerformanceTime();
+	if (top + height < fullHeight && CTime::ticksToSecond(now - _PreviewWritten) < previewWriteInterval) {
+		return;
+	}
+	_PreviewWritten = now;
+	writePreview(_PreviewBitmap);
+}
 
-	text->setColor(CRGBA(255, 255, 255, 255));
-	text->setFontSize(fontSize);
-	if (mouse) {
-		text->setHotSpot(UTextContext::TopRight);
-		text->printfAt(0.99f, 0.99f, "mouse {%s}", mouse->getViewMatrix().getPos().toString().c_str());
-		text->printfAt(0.99f, 0.99f - lineH, "model {%s}", mouse->getModelMatrix().getPos().toString().c_str());
+//---------------------------------------------------------------------------
+bool CMapRenderer::writePreview(CBitmap &bitmap)
+{
+	// replace in one step so viewer never sees half written preview
+	std::string tmp = _PreviewFile + ".tmp";
+	{
+		COFile file(tmp);
+		bitmap.writePNG(file, 24);
 	}
-	text->setHotSpot(UTextContext::BottomRight);
-	uint fps = _FrameDelta > 0 ? (uint)(1.f / _FrameDelta) : 0;
-	text->printfAt(0.99f, 0.01f, "%s%s%s%s%dfps (%.2fms)",
-	    _InverseZ ? "invZ " : "",
-	    _SlowDown ? "slowdown " : "",
-	    _UseLight ? "light " : "",
-	    _HideTrees ? "no-trees" : "",
-	    fps,
-	    (float)(_FrameDelta * 1000.f));
-	text->setHotSpot(UTextContext::BottomLeft);
+	if (!CFile::moveFile(_PreviewFile, tmp)) {
+		nlwarning("unable to write '%s'", _PreviewFile.c_str());
+		return false;
+	}
+	return true;
+}
 
-	CMatrix mtx = scene->getCam().getMatrix();
-	CVector center = mtx.getPos();
+//---------------------------------------------------------------------------
+uint64 CMapRenderer::estimateMapPixels(const std::string &name)
+{
+	std::string continent, mapName;
+	CVector2f minPos, maxPos;
+	if (!getMapArea(name, continent, mapName, minPos, maxPos)) {
+		return 0;
+	}
+	return (uint64)((maxPos.x - minPos.x) * _Scale) * (uint64)((maxPos.y - minPos.y) * _Scale);
+}
 
-	text->printfAt(0.01f, 0.01f, "%s/%s:{%.1f, %.1f, %.1f} vision:%d tile:%d znear:%.f, zfar:%.f",
-	    _Season.c_str(), _ActiveContinent ? _MapName.c_str() : "(no continent)",
-	    center.x, center.y, center.z,
-	    _LandscapeVision, _LandscapeTileNear,
-		_ZNear, _ZFar);
+//---------------------------------------------------------------------------
+// elapsed seconds, tile count and rendered pixels per tile (with ssaa) from <map>.timing.json
+static bool readTimingReport(const std::string &filename, double &elapsed, uint &tiles, uint64 &tilePixels)
+{
+	FILE *fp = fopen(filename.c_str(), "rb");
+	if (!fp) return false;
+
+	std::string text;
+	char buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+		text.append(buf, n);
+	}
+	fclose(fp);
 
-	//
-	fontSize = 10;
-	text->setFontSize(fontSize);
-	text->setColor(CRGBA(200, 200, 200, 255));
-	text->setHotSpot(UTextContext::TopLeft);
-	uint liney = windowHeight;
-	for (const auto &it : KeyBindings) {
-		if (it.id.empty()) continue;
+	std::string::size_type pos = text.find("\"elapsed\":");
+	std::string::size_type tilesPos = text.find("\"tiles\":");
+	if (pos == std::string::npos || tilesPos == std::string::npos) {
+		return false;
+	}
+	elapsed = atof(text.c_str() + pos + 10);
+	tiles = (uint)atoi(text.c_str() + tilesPos + 8);
+
+	// reports from before tile size was written are skipped
+	uint width = 0, height = 0, ssaa = 1;
+	std::string::size_type sizePos = text.find("\"tile_size\":");
+	std::string::size_type ssaaPos = text.find("\"ssaa\":");
+	if (sizePos == std::string::npos || sscanf(text.c_str() + sizePos + 12, " [%u , %u]", &width, &height) != 2) {
+		return false;
+	}
+	if (ssaaPos != std::string::npos) {
+		ssaa = std::max(1, atoi(text.c_str() + ssaaPos + 7));
+	}
+	tilePixels = (uint64)width * height * ssaa * ssaa;
+	return tiles > 0 && elapsed > 0 && tilePixels > 0;
+}
 
-		if (it.id == "---") {
-			liney -= fontSize;
-			continue;
-		}
+// image size from png IHDR chunk
+static bool readPngSize(const std::string &filename, uint &width, uint &height)
+{
+	FILE *fp = fopen(filename.c_str(), "rb");
+	if (!fp) return false;
 
-		std::string keyName = CEventKey::getStringFromKey(it.Key);
-		if (startsWith(keyName, "Key")) {
-			keyName = keyName.substr(3);
-		}
-		std::string desc;
-		if (!it.Descr.empty()) {
-			desc = " (" + it.Descr + ")";
-		}
+	uint8 header[24];
+	bool ok = fread(header, 1, sizeof(header), fp) == sizeof(header) && memcmp(header + 1, "PNG", 3) == 0;
+	fclose(fp);
+	if (!ok) return false;
 
-		text->printfAt(0.01f, (float)liney / windowHeight, "(%s) %s%s", keyName.c_str(), it.id.c_str(), desc.c_str());
-		liney -= fontSize + 4;
+	width = (header[16] << 24) | (header[17] << 16) | (header[18] << 8) | header[19];
+	height = (header[20] << 24) | (header[21] << 16) | (header[22] << 8) | header[23];
+	return width > 0 && height > 0;
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::runPlan()
+{
+	if (_Maps.empty()) {
+		std::cout << "No maps to plan. Use '--render map1,map2,..' or set Maps={'map1,'map2'..} maps from cfg file." << std::endl;
+		return false;
+	}
+	if (_TileWidth == 0 || _TileHeight == 0) {
+		_TileWidth = defaultWindowWH;
+		_TileHeight = defaultWindowWH;
+	}
+	if (_Scale <= 0.1f) {
+		_Scale = 0.1f;
 	}
 
-	// center cross
-	{
-		CLineColor line;
-		line.Color0 = CRGBA::White;
-		line.Color1 = CRGBA::White;
+	//------------------------------------------------------------------------
+	// calibrate from timing reports and pngs of earlier renders in output directory,
+	// time is per rendered pixel so reports with other tile size or ssaa still apply
+	std::map<std::string, double> mapPixelTime;
+	double totalElapsed = 0.0;
+	uint64 totalPixels = 0;
+	uint64 pngBytes = 0;
+	uint64 pngPixels = 0;
+
+	std::vector<std::string> files;
+	if (CFile::isDirectory(_OutputDirectory)) {
+		CPath::getPathContent(_OutputDirectory, false, false, true, files);
+	}
+	for (const auto &path : files) {
+		std::string name = CFile::getFilename(path);
+		if (name.size() <= 12 || name.substr(name.size() - 12) != ".timing.json") continue;
+
+		double elapsed;
+		uint tiles;
+		uint64 tilePixels;
+		if (!readTimingReport(path, elapsed, tiles, tilePixels)) continue;
+
+		std::string mapName = name.substr(0, name.size() - 12);
+		mapPixelTime[mapName] = elapsed / ((double)tiles * tilePixels);
+		totalElapsed += elapsed;
+		totalPixels += tiles * tilePixels;
+
+		uint width, height;
+		std::string png = CFile::getPath(path) + mapName + ".png";
+		if (readPngSize(png, width, height)) {
+			pngBytes += CFile::getFileSize(png);
+			pngPixels += (uint64)width * height;
+		}
+	}
+	uint ssaa = getSupersample();
+	double planTilePixels = (double)_TileWidth * _TileHeight * ssaa * ssaa;
+	double defaultTileTime = totalPixels > 0 ? totalElapsed / totalPixels * planTilePixels : 0.0;
+	double bytesPerPixel = pngPixels > 0 ? (double)pngBytes / pngPixels : 3.0;
 
-		line = CLine(CVector(0.4, 0.5, 0), CVector(0.6, 0.5, 0));
-		driver->drawLine(line, pacsMaterial);
+	nlinfo("plan: calibrated from %u timing reports (%.3fs per tile), %s png size", (uint)mapPixelTime.size(), defaultTileTime,
+	    pngPixels > 0 ? "measured" : "raw rgb");
+
+	//------------------------------------------------------------------------
+	std::string planName = _OutputDirectory + "/plan.json";
+	if (!CFile::isExists(_OutputDirectory)) {
+		CFile::createDirectoryTree(_OutputDirectory);
+	}
+	FILE *json = fopen(planName.c_str(), "w");
+	if (!json) {
+		nlwarning("failed to open '%s' for writing", planName.c_str());
+	}
+	if (json) {
+		fprintf(json, "{\n  \"scale\": %.4f,\n  \"tile\": [%u, %u],\n  \"calibration\": { \"reports\": %u, \"tile_time\": %.6f, \"png_bytes_per_pixel\": %.4f, \"png_measured\": %s },\n  \"maps\": [",
+		    _Scale, _TileWidth, _TileHeight, (uint)mapPixelTime.size(), defaultTileTime, bytesPerPixel, pngPixels > 0 ? "true" : "false");
+	}
+
+	std::cout << toString("%-24s %9s %6s %6s %6s %10s %10s %10s", "map", "size", "tiles", "zones", "files", "memory", "output", "time") << std::endl;
+
+	// zone file lookups are shared between maps on same continent
+	std::map<TZoneId, bool> zoneFiles;
+	std::vector<double> mapTimes;
+	uint64 peakMemory = 0;
+	uint64 totalOutput = 0;
+	uint planTiles = 0;
+	uint written = 0;
+	bool ok = true;
+
+	for (uint i = 0; i < _Maps.size(); ++i) {
+		std::string continent, mapName;
+		CVector2f minPos, maxPos;
+		if (!getMapArea(_Maps[i], continent, mapName, minPos, maxPos)) {
+			std::cout << toString("%-24s continent not found", _Maps[i].c_str()) << std::endl;
+			ok = false;
+			continue;
+		}
+
+		// same tile grid as renderScreenshot()
+		uint width = (maxPos.x - minPos.x) * _Scale;
+		uint height = (maxPos.y - minPos.y) * _Scale;
+		uint tilesX = (width + _TileWidth - 1) / _TileWidth;
+		uint tilesY = (height + _TileHeight - 1) / _TileHeight;
+		float tileMetersX = (float)_TileWidth / _Scale;
+		float tileMetersY = (float)_TileHeight / _Scale;
+
+		// zones under each tile
+		std::set<TZoneId> mapZones;
+		uint maxTileZones = 0;
+		std::ofstream csv((_OutputDirectory + "/" + mapName + ".plan.csv").c_str());
+		csv << "x,y,zones,zone_files,names\n";
+		for (uint ty = 0; ty < tilesY; ++ty) {
+			for (uint tx = 0; tx < tilesX; ++tx) {
+				float left = minPos.x + tx * tileMetersX;
+				float top = maxPos.y - ty * tileMetersY;
+				float right = std::min(left + tileMetersX, maxPos.x);
+				float bottom = std::max(top - tileMetersY, minPos.y);
+
+				std::string names;
+				uint zones = 0;
+				uint existing = 0;
+				for (float y = floorf(bottom / ZONE_TILE_WH) * ZONE_TILE_WH; y < top; y += ZONE_TILE_WH) {
+					for (float x = floorf(left / ZONE_TILE_WH) * ZONE_TILE_WH; x < right; x += ZONE_TILE_WH) {
+						TZoneId id = getZoneIdFromPos(x + ZONE_TILE_WH / 2, y + ZONE_TILE_WH / 2);
+						if (id == ZONE_ID_INVALID) continue;
+
+						auto it = zoneFiles.find(id);
+						if (it == zoneFiles.end()) {
+							it = zoneFiles.insert(std::make_pair(id, !CPath::lookup(getZoneNameFromId(id) + ".zonel", false, false).empty())).first;
+						}
+						++zones;
+						existing += it->second ? 1 : 0;
+						mapZones.insert(id);
+						if (!names.empty()) names += " ";
+						names += getZoneNameFromId(id);
+					}
+				}
+				maxTileZones = std::max(maxTileZones, zones);
+				csv << tx << "," << ty << "," << zones << "," << existing << "," << names << "\n";
+			}
+		}
+
+		uint mapZoneFiles = 0;
+		for (TZoneId id : mapZones) {
+			mapZoneFiles += zoneFiles[id] ? 1 : 0;
+		}
+
+		// canvas (or one tile row when streaming), readback tile and supersampled tile
+		bool bands = useBandStreaming(width, height);
+		uint64 canvas = (uint64)width * (bands ? std::min(_TileHeight, height) : height) * 4;
+		uint64 memory = canvas + (uint64)_TileWidth * _TileHeight * 4 * (ssaa > 1 ? 1 + ssaa * ssaa : 1);
+		uint64 output = (uint64)((double)width * height * bytesPerPixel);
+
+		auto timeIt = mapPixelTime.find(mapName);
+		double tileTime = timeIt != mapPixelTime.end() ? timeIt->second * planTilePixels : defaultTileTime;
+		double seconds = tileTime * tilesX * tilesY;
+
+		mapTimes.push_back(seconds);
+		peakMemory = std::max(peakMemory, memory);
+		totalOutput += output;
+		planTiles += tilesX * tilesY;
+
+		std::cout << toString("%-24s %4ux%-4u %6u %6u %6u %8.1fMB %8.1fMB %9.1fs%s", mapName.c_str(), width, height,
+		                 tilesX * tilesY, (uint)mapZones.size(), mapZoneFiles, memory / 1048576.0, output / 1048576.0,
+		                 seconds, bands ? " (bands)" : "")
+		          << std::endl;
+
+		if (json) {
+			fprintf(json, "%s\n    { \"map\": \"%s\", \"continent\": \"%s\", \"area\": [%.2f, %.2f, %.2f, %.2f], \"width\": %u, \"height\": %u, "
+			              "\"tiles_x\": %u, \"tiles_y\": %u, \"zones\": %u, \"zone_files\": %u, \"max_tile_zones\": %u, "
+			              "\"memory\": %" NL_I64 "u, \"band_streaming\": %s, \"output\": %" NL_I64 "u, \"time\": %.3f, \"time_calibrated\": %s }",
+			    written++ > 0 ? "," : "", CRenderStats::jsonEscape(mapName).c_str(), CRenderStats::jsonEscape(continent).c_str(),
+			    minPos.x, minPos.y, maxPos.x, maxPos.y, width, height, tilesX, tilesY, (uint)mapZones.size(), mapZoneFiles, maxTileZones,
+			    memory, bands ? "true" : "false", output, seconds, timeIt != mapPixelTime.end() ? "true" : "false");
+		}
+	}
+
+	// longest first onto least loaded worker, same order as --jobs scheduler
+	std::vector<double> sorted = mapTimes;
+	std::sort(sorted.begin(), sorted.end(), std::greater<double>());
+	std::vector<double> workers(std::max((uint)1, std::min(_Jobs, (uint)sorted.size())), 0.0);
+	for (double t : sorted) {
+		*std::min_element(workers.begin(), workers.end()) += t;
+	}
+	double serial = 0.0;
+	for (double t : mapTimes) {
+		serial += t;
+	}
+	double wall = workers.empty() ? 0.0 : *std::max_element(workers.begin(), workers.end());
+
+	std::cout << toString("total: %u maps, %u tiles, peak %.1fMB, output %.1fMB, time %.1fs (%.1fs with %u jobs)",
+	                 (uint)mapTimes.size(), planTiles, peakMemory / 1048576.0, totalOutput / 1048576.0, serial, wall, (uint)workers.size())
+	          << std::endl;
+
+	if (json) {
+		fprintf(json, "\n  ],\n  \"total\": { \"maps\": %u, \"tiles\": %u, \"peak_memory\": %" NL_I64 "u, \"output\": %" NL_I64 "u, \"time\": %.3f, \"jobs\": %u, \"wall_time\": %.3f }\n}\n",
+		    (uint)mapTimes.size(), planTiles, peakMemory, totalOutput, serial, (uint)workers.size(), wall);
+		fclose(json);
+	}
+
+	return ok;
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::startWorkers()
+{
+#ifdef NL_OS_UNIX
+	uint jobs = std::min(_Jobs, (uint)_Maps.size());
+	nlinfo("rendering %u maps with %u worker processes", (uint)_Maps.size(), jobs);
+
+	// batch_start goes out once, workers report their maps into same stream
+	_Progress.batchStart(_Maps.size());
+	// nothing buffered may be written twice
+	fflush(nullptr);
+	// write to crashed worker must not kill scheduler
+	signal(SIGPIPE, SIG_IGN);
+
+	for (uint i = 0; i < jobs; ++i) {
+		sint cmd[2], result[2];
+		if (pipe(cmd) < 0 || pipe(result) < 0) {
+			nlwarning("pipe: %s", strerror(errno));
+			break;
+		}
+
+		sint pid = fork();
+		if (pid < 0) {
+			nlwarning("fork: %s", strerror(errno));
+			::close(cmd[0]);
+			::close(cmd[1]);
+			::close(result[0]);
+			::close(result[1]);
+			break;
+		}
+
+		if (pid == 0) {
+			// worker keeps only its own pipe ends
+			for (const auto &w : _Workers) {
+				::close(w.CmdFd);
+				::close(w.ResultFd);
+			}
+			_Workers.clear();
+			::close(cmd[1]);
+			::close(result[0]);
+
+			_WorkerIn = cmd[0];
+			_WorkerOut = result[1];
+			_Jobs = 1;
+			// one context per process, parent mode is kept (--jobs needs --headless)
+			return true;
+		}
+
+		::close(cmd[0]);
+		::close(result[1]);
+		_Workers.push_back({ pid, cmd[1], result[0], -1, "" });
+	}
+#else
+	nlwarning("--jobs is only supported on unix, rendering serially");
+#endif
+	return false;
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::runScheduler(std::vector<uint> &remaining)
+{
+	remaining.clear();
+	if (_Workers.empty()) {
+		// nothing started, every map is rendered in this process
+		for (uint i = 0; i < _Maps.size(); ++i) {
+			remaining.push_back(i);
+		}
+		return true;
+	}
+
+	bool ok = true;
+#ifdef NL_OS_UNIX
+	// largest canvas first so last map to finish is a short one
+	std::vector<std::pair<uint64, uint>> order;
+	for (uint i = 0; i < _Maps.size(); ++i) {
+		order.push_back(std::make_pair(estimateMapPixels(_Maps[i]), i));
+	}
+	std::stable_sort(order.begin(), order.end(), [](const std::pair<uint64, uint> &a, const std::pair<uint64, uint> &b) {
+		return a.first > b.first;
+	});
+	std::deque<uint> queue;
+	for (const auto &it : order) {
+		queue.push_back(it.second);
+	}
+
+	uint done = 0;
+	uint failed = 0;
+	auto dispatch = [&](CWorkerProcess &w) {
+		if (queue.empty()) {
+			// worker exits when command pipe is closed
+			if (w.CmdFd >= 0) {
+				::close(w.CmdFd);
+				w.CmdFd = -1;
+			}
+			return;
+		}
+		w.Map = queue.front();
+		queue.pop_front();
+		std::string line = toString("%u\n", w.Map);
+		if (write(w.CmdFd, line.c_str(), line.size()) != (ssize_t)line.size()) {
+			nlwarning("worker %d: %s", w.Pid, strerror(errno));
+		}
+	};
+
+	for (auto &w : _Workers) {
+		dispatch(w);
+	}
+
+	for (;;) {
+		std::vector<pollfd> fds;
+		std::vector<uint> ids;
+		for (uint i = 0; i < _Workers.size(); ++i) {
+			if (_Workers[i].ResultFd >= 0) {
+				fds.push_back({ _Workers[i].ResultFd, POLLIN, 0 });
+				ids.push_back(i);
+			}
+		}
+		if (fds.empty()) {
+			break;
+		}
+		if (::poll(&fds[0], fds.size(), -1) < 0) {
+			if (errno == EINTR) continue;
+			nlwarning("poll: %s", strerror(errno));
+			break;
+		}
+
+		for (uint i = 0; i < fds.size(); ++i) {
+			if (!fds[i].revents) continue;
+			CWorkerProcess &w = _Workers[ids[i]];
+
+			char buf[256];
+			ssize_t n = read(w.ResultFd, buf, sizeof(buf));
+			if (n <= 0) {
+				if (n < 0 && errno == EINTR) continue;
+				if (w.Map >= 0) {
+					nlwarning("worker %d exited while rendering '%s'", w.Pid, _Maps[w.Map].c_str());
+					ok = false;
+					++failed;
+				}
+				::close(w.ResultFd);
+				w.ResultFd = -1;
+				if (w.CmdFd >= 0) {
+					::close(w.CmdFd);
+					w.CmdFd = -1;
+				}
+				continue;
+			}
+
+			w.Buffer.append(buf, n);
+			std::string::size_type pos;
+			while ((pos = w.Buffer.find('\n')) != std::string::npos) {
+				std::string line = w.Buffer.substr(0, pos);
+				w.Buffer.erase(0, pos + 1);
+				if (line.find(" ok") != std::string::npos) {
+					++done;
+				} else {
+					++failed;
+				}
+				w.Map = -1;
+				dispatch(w);
+			}
+		}
+
+		// every worker is gone, nothing left to hand out to
+		bool alive = false;
+		for (const auto &w : _Workers) {
+			alive = alive || w.ResultFd >= 0;
+		}
+		if (!alive && !queue.empty()) {
+			nlwarning("no workers left, %u maps left for serial render", (uint)queue.size());
+			remaining.assign(queue.begin(), queue.end());
+			break;
+		}
+	}
+
+	for (auto &w : _Workers) {
+		if (w.CmdFd >= 0) ::close(w.CmdFd);
+		if (w.ResultFd >= 0) ::close(w.ResultFd);
+		int status = 0;
+		if (waitpid(w.Pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			ok = false;
+		}
+	}
+	_Workers.clear();
+
+	nlinfo("parallel render: %u maps done, %u failed", done, failed);
+	_Progress.setMapsDone(done + failed);
+	if (remaining.empty()) {
+		_Progress.batchDone();
+	}
+#endif
+	return ok;
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::runWorker()
+{
+#ifdef NL_OS_UNIX
+	std::string buffer;
+	char buf[256];
+	for (;;) {
+		std::string::size_type pos = buffer.find('\n');
+		if (pos == std::string::npos) {
+			ssize_t n = read(_WorkerIn, buf, sizeof(buf));
+			if (n < 0 && errno == EINTR) continue;
+			if (n <= 0) break;
+			buffer.append(buf, n);
+			continue;
+		}
+
+		uint index;
+		bool valid = fromString(buffer.substr(0, pos), index) && index < _Maps.size();
+		buffer.erase(0, pos + 1);
+
+		bool loaded = valid && renderMap(index);
+		std::string line = toString("%u %s\n", index, loaded ? "ok" : "failed");
+		if (write(_WorkerOut, line.c_str(), line.size()) != (ssize_t)line.size()) {
+			break;
+		}
+	}
+
+	::close(_WorkerIn);
+	::close(_WorkerOut);
+	_WorkerIn = -1;
+	_WorkerOut = -1;
+#endif
+	return true;
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::runDaemon()
+{
+	CJobServer server;
+	if (!server.open(_DaemonSource)) {
+		std::cout << "ERR: cannot open job source '" << _DaemonSource << "'" << std::endl;
+		return false;
+	}
+
+	std::deque<CRenderJob> queue;
+	bool quit = false;
+	while (!quit) {
+		// block only when there is nothing to render
+		server.poll(queue, queue.empty() ? -1 : 0);
+		if (queue.empty()) {
+			if (server.isFinished()) {
+				break;
+			}
+			continue;
+		}
+
+		CRenderJob job = queue.front();
+		queue.pop_front();
+		std::string id = CRenderStats::jsonEscape(job.Id);
+
+		if (job.Command == "quit") {
+			server.reply(job.Client, toString("{\"event\":\"quit\",\"id\":\"%s\",\"dropped\":%u}", id.c_str(), (uint)queue.size()));
+			quit = true;
+			break;
+		}
+
+		server.reply(job.Client, toString("{\"event\":\"started\",\"id\":\"%s\",\"map\":\"%s\"}",
+		    id.c_str(), CRenderStats::jsonEscape(job.Map).c_str()));
+
+		// continent is kept if same as previous job
+		std::string continent = _ActiveContinent ? _ContinentSheet : "";
+		std::string loadedSeason = _LoadedSeason;
+
+		TTicks start = CTime::getPerformanceTime();
+		std::string output, error;
+		if (runJob(job, output, error)) {
+			bool warm = !continent.empty() && continent == _ContinentSheet && loadedSeason == _LoadedSeason;
+			server.reply(job.Client, toString("{\"event\":\"done\",\"id\":\"%s\",\"map\":\"%s\",\"output\":\"%s\",\"elapsed\":%.3f,\"warm\":%s}",
+			    id.c_str(), CRenderStats::jsonEscape(job.Map).c_str(), CRenderStats::jsonEscape(output).c_str(),
+			    CTime::ticksToSecond(CTime::getPerformanceTime() - start), warm ? "true" : "false"));
+		} else {
+			server.reply(job.Client, toString("{\"event\":\"failed\",\"id\":\"%s\",\"error\":\"%s\"}",
+			    id.c_str(), CRenderStats::jsonEscape(error).c_str()));
+		}
+
+		// continent stays loaded, only drop caches
+		CBitmap empty;
+		enforceMemoryBudget(sampleMemory(empty));
+	}
+
+	unloadContinent();
+	return true;
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::runJob(const CRenderJob &job, std::string &output, std::string &error)
+{
+	float scale = _Scale;
+	if (!job.Scale.empty()) {
+		// plain number is px per meter
+		float px = 0.f;
+		scale = job.Scale.find(':') == std::string::npos ? (fromString(job.Scale, px) ? px : 0.f) : parseScale(job.Scale);
+		if (scale <= 0.f) {
+			error = "invalid scale '" + job.Scale + "'";
+			return false;
+		}
+	}
+
+	// daemon settings, restored after job
+	std::string season = _Season;
+	float oldScale = _Scale;
+	std::string outputDirectory = _OutputDirectory;
+	bool drawPacs = _DrawPacs;
+	bool drawGrid = _DrawGrid;
+	bool drawGridNames = _DrawGridNames;
+	bool overlayLayers = _OverlayLayers;
+
+	if (!job.Season.empty()) {
+		setSeason(job.Season);
+	}
+	_Scale = scale;
+	_DrawPacs = job.Pacs;
+	_DrawGrid = job.Grid;
+	_DrawGridNames = job.GridNames;
+	_OverlayLayers = job.OverlayLayers;
+
+	std::string name;
+	if (!job.Output.empty()) {
+		if (toLower(CFile::getExtension(job.Output)) == "png") {
+			_OutputDirectory = CFile::getPath(job.Output);
+			if (_OutputDirectory.empty()) {
+				_OutputDirectory = ".";
+			}
+			name = CFile::getFilenameWithoutExtension(job.Output);
+		} else {
+			_OutputDirectory = job.Output;
+		}
+	}
+
+	_Stats.reset(job.Map);
+	_Stats.begin(StageContinent);
+	bool loaded = loadContinent(job.Map);
+	_Stats.end(StageContinent);
+	if (loaded) {
+		if (!name.empty()) {
+			_MapName = name;
+		}
+		if (job.HasRegion) {
+			_ZoneMin = job.Min;
+			_ZoneMax = job.Max;
+			_ZoneCenter = CVector((job.Min.x + job.Max.x) / 2, (job.Min.y + job.Max.y) / 2, _ZoneCenter.z);
+		}
+		_Progress.mapStart(_MapName, 0);
+		output = autoRender();
+	} else {
+		error = "continent not found";
+	}
+
+	setSeason(season);
+	_Scale = oldScale;
+	_OutputDirectory = outputDirectory;
+	_DrawPacs = drawPacs;
+	_DrawGrid = drawGrid;
+	_DrawGridNames = drawGridNames;
+	_OverlayLayers = overlayLayers;
+
+	return loaded;
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::runTileServer()
+{
+	// tile key has continent, area, scale and season, everything else
+	// goes into settings hash so tiles from other settings are not served
+	std::string continentSheet = _ContinentSheet;
+	std::string season = _Season;
+	CVector2f zoneMin = _ZoneMin;
+	CVector2f zoneMax = _ZoneMax;
+	float scale = _Scale;
+	_ContinentSheet.clear();
+	_Season.clear();
+	_ZoneMin = _ZoneMax = CVector2f(0, 0);
+	_Scale = 0;
+	std::string settings = CRenderCheckpoint::hashSettings(getRenderSettings());
+	_ContinentSheet = continentSheet;
+	_Season = season;
+	_ZoneMin = zoneMin;
+	_ZoneMax = zoneMax;
+	_Scale = scale;
+
+	std::string directory = _TileCacheDirectory.empty() ? _OutputDirectory + "/tiles" : _TileCacheDirectory;
+	CTileCache cache;
+	cache.init(_TileCacheMemory, CPath::standardizePath(directory) + settings, _TileCacheDisk);
+
+	CTileServer server(cache);
+	server.setSeason(_Season);
+	server.setZoomRange(tileMinZoom, tileMaxZoom);
+	if (!server.open(_TileServerAddress)) {
+		std::cout << "ERR: cannot open tile server on '" << _TileServerAddress << "'" << std::endl;
+		return false;
+	}
+
+	for (;;) {
+		// block only when there is nothing to render
+		server.poll(server.hasPending() ? 0 : -1);
+
+		CTileKey key;
+		if (!server.nextTile(key)) {
+			continue;
+		}
+
+		TTicks start = CTime::getPerformanceTime();
+		std::string png;
+		renderTile(key, png);
+		nlinfo("tile %s: %u bytes in %.3fs", key.toString().c_str(), (uint)png.size(),
+		    CTime::ticksToSecond(CTime::getPerformanceTime() - start));
+		server.complete(key, png);
+
+		// continent stays loaded, only drop caches
+		CBitmap empty;
+		enforceMemoryBudget(sampleMemory(empty));
+	}
+
+	return true;
+}
+
+//---------------------------------------------------------------------------
+void CMapRenderer::renderTile(const CTileKey &key, std::string &png)
+{
+	png.clear();
+
+	float size = key.getSize();
+	CVector2f min(key.getLeft(), key.getTop() - size);
+	CVector2f max(key.getLeft() + size, key.getTop());
+
+	// every continent under tile, loaded one first so it is not reloaded
+	const CWorldSheet *world = dynamic_cast<const CWorldSheet *>(SheetMngr.get(CSheetId("ryzom.world")));
+	std::vector<std::pair<std::string, CWorldArea>> continents;
+	for (const auto &cont : world->ContLocs) {
+		CWorldArea area;
+		area.Min = CVector2f(std::min(cont.MinX, cont.MaxX), std::min(cont.MinY, cont.MaxY));
+		area.Max = CVector2f(std::max(cont.MinX, cont.MaxX), std::max(cont.MinY, cont.MaxY));
+		if (area.Max.x <= min.x || area.Min.x >= max.x || area.Max.y <= min.y || area.Min.y >= max.y) {
+			continue;
+		}
+		if (cont.ContinentName == _ContinentSheet) {
+			continents.insert(continents.begin(), std::make_pair(cont.ContinentName, area));
+		} else {
+			continents.push_back(std::make_pair(cont.ContinentName, area));
+		}
+	}
+	if (continents.empty()) {
+		return;
+	}
+
+	setSeason(key.Season);
+	_Stats.reset(key.toString());
+
+	// offscreen target is exactly one server tile, window size is fixed so frame is cropped
+	float scale = _Scale;
+	uint tileWidth = _TileWidth;
+	uint tileHeight = _TileHeight;
+	_Scale = TILE_PIXELS / size;
+	if (_Headless) {
+		_TileWidth = TILE_PIXELS;
+		_TileHeight = TILE_PIXELS;
+		_TileSizeLocked = true;
+	}
+
+	// tile on continent edge is merged same way as world pyramid tiles
+	CBitmap bitmap;
+	std::vector<CWorldArea> rendered;
+	for (const auto &it : continents) {
+		_Stats.begin(StageContinent);
+		bool loaded = loadContinent(it.first);
+		_Stats.end(StageContinent);
+		if (!loaded) {
+			continue;
+		}
+
+		_ZoneMin = min;
+		_ZoneMax = max;
+		_ZoneCenter = CVector((min.x + max.x) / 2, (min.y + max.y) / 2, _ZoneCenter.z);
+
+		CBitmap part;
+		autoRender(false, &part);
+		if (part.getWidth() != TILE_PIXELS || part.getHeight() != TILE_PIXELS) {
+			continue;
+		}
+		if (rendered.empty()) {
+			bitmap = part;
+		} else {
+			CWorldPyramid::mergePixels(key.Z, key.X, key.Y, bitmap, part, it.second, rendered, _BackgroundColor);
+		}
+		rendered.push_back(it.second);
+	}
+
+	_Scale = scale;
+	_TileWidth = tileWidth;
+	_TileHeight = tileHeight;
+	_TileSizeLocked = false;
+
+	if (rendered.empty()) {
+		return;
+	}
+
+	CMemStream mem(false);
+	bitmap.writePNG(mem, 24);
+	png.assign((const char *)mem.buffer(), mem.length());
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::runWorld()
+{
+	const CWorldSheet *world = dynamic_cast<const CWorldSheet *>(SheetMngr.get(CSheetId("ryzom.world")));
+
+	// snap scale to nearest pyramid zoom so every continent lands on same tile grid
+	sint zoom = (sint)std::floor(std::log(_Scale * TILE_WORLD_SIZE / TILE_PIXELS) / std::log(2.f) + 0.5f);
+	zoom = std::max((sint)tileMinZoom, std::min((sint)tileMaxZoom, zoom));
+	float scale = _Scale;
+	_Scale = TILE_PIXELS * (float)(1 << zoom) / TILE_WORLD_SIZE;
+	float size = TILE_WORLD_SIZE / (1 << zoom);
+
+	std::string directory = _OutputDirectory + "/world/" + _Season;
+	CWorldPyramid pyramid(directory);
+	nlinfo("world pyramid zoom %d (scale %.4f) into '%s'", zoom, _Scale, directory.c_str());
+
+	std::set<TTileXY> tiles;
+	std::set<TTileXY> dirty;
+	uint reused = 0;
+	bool ok = true;
+
+	// edge tiles are shared with neighbour continents
+	std::vector<CWorldArea> areas(world->ContLocs.size());
+	for (uint i = 0; i < world->ContLocs.size(); ++i) {
+		const auto &cont = world->ContLocs[i];
+		areas[i].Min = CVector2f(std::min(cont.MinX, cont.MaxX), std::min(cont.MinY, cont.MaxY));
+		areas[i].Max = CVector2f(std::max(cont.MinX, cont.MaxX), std::max(cont.MinY, cont.MaxY));
+	}
+
+	_Progress.batchStart(world->ContLocs.size());
+	for (uint i = 0; i < world->ContLocs.size() && ok; ++i) {
+		const auto &cont = world->ContLocs[i];
+		_Progress.mapStart(cont.ContinentName, i);
+
+		// world y grows north, tile y grows south
+		float minX = areas[i].Min.x;
+		float maxX = areas[i].Max.x;
+		float minY = areas[i].Min.y;
+		float maxY = areas[i].Max.y;
+		if (minX < 0 || maxY > 0 || maxX <= minX || maxY <= minY) {
+			nlwarning("continent '%s' is outside world pyramid, skipping", cont.ContinentName.c_str());
+			_Progress.mapFailed("outside world pyramid");
+			continue;
+		}
+		uint x0 = (uint)(minX / size);
+		uint x1 = (uint)std::ceil(maxX / size) - 1;
+		uint y0 = (uint)(-maxY / size);
+		uint y1 = (uint)std::ceil(-minY / size) - 1;
+
+		for (uint y = y0; y <= y1; ++y) {
+			for (uint x = x0; x <= x1; ++x) {
+				tiles.insert(TTileXY(x, y));
+			}
+		}
+
+		// same settings as before means tiles on disk are still valid
+		_ContinentSheet = cont.ContinentName;
+		_ZoneMin = CVector2f(x0 * size, -((y1 + 1) * size));
+		_ZoneMax = CVector2f((x1 + 1) * size, -(y0 * size));
+		std::string settings = CRenderCheckpoint::hashSettings(getRenderSettings());
+		if (pyramid.isContinentDone(cont.ContinentName, settings, zoom, x0, y0, x1, y1)) {
+			nlinfo("'%s': %u tiles up to date", cont.ContinentName.c_str(), (x1 - x0 + 1) * (y1 - y0 + 1));
+			++reused;
+			_Progress.mapDone(directory);
+			continue;
+		}
+
+		setSeason(_Season);
+		_Stats.reset(cont.ContinentName);
+		_Stats.begin(StageContinent);
+		bool loaded = loadContinent(cont.ContinentName);
+		_Stats.end(StageContinent);
+		if (!loaded) {
+			nlwarning("continent '%s' not found", cont.ContinentName.c_str());
+			_Progress.mapFailed("continent not found");
+			continue;
+		}
+
+		std::vector<CWorldArea> others(areas);
+		others.erase(others.begin() + i);
+		ok = renderWorldContinent(pyramid, zoom, x0, y0, x1, y1, areas[i], others);
+		if (ok) {
+			pyramid.setContinentDone(cont.ContinentName, settings, zoom, x0, y0, x1, y1);
+			_Progress.mapDone(directory);
+		}
+		// tiles written so far are still newer than their parents
+		for (uint y = y0; y <= y1; ++y) {
+			for (uint x = x0; x <= x1; ++x) {
+				dirty.insert(TTileXY(x, y));
+			}
+		}
+
+		unloadContinent();
+	}
+	_Progress.batchDone();
+
+	pyramid.buildLevels(zoom, dirty, tiles, _BackgroundColor);
+	_Scale = scale;
+
+	std::cout << "world: " << tiles.size() << " tiles on zoom " << zoom << ", " << reused << " of "
+	          << world->ContLocs.size() << " continents reused, '" << directory << "'" << std::endl;
+	return ok;
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::renderWorldContinent(CWorldPyramid &pyramid, uint zoom, uint x0, uint y0, uint x1, uint y1, const CWorldArea &area, const std::vector<CWorldArea> &others)
+{
+	float size = TILE_WORLD_SIZE / (1 << zoom);
+	// strip is as high as screenshot tile allows, full continent wide
+	uint rows = std::max(1u, _TileHeight / TILE_PIXELS);
+
+	for (uint top = y0; top <= y1; top += rows) {
+		uint bottom = std::min(y1, top + rows - 1);
+		_ZoneMin = CVector2f(x0 * size, -((bottom + 1) * size));
+		_ZoneMax = CVector2f((x1 + 1) * size, -(top * size));
+		_ZoneCenter = CVector((_ZoneMin.x + _ZoneMax.x) / 2, (_ZoneMin.y + _ZoneMax.y) / 2, _ZoneCenter.z);
+
+		CBitmap strip;
+		bool complete = false;
+		autoRender(false, &strip, &complete);
+		if (!complete) {
+			return false;
+		}
+
+		CBitmap tile;
+		tile.resize(TILE_PIXELS, TILE_PIXELS, CBitmap::RGBA);
+		for (uint y = top; y <= bottom; ++y) {
+			for (uint x = x0; x <= x1; ++x) {
+				tile.blit(strip, (x - x0) * TILE_PIXELS, (y - top) * TILE_PIXELS, TILE_PIXELS, TILE_PIXELS, 0, 0);
+				pyramid.mergeTile(zoom, x, y, tile, area, others, _BackgroundColor);
+			}
+		}
+	}
+
+	return true;
+}
+
+//---------------------------------------------------------------------------
+std::string CMapRenderer::getTuningFilename(const std::string &continent) const
+{
+	return _OutputDirectory + "/autotune/" + continent + ".json";
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::getRenderTuning(CRenderTuning &tuning) const
+{
+	if (!readRenderTuning(getTuningFilename(_ContinentSheet), tuning)) {
+		return false;
+	}
+	// vision is in meters, tuned for single scale, lod bias, season and ssaa only
+	return std::fabs(tuning.Scale - _Scale) < 0.0001f && std::fabs(tuning.LodBias - _LodBias) < 0.005f
+	    && tuning.Season == _Season && tuning.Supersample == _Supersample
+	    && tuning.TileWidth <= maxTileWH && tuning.TileHeight <= maxTileWH;
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::runAutoTune()
+{
+	if (_Maps.empty()) {
+		std::string msg = "No maps to tune. Use '--render map1,map2,..' or set Maps={'map1,'map2'..} maps from cfg file.";
+		nlinfo("%s", msg.c_str());
+		std::cout << msg << std::endl;
+		return true;
+	}
+
+	// maps on same continent share result
+	std::set<std::string> tuned;
+	bool ok = true;
+	for (uint i = 0; i < _Maps.size() && ok; ++i) {
+		_Stats.reset(_Maps[i]);
+		if (!loadContinent(_Maps[i])) {
+			nlwarning("map '%s' not found", _Maps[i].c_str());
+			continue;
+		}
+		if (tuned.insert(_ContinentSheet).second) {
+			ok = autoTuneContinent();
+		}
+		unloadContinent();
+	}
+
+	return ok;
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::autoTuneContinent()
+{
+	CVector2f areaMin = _ZoneMin;
+	CVector2f areaMax = _ZoneMax;
+	uint tileWidth = _TileWidth;
+	uint tileHeight = _TileHeight;
+	uint tileNear = _LandscapeTileNear;
+	bool tileNearLocked = _TileNearLocked;
+	// auto lod bias is tuned against full quality references
+	float lodBias = _LodBias;
+	if (_LodBias < 0.f) {
+		_LodBias = 0.f;
+	}
+
+	// offscreen target can grow in headless mode, window size is fixed
+	std::vector<std::pair<uint, uint>> tileSizes;
+	tileSizes.push_back(std::make_pair(tileWidth, tileHeight));
+	if (_Headless && tileWidth * 2 <= maxTileWH && tileHeight * 2 <= maxTileWH) {
+		tileSizes.push_back(std::make_pair(tileWidth * 2, tileHeight * 2));
+	}
+
+	// 2x2 of largest tiles, so every candidate has inner tile borders
+	CTuneSample sample;
+	sample.Width = std::min(areaMax.x - areaMin.x, 2.f * tileSizes.back().first / _Scale);
+	sample.Height = std::min(areaMax.y - areaMin.y, 2.f * tileSizes.back().second / _Scale);
+	for (float f : { 0.5f, 0.25f, 0.75f }) {
+		CVector2f center(areaMin.x + (areaMax.x - areaMin.x) * f, areaMin.y + (areaMax.y - areaMin.y) * f);
+		center.x = std::max(areaMin.x + sample.Width / 2, std::min(areaMax.x - sample.Width / 2, center.x));
+		center.y = std::max(areaMin.y + sample.Height / 2, std::min(areaMax.y - sample.Height / 2, center.y));
+		sample.Centers.push_back(center);
+	}
+
+	// reference sees whole sample region from every tile with near textures everywhere
+	float diagonal = std::sqrt(sample.Width * sample.Width + sample.Height * sample.Height);
+	uint maxVision = ((uint)(diagonal / ZONE_TILE_WH) + 1) * ZONE_TILE_WH + ZONE_TILE_WH * 4;
+
+	bool cancelled = false;
+	double seconds = 0;
+	sample.References.resize(sample.Centers.size());
+	_ForcedVision = maxVision;
+	_TileNearLocked = true;
+	_LandscapeTileNear = maxVision / 2;
+	for (uint i = 0; i < sample.Centers.size() && !cancelled; ++i) {
+		cancelled = !renderTuneRegion(sample, i, sample.References[i], seconds);
+	}
+	nlinfo("tune '%s': reference vision %u, %u regions %.0fx%.0fm in %.2fs",
+	    _ContinentSheet.c_str(), maxVision, (uint)sample.Centers.size(), sample.Width, sample.Height, seconds);
+
+	CRenderTuning best;
+	double bestSeconds = 0;
+	for (const auto &size : tileSizes) {
+		if (cancelled) break;
+
+		_TileWidth = size.first;
+		_TileHeight = size.second;
+
+		// smallest vision with default tile near, then try to lower tile near
+		uint scaledMax = std::max(_TileWidth, _TileHeight) / _Scale;
+		uint vision = ((scaledMax / ZONE_TILE_WH) * ZONE_TILE_WH) / 2 + ZONE_TILE_WH;
+		bool found = false;
+		for (; vision <= maxVision && !found && !cancelled; vision += ZONE_TILE_WH) {
+			found = tuneCandidate(sample, vision, vision / 2, tuneMaxDiff, seconds, cancelled);
+		}
+		if (!found) {
+			continue;
+		}
+		vision -= ZONE_TILE_WH;
+
+		uint tunedNear = vision / 2;
+		for (uint div : { 8, 4 }) {
+			double s;
+			if (cancelled) break;
+			if (tuneCandidate(sample, vision, vision / div, tuneMaxDiff, s, cancelled)) {
+				tunedNear = vision / div;
+				seconds = s;
+				break;
+			}
+		}
+
+		// same regions for every candidate, so time compares directly
+		if (best.Vision == 0 || seconds < bestSeconds) {
+			best.TileWidth = _TileWidth;
+			best.TileHeight = _TileHeight;
+			best.Vision = vision;
+			best.TileNear = tunedNear;
+			bestSeconds = seconds;
+		}
+	}
+
+	// coarsest bias that still matches full quality with tuned vision and tile near
+	if (lodBias < 0.f && best.Vision > 0 && !cancelled) {
+		_TileWidth = best.TileWidth;
+		_TileHeight = best.TileHeight;
+		for (float bias : tuneLodBiases) {
+			if (cancelled) break;
+
+			// same preset as full quality at this scale, nothing to gain
+			_LodBias = bias;
+			CQualityPreset quality = getQualityPreset();
+			if (quality.Threshold == _RenderThreshold && quality.VegetableDensity == 1.f) {
+				continue;
+			}
+
+			double s;
+			if (tuneCandidate(sample, best.Vision, best.TileNear, tuneLodMaxDiff, s, cancelled)) {
+				best.AutoLodBias = bias;
+				nlinfo("tune '%s': lod bias %.2f (%.2fs for samples, %.2fs full quality)", _ContinentSheet.c_str(), bias, s, bestSeconds);
+				break;
+			}
+		}
+	}
+
+	_ZoneMin = areaMin;
+	_ZoneMax = areaMax;
+	_ZoneCenter = CVector((areaMin.x + areaMax.x) / 2, (areaMin.y + areaMax.y) / 2, _ZoneCenter.z);
+	_TileWidth = tileWidth;
+	_TileHeight = tileHeight;
+	_LandscapeTileNear = tileNear;
+	_TileNearLocked = tileNearLocked;
+	_LodBias = lodBias;
+	_ForcedVision = 0;
+
+	if (cancelled) {
+		return false;
+	}
+
+	std::string msg;
+	if (best.Vision == 0) {
+		msg = toString("'%s': no seam free settings up to vision %u, keeping defaults", _ContinentSheet.c_str(), maxVision);
+	} else {
+		best.Continent = _ContinentSheet;
+		best.Scale = _Scale;
+		best.LodBias = lodBias;
+		best.Season = _Season;
+		best.Supersample = _Supersample;
+		std::string filename = getTuningFilename(_ContinentSheet);
+		writeRenderTuning(filename, best);
+		msg = toString("'%s': tile %ux%u, vision %u, tilenear %u, auto lod bias %.2f (%.2fs for samples) into '%s'", _ContinentSheet.c_str(),
+		    best.TileWidth, best.TileHeight, best.Vision, best.TileNear, best.AutoLodBias, bestSeconds, filename.c_str());
+	}
+	nlinfo("tune %s", msg.c_str());
+	std::cout << msg << std::endl;
+
+	return true;
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::tuneCandidate(const CTuneSample &sample, uint vision, uint tileNear, float maxDiff, double &seconds, bool &cancelled)
+{
+	_ForcedVision = vision;
+	_LandscapeTileNear = tileNear;
+
+	seconds = 0;
+	for (uint i = 0; i < sample.Centers.size(); ++i) {
+		CBitmap bitmap;
+		if (!renderTuneRegion(sample, i, bitmap, seconds)) {
+			cancelled = true;
+			return false;
+		}
+
+		CSeamDiff diff = compareTileSeams(sample.References[i], bitmap, _TileWidth, _TileHeight, tuneSeamBand);
+		nlinfo("tune '%s': tile %ux%u vision %u tilenear %u lod bias %.2f region %u: %.3f%% pixels differ, %.3f%% on tile borders",
+		    _ContinentSheet.c_str(), _TileWidth, _TileHeight, vision, tileNear, _LodBias, i, diff.All * 100, diff.Border * 100);
+		if (diff.All > maxDiff || diff.Border > maxDiff) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::renderTuneRegion(const CTuneSample &sample, uint index, CBitmap &bitmap, double &seconds)
+{
+	const CVector2f &center = sample.Centers[index];
+	_ZoneMin = CVector2f(center.x - sample.Width / 2, center.y - sample.Height / 2);
+	_ZoneMax = CVector2f(center.x + sample.Width / 2, center.y + sample.Height / 2);
+	_ZoneCenter = CVector(center.x, center.y, _ZoneCenter.z);
+
+	TTicks start = CTime::getPerformanceTime();
+	bool complete = false;
+	autoRender(false, &bitmap, &complete);
+	seconds += CTime::ticksToSecond(CTime::getPerformanceTime() - start);
+
+	return complete;
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::runBenchmark()
+{
+	CBenchmarkReport report;
+	report.setInfo("date", toString(CTime::getSecondsSince1970()));
+	report.setInfo("renderer", driver->getVideocardInformation());
+	report.setInfo("window", toString("%dx%d", _TileWidth, _TileHeight));
+	report.setInfo("headless", _Headless ? "1" : "0");
+	report.setInfo("scale", toString("%.2f", _Scale));
+	report.setInfo("vision", toString(_LandscapeVision));
+	report.setInfo("tilenear", toString(_LandscapeTileNear));
+	report.setInfo("season", _Season);
+	report.setInfo("fxaa", useFXAA() ? "1" : "0");
+	report.setInfo("ssaa", toString(getSupersample()));
+	report.setInfo("inverse_z", _InverseZ ? "1" : "0");
+	report.setInfo("no_trees", _HideTrees ? "1" : "0");
+	report.setInfo("static_map", _StaticMap ? "1" : "0");
+
+	auto selected = [this](const std::string &name) {
+		return _BenchmarkFilter.empty() || std::find(_BenchmarkFilter.begin(), _BenchmarkFilter.end(), name) != _BenchmarkFilter.end();
+	};
+
+	for (const auto &path : getBenchmarkPaths()) {
+		if (selected(path.Name) && !benchmarkPath(path, report)) {
+			break;
+		}
+	}
+
+	// region with current settings, then warm dynamic/static pair for per tile savings
+	bool staticMap = _StaticMap;
+	for (const auto &region : getBenchmarkRegions()) {
+		if (!selected(region.Name)) continue;
+
+		bool ok = benchmarkRegion(region, report, "region");
+		if (ok) {
+			_StaticMap = false;
+			applySceneProfile();
+			ok = benchmarkRegion(region, report, "region_dynamic");
+		}
+		if (ok) {
+			_StaticMap = true;
+			applySceneProfile();
+			ok = benchmarkRegion(region, report, "region_static");
+		}
+		_StaticMap = staticMap;
+		applySceneProfile();
+
+		if (!ok) {
+			break;
+		}
+	}
+
+	if (!CFile::isExists(_OutputDirectory)) {
+		CFile::createDirectoryTree(_OutputDirectory);
+	}
+	report.writeJson(_OutputDirectory + "/benchmark.json");
+	report.writeCsv(_OutputDirectory + "/benchmark.csv");
+
+	std::cout << std::fixed << std::setprecision(2);
+	for (const auto &r : report.getResults()) {
+		std::cout << r.Kind << " " << r.Name << ": " << r.Frames << " frames in " << r.Elapsed << "s"
+		          << ", avg " << r.Avg * 1000.0 << "ms, p50 " << r.P50 * 1000.0 << "ms, p99 " << r.P99 * 1000.0 << "ms"
+		          << ", " << r.Throughput << "/s, zones " << r.ZonesLoaded << "\n";
+	}
+	for (const auto &r : report.getResults()) {
+		if (r.Kind != "region_static") continue;
+		for (const auto &d : report.getResults()) {
+			if (d.Kind == "region_dynamic" && d.Name == r.Name && d.P50 > 0) {
+				std::cout << "static map " << r.Name << ": tile p50 " << d.P50 * 1000.0 << "ms -> " << r.P50 * 1000.0 << "ms ("
+				          << std::showpos << (r.P50 - d.P50) / d.P50 * 100.0 << std::noshowpos << "%)"
+				          << ", avg " << d.Avg * 1000.0 << "ms -> " << r.Avg * 1000.0 << "ms\n";
+			}
+		}
+	}
+	std::cout << std::flush;
+
+	if (_BenchmarkBaseline.empty()) {
+		return true;
+	}
+
+	CBenchmarkReport baseline;
+	if (!baseline.loadCsv(_BenchmarkBaseline)) {
+		std::cout << "ERR: failed to load benchmark baseline '" << _BenchmarkBaseline << "'" << std::endl;
+		return false;
+	}
+
+	return report.compare(baseline, _BenchmarkTolerance);
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::benchmarkPath(const CBenchmarkPath &path, CBenchmarkReport &report)
+{
+	if (path.Waypoints.empty() || path.Step <= 0.f) return true;
+
+	_ViewCenter = path.Waypoints.front();
+	refreshContinent();
+	if (!_ActiveContinent) {
+		nlwarning("benchmark '%s': no continent at {%.f, %.f}", path.Name.c_str(), _ViewCenter.x, _ViewCenter.y);
+		return true;
+	}
+
+	scene->getCam().setFrustum(_TileWidth, _TileHeight, _ZNear, _ZFar, false);
+	scene->setViewport(CViewport());
+
+	// initial zone load and texture upload is not part of the path
+	double animTime = 0;
+	for (uint i = 0; i < 10; ++i) {
+		benchmarkFrame(animTime);
+	}
+
+	_Stats.reset(path.Name);
+
+	std::vector<double> samples;
+	TTicks startTick = CTime::getPerformanceTime();
+	for (uint i = 1; i < path.Waypoints.size(); ++i) {
+		const CVector &from = path.Waypoints[i - 1];
+		CVector dir = path.Waypoints[i] - from;
+		float len = dir.norm();
+		uint steps = (uint)(len / path.Step);
+		for (uint n = 0; n < steps; ++n) {
+			_ViewCenter = from + dir * ((float)n / steps);
+
+			TTicks frameTick = CTime::getPerformanceTime();
+			// fixed animation step for same veget/tree state on every run
+			animTime += 1.0 / 60.0;
+			if (!benchmarkFrame(animTime)) {
+				return false;
+			}
+			samples.push_back(CTime::ticksToSecond(CTime::getPerformanceTime() - frameTick));
+		}
+	}
+
+	CBenchmarkResult result;
+	result.Name = path.Name;
+	result.Kind = "path";
+	result.setSamples(samples, CTime::ticksToSecond(CTime::getPerformanceTime() - startTick));
+	result.ZonesLoaded = _Stats.getZonesLoaded();
+	result.ZonesUnloaded = _Stats.getZonesUnloaded();
+	report.addResult(result);
+
+	return true;
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::benchmarkRegion(const CBenchmarkRegion &region, CBenchmarkReport &report, const std::string &kind)
+{
+	_ViewCenter = CVector((region.Min.x + region.Max.x) / 2, (region.Min.y + region.Max.y) / 2, 0.f);
+	refreshContinent();
+	if (!_ActiveContinent) {
+		nlwarning("benchmark '%s': no continent at {%.f, %.f}", region.Name.c_str(), _ViewCenter.x, _ViewCenter.y);
+		return true;
+	}
+
+	// render region instead of full continent
+	CVector2f zoneMin = _ZoneMin;
+	CVector2f zoneMax = _ZoneMax;
+	CVector zoneCenter = _ZoneCenter;
+	_ZoneMin = region.Min;
+	_ZoneMax = region.Max;
+	_ZoneCenter = CVector(_ViewCenter.x, _ViewCenter.y, zoneCenter.z);
+
+	_Stats.reset(region.Name);
+	bool complete = false;
+	autoRender(false, nullptr, &complete);
+
+	_ZoneMin = zoneMin;
+	_ZoneMax = zoneMax;
+	_ZoneCenter = zoneCenter;
+
+	CBenchmarkResult result;
+	result.Name = region.Name;
+	result.Kind = kind;
+	result.setSamples(_Stats.getTileTimes(), _Stats.getElapsed());
+	result.ZonesLoaded = _Stats.getZonesLoaded();
+	result.ZonesUnloaded = _Stats.getZonesUnloaded();
+	report.addResult(result);
+
+	// ESC breaks tile loop
+	return complete;
+}
+
+//---------------------------------------------------------------------------
+bool CMapRenderer::benchmarkFrame(double animTime)
+{
+	if (!_Headless) {
+		driver->EventServer.pump();
+		if (!driver->isActive() || driver->AsyncListener.isKeyPushed(KeyESCAPE)) {
+			return false;
+		}
+	}
+
+	updateCamera();
+	scene->animate(animTime);
+	renderScene(_ViewCenter);
+	endTileTarget();
+	driver->swapBuffers();
+
+	return true;
+}
+
+//---------------------------------------------------------------------------
+void CMapRenderer::updateCamera()
+{
+#if 1
+	if (mouse) {
+		scene->getCam().setTransformMode(UTransformable::DirectMatrix);
+		scene->getCam().setMatrix(mouse->getViewMatrix());
+	} else {
+		CMatrix mtx = scene->getCam().getMatrix();
+		mtx.identity();
+		mtx.rotateX(-(float)Pi / 2);
+		mtx.setPos(_ViewCenter);
+		scene->getCam().setTransformMode(UTransformable::DirectMatrix);
+		scene->getCam().setMatrix(mtx);
+	}
+	//pCam.lookAt (plistener->getViewMatrix().getPos (), arrayObj[selected]->getPos());
+#else
+	UCamera cam = scene->getCam();
+	//cam.setTransformMode(UTransformable::RotQuat);
+
+	// TODO: target could be selected from loaded IGs? (with coords and name/shape on overlay)
+	CVector camPos = _ViewCenter;
+
+	// TODO: fixed target at pyr street
+	CVector targetPos = _ViewCenter;
+	targetPos.x = 18689;
+	targetPos.y = -24504;
+	targetPos.z = 0.f;
+
+	cam.lookAt(camPos, targetPos);
+#endif
+}
+//---------------------------------------------------------------------------
+void CMapRenderer::renderOverlayAuto(const CVector &viewCenter)
+{
+	// TODO: implement this
+	if (!text) return;
+
+	driver->setMatrixMode2D11();
+
+	uint windowHeight = driver->getWindowHeight();
+	uint fontSize = 18;
+
+	text->setColor(CRGBA(255, 255, 255, 255));
+	text->setFontSize(fontSize);
+
+	text->setHotSpot(UTextContext::TopLeft);
+	text->printfAt(0.01f, 0.99f, "%s", _ContinentSheet.c_str());
+	text->printfAt(0.01f, 0.96f, "zone {%.f, %.f} {%.f, %.f}", _ZoneMin.x, _ZoneMin.y, _ZoneMax.x, _ZoneMax.y);
+
+	text->setHotSpot(UTextContext::BottomLeft);
+	text->printfAt(0.01f, 0.01f, "ESC - break");
+
+	text->setHotSpot(UTextContext::BottomRight);
+	text->printfAt(0.99f, 0.01f, "{%.2f, %.2f}",
+	    (viewCenter.x - _ZoneMin.x) / (_ZoneMax.x - _ZoneMin.x),
+	    (_ZoneMax.y - viewCenter.y) / (_ZoneMax.y - _ZoneMin.y));
+}
+
+//---------------------------------------------------------------------------
+void CMapRenderer::renderOverlay()
+{
+	if (!text) return;
+
+	driver->setMatrixMode2D11();
+
+	uint fontSize = 10;
+	uint windowHeight = driver->getWindowHeight();
+	float oow = 1.f / windowHeight;
+	float lineH = fontSize * oow;
+
+	text->setColor(CRGBA(255, 255, 255, 255));
+	text->setFontSize(fontSize);
+	if (mouse) {
+		text->setHotSpot(UTextContext::TopRight);
+		text->printfAt(0.99f, 0.99f, "mouse {%s}", mouse->getViewMatrix().getPos().toString().c_str());
+		text->printfAt(0.99f, 0.99f - lineH, "model {%s}", mouse->getModelMatrix().getPos().toString().c_str());
+	}
+	// frame times without slowdown sleep
+	double frameAvg = _FrameHistory.getAvg();
+	uint fps = frameAvg > 0 ? (uint)(1.0 / frameAvg) : 0;
+	text->setHotSpot(UTextContext::BottomRight);
+	text->printfAt(0.99f, 0.01f, "%s%s%s%s%dfps (min %.2f, avg %.2f, p99 %.2fms)",
+	    _InverseZ ? "invZ " : "",
+	    _SlowDown ? "slowdown " : "",
+	    _UseLight ? "light " : "",
+	    _HideTrees ? "no-trees" : "",
+	    fps,
+	    _FrameHistory.getMin() * 1000.0,
+	    frameAvg * 1000.0,
+	    _FrameHistory.getPercentile(99) * 1000.0);
+
+	drawFrameHistory(0.69f, 0.01f + lineH * 1.5f, 0.99f, lineH);
+	text->setHotSpot(UTextContext::BottomLeft);
+
+	CMatrix mtx = scene->getCam().getMatrix();
+	CVector center = mtx.getPos();
+
+	text->printfAt(0.01f, 0.01f, "%s/%s:{%.1f, %.1f, %.1f} vision:%d tile:%d znear:%.f, zfar:%.f",
+	    _Season.c_str(), _ActiveContinent ? _MapName.c_str() : "(no continent)",
+	    center.x, center.y, center.z,
+	    _LandscapeVision, _LandscapeTileNear,
+		_ZNear, _ZFar);
+
+	//
+	fontSize = 10;
+	text->setFontSize(fontSize);
+	text->setColor(CRGBA(200, 200, 200, 255));
+	text->setHotSpot(UTextContext::TopLeft);
+	uint liney = windowHeight;
+	for (const auto &it : KeyBindings) {
+		if (it.id.empty()) continue;
+
+		if (it.id == "---") {
+			liney -= fontSize;
+			continue;
+		}
+
+		std::string keyName = CEventKey::getStringFromKey(it.Key);
+		if (startsWith(keyName, "Key")) {
+			keyName = keyName.substr(3);
+		}
+		std::string desc;
+		if (!it.Descr.empty()) {
+			desc = " (" + it.Descr + ")";
+		}
+
+		text->printfAt(0.01f, (float)liney / windowHeight, "(%s) %s%s", keyName.c_str(), it.id.c_str(), desc.c_str());
+		liney -= fontSize + 4;
+	}
+
+	// center cross
+	{
+		CLineColor line;
+		line.Color0 = CRGBA::White;
+		line.Color1 = CRGBA::White;
+
+		line = CLine(CVector(0.4, 0.5, 0), CVector(0.6, 0.5, 0));
+		driver->drawLine(line, pacsMaterial);
 
 		line = CLine(CVector(0.5, 0.4, 0), CVector(0.5, 0.6, 0));
 		driver->drawLine(line, pacsMaterial);
@@ -1764,6 +4618,77 @@ void CMapRenderer::renderOverlay()
 	//driver->setMatrixMode3D(camera);
 }
 
+//---------------------------------------------------------------------------
+void CMapRenderer::drawFrameHistory(float x0, float y0, float x1, float lineH)
+{
+	uint count = _FrameHistory.size();
+	if (count == 0) return;
+
+	static const CRGBA stageColors[FrameStageCount] = {
+		CRGBA(255, 160, 0, 255),
+		CRGBA(80, 220, 80, 255),
+		CRGBA(80, 160, 255, 255),
+		CRGBA(200, 200, 200, 255),
+	};
+	// time not in any stage (keyboard, animate, pacs/grid)
+	static const CRGBA otherColor(90, 90, 90, 255);
+
+	//------------------------------------------------------------------------
+	// stage averages, text and stacked bar
+	double frameAvg = _FrameHistory.getAvg();
+	float width = x1 - x0;
+	float y = y0;
+	for (uint i = 0; i < FrameStageCount; ++i) {
+		text->setColor(stageColors[i]);
+		text->setHotSpot(UTextContext::BottomLeft);
+		text->printfAt(x0 + width * i / FrameStageCount, y, "%s %.2f", getFrameStageName((TFrameStage)i), _FrameHistory.getStageAvg((TFrameStage)i) * 1000.0);
+	}
+	text->setColor(CRGBA::White);
+	y += lineH * 1.5f;
+
+	float barH = lineH;
+	float x = x0;
+	for (uint i = 0; i < FrameStageCount && frameAvg > 0; ++i) {
+		float w = width * (float)(_FrameHistory.getStageAvg((TFrameStage)i) / frameAvg);
+		driver->drawQuad(x, y, x + w, y + barH, stageColors[i]);
+		x += w;
+	}
+	if (x < x1) {
+		driver->drawQuad(x, y, x1, y + barH, otherColor);
+	}
+	y += barH + lineH * 0.5f;
+
+	//------------------------------------------------------------------------
+	// frame time histogram, 0 .. p99 with some headroom (at least 33ms)
+	const uint buckets = 32;
+	double range = std::max(_FrameHistory.getPercentile(99) * 1.25, 1.0 / 30.0);
+	uint hist[buckets] = { 0 };
+	uint maxCount = 1;
+	for (uint i = 0; i < count; ++i) {
+		uint b = std::min(buckets - 1, (uint)(_FrameHistory.getFrame(i) / range * buckets));
+		hist[b]++;
+		maxCount = std::max(maxCount, hist[b]);
+	}
+
+	float histH = lineH * 6;
+	driver->drawQuad(x0, y, x1, y + histH, CRGBA(0, 0, 0, 160));
+	float bucketW = width / buckets;
+	for (uint i = 0; i < buckets; ++i) {
+		if (hist[i] == 0) continue;
+		float h = histH * hist[i] / maxCount;
+		driver->drawQuad(x0 + i * bucketW, y, x0 + (i + 1) * bucketW - bucketW * 0.1f, y + h, CRGBA(80, 220, 80, 255));
+	}
+
+	// 60fps marker
+	float x60 = x0 + width * (float)(1.0 / 60.0 / range);
+	driver->drawLine(x60, y, x60, y + histH, CRGBA(255, 60, 60, 255));
+
+	text->setHotSpot(UTextContext::TopRight);
+	text->printfAt(x1, y + histH, "%.0fms", range * 1000.0);
+	text->setHotSpot(UTextContext::TopLeft);
+	text->printfAt(x0, y + histH, "0ms (%d frames)", count);
+}
+
 //---------------------------------------------------------------------------
 void CMapRenderer::frameStart()
 {
@@ -1777,12 +4702,16 @@ void CMapRenderer::frameStart()
 	//if (frameDelta > 0.0) {
 	//	fps = (sint64)(1.f/frameDelta);
 	//}
+	_FrameHistory.beginFrame();
 }
 
 //---------------------------------------------------------------------------
 void CMapRenderer::frameEnd()
 {
+	TTicks tick = CTime::getPerformanceTime();
 	driver->swapBuffers();
+	_FrameHistory.addStageTime(FrameSwap, CTime::ticksToSecond(CTime::getPerformanceTime() - tick));
+	_FrameHistory.endFrame();
 
 	if (_SlowDown) {
 		nlSleep(50);
@@ -1969,6 +4898,7 @@ void CMapRenderer::handleKeyboard()
 		_HideTrees = !_HideTrees;
 		updateIGDistance();
 	} else if (checkKey("render")) {
+		_Stats.reset(_MapName);
 		autoRender();
 		driver->AsyncListener.reset();
 	}
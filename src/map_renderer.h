@@ -11,10 +11,13 @@
 #ifndef MAP_RENDER_H
 #define MAP_RENDER_H
 
+#include <map>
 #include <utility>
 
+#include "nel/3d/computed_string.h"
 #include "nel/3d/landscapeig_manager.h"
 #include "nel/3d/u_material.h"
+#include "nel/misc/aabbox.h"
 #include "nel/misc/bitmap.h"
 #include "nel/misc/quat.h"
 #include "nel/misc/rgba.h"
@@ -24,7 +27,18 @@
 #include "game_share/season.h"
 #include "client_sheets/continent_sheet.h"
 
+#include "frame_history.h"
+#include "heatmap.h"
+#include "progress_stream.h"
+#include "render_job.h"
+#include "render_stats.h"
+#include "render_tuning.h"
+#include "tile_cache.h"
+#include "world_pyramid.h"
+#include "zone_id.h"
+
 namespace NL3D {
+class CInstanceGroup;
 class UScene;
 class ULandscape;
 class UInstanceGroup;
@@ -43,20 +57,52 @@ class UMoveContainer;
 } // namespace NLPACS
 
 struct CVillageSheet;
+class CPngBandWriter;
+class CRenderCheckpoint;
+struct CBenchmarkPath;
+struct CBenchmarkRegion;
+class CBenchmarkReport;
 
 struct CInstanceIG
 {
 	std::string Name;
 	std::string Parent;
 	NL3D::UInstanceGroup *IG;
+	// xy bounds of instances (village streaming)
+	NLMISC::CVector2f Min;
+	NLMISC::CVector2f Max;
+	bool HasBounds;
 	CInstanceIG()
 	    : IG(nullptr)
+	    , HasBounds(false)
 	{
 	}
 	CInstanceIG(std::string name, std::string parent)
 	    : Name(std::move(name))
 	    , Parent(std::move(parent))
 	    , IG(nullptr)
+	    , HasBounds(false)
+	{
+	}
+};
+
+// world z range of bounding box
+struct CDepthRange
+{
+	float Min;
+	float Max;
+	// landscape may have more than one surface at same x,y (overhangs, caves)
+	bool Layered;
+};
+
+// outpost buildings in single zone tile, one ig per 'bat_zc_*' marker
+struct COutpostIG
+{
+	std::string Name;
+	std::vector<NL3D::UInstanceGroup *> IGs;
+	COutpostIG() = default;
+	explicit COutpostIG(std::string name)
+	    : Name(std::move(name))
 	{
 	}
 };
@@ -80,6 +126,10 @@ public:
 	void setAutoRender(bool b) { _AutoRender = b; }
 	void setMaps(std::vector<std::string> maps) { _Maps = std::move(maps); }
 	void setInverseZ(bool b) { _InverseZ = b; }
+	// false to render inverse z passes on every tile instead of detecting them
+	void setInverseZAuto(bool b) { _InverseZAuto = b; }
+	// per tile znear/zfar from zone/ig bounds instead of fixed --znear/--zfar slab
+	void setTightDepth(bool b) { _TightDepth = b; }
 	void setFxaa(bool b) { _UseFXAA = b; }
 	void setHideTrees(bool b) { _HideTrees = b; }
 	void setPixelSize(float px) { _Scale = px; }
@@ -91,6 +141,14 @@ public:
 	}
 	void setPacs(const std::vector<uint> &ids);
 	void setPerf(uint frames) { _FrameLimit = frames; }
+	// replay benchmark paths/regions (all if filter is empty) and compare to baseline csv
+	void setBenchmark(std::vector<std::string> filter, std::string baseline, float tolerance)
+	{
+		_Benchmark = true;
+		_BenchmarkFilter = std::move(filter);
+		_BenchmarkBaseline = std::move(baseline);
+		_BenchmarkTolerance = tolerance;
+	}
 	void setViewCenter(float x, float y, float z) { _ViewCenter = NLMISC::CVector(x, y, z); }
 	void setSingleScreenshot(std::string filename) { _SingleScreenshot = std::move(filename); }
 	void setVision(uint vision) { _LandscapeVision = vision; }
@@ -101,6 +159,59 @@ public:
 	}
 	void setZNear(float z) { _ZNear = z; }
 	void setZFar(float z) { _ZFar = z; }
+	void setTrace(bool b) { _Stats.setTraceEnabled(b); }
+	// resident memory budget in MB, 0 to disable
+	void setMemoryBudget(uint mb) { _MemoryBudget = (uint64)mb << 20; }
+	void setBandStreaming(bool b) { _BandStreaming = b; }
+	// skip per frame simulation (wind, lighting updates, animate) for top-down captures
+	void setStaticMap(bool b) { _StaticMap = b; }
+	// render into offscreen target from hidden window, no event pump
+	void setHeadless(bool b) { _Headless = b; }
+	// screenshot tile (window or offscreen target) size in pixels
+	void setTileSize(uint width, uint height)
+	{
+		_TileWidth = width;
+		_TileHeight = height;
+	}
+	// keep finished tiles in <outdir>/<map>.checkpoint and continue interrupted render from there
+	void setResume(bool b) { _Resume = b; }
+	// report tiles, zones, memory, output size and time for auto render maps without rendering
+	void setPlan(bool b) { _Plan = b; }
+	// coarser landscape detail for low scale renders, 0 for full quality, negative for auto tuned
+	void setLodBias(float bias) { _LodBias = bias; }
+	// render coarse <map>.preview.png stages before full render (refined by its rows), or only those
+	void setPreview(bool only)
+	{
+		_Preview = true;
+		_PreviewOnly = only;
+	}
+	// render maps from auto render list in N worker processes
+	void setJobs(uint jobs) { _Jobs = jobs; }
+	// keep renderer warm and run json jobs from 'stdin' or 'unix:/path'
+	void setDaemon(std::string source) { _DaemonSource = std::move(source); }
+	// serve z/x/y tiles over http on '[host:]port', rendered on request
+	void setTileServer(std::string address) { _TileServerAddress = std::move(address); }
+	// find smallest seam free vision, tile near and tile size for continents of auto render maps
+	void setAutoTune(bool b) { _AutoTune = b; }
+	// render tiles at 2x or 4x size and downsample, replaces fxaa (headless only)
+	void setSupersample(uint factor) { _Supersample = factor; }
+	// render every continent into one sparse z/x/y pyramid in <outdir>/world/<season>
+	void setWorld(bool b) { _World = b; }
+	// disk cache directory for tile server, default is <outdir>/tiles
+	void setTileCacheDirectory(std::string dir) { _TileCacheDirectory = std::move(dir); }
+	// json lines progress to 'stdout', 'stderr', 'fd:N' or file
+	bool setProgress(const std::string &target) { return _Progress.open(target); }
+	// per tile complexity csv and heatmap png colored by metric
+	void setHeatmap(THeatmapMetric metric)
+	{
+		_Heatmap = true;
+		_HeatmapMetric = metric;
+	}
+	void setOverlayLayers(bool layers, bool layersOnly)
+	{
+		_OverlayLayers = layers || layersOnly;
+		_OverlayLayersOnly = layersOnly;
+	}
 
 	std::vector<std::string> getMapNames();
 	std::vector<std::string> getContinentNames();
@@ -119,6 +230,8 @@ private:
 
 	void moveTo(float x, float y);
 
+	// map or continent name to continent sheet, output name and padded area, nothing is loaded
+	bool getMapArea(std::string name, std::string &continent, std::string &mapName, NLMISC::CVector2f &minPos, NLMISC::CVector2f &maxPos) const;
 	bool loadContinent(std::string name);
 	void unloadContinent();
 
@@ -128,15 +241,129 @@ private:
 
 	void changeLandscapeSeason();
 	void refreshLandscapeTiles(const NLMISC::CVector &center, uint32 vision);
-	void renderScreenshot(NLMISC::CBitmap &btm);
+	// if bands is set, btm holds single tile row which is written to png after each row,
+	// tiles found in checkpoint are not rendered again, false if aborted with ESC
+	bool renderScreenshot(NLMISC::CBitmap &btm, CPngBandWriter *bands = nullptr, CRenderCheckpoint *checkpoint = nullptr);
 	void renderScene(const NLMISC::CVector &viewCenter);
-
-	// automatically render current continent into png
-	void autoRender();
+	// scene/landscape settings for interactive or static map render
+	void applySceneProfile();
+	// z range of loaded zone/ig bounds touching top-down tile
+	void getTileDepthBounds(const NLMISC::CVector &viewCenter, float width, float height, std::vector<CDepthRange> &bounds);
+	// geometry between camera and near plane needs inverse z passes
+	bool needInverseZ(const NLMISC::CVector &viewCenter, const NL3D::CFrustum &frustum, const std::vector<CDepthRange> &bounds);
+	// any two patches overlap in x,y, cached per zone for loaded continent
+	bool isZoneLayered(const NL3D::CZone *zone);
+	// znear/zfar around tile geometry, limited by _ZNear/_ZFar
+	// symmetric keeps camera plane at depth 0.5 for inverse z cutoff quad
+	void applyTightDepth(NL3D::UCamera &camera, const NLMISC::CVector &viewCenter, const std::vector<CDepthRange> &bounds, bool symmetric);
+	// hidden window matching offscreen target, buffer reads are clipped and y flipped against window size
+	void resizeHeadlessWindow(uint width, uint height);
+	// read rendered tile, in headless mode also releases offscreen target
+	void readTile(NLMISC::CBitmap &dest);
+	void endTileTarget();
+	// ssaa factor that fits offscreen target limit for current tile size, 1 without headless
+	uint getSupersample() const;
+	// fxaa is kept for tiles where ssaa falls back to 1x
+	bool useFXAA() const { return fxaa && getSupersample() == 1; }
+
+	// automatically render current continent into png, returns png filename
+	// if result is set and png is not saved, rendered canvas is copied there,
+	// complete is set false if render was cancelled with ESC
+	std::string autoRender(bool savePng = true, NLMISC::CBitmap *result = nullptr, bool *complete = nullptr);
+	std::string getAutoRenderFilename();
+
+	// landscape detail for current scale and lod bias
+	struct CQualityPreset
+	{
+		float Threshold;
+		// tile near 0, far bank textures only
+		bool FarBank;
+		float VegetableDensity;
+	};
+	CQualityPreset getQualityPreset() const;
+	// requested bias, or auto tuned one for current continent
+	float getLodBias() const;
+	// everything that changes rendered pixels, for checkpoint settings hash
+	std::string getRenderSettings() const;
+	// forced or full canvas would not fit memory budget
+	bool useBandStreaming(uint width, uint height);
+
+	// f(UInstanceGroup *) for zone, village and outpost igs in scene
+	template <class F>
+	void forEachSceneIG(F f);
+	CMemoryStats sampleMemory(const NLMISC::CBitmap &canvas);
+	// evict caches when resident memory is over budget
+	void enforceMemoryBudget(const CMemoryStats &mem);
+	void evictCaches();
+	// <map>.timing.json, <map>.timing.csv (per tile) and optional <map>.trace.json
+	void writeTimingReport();
+
+	// load, render and unload single map from _Maps, false if continent was not found
+	bool renderMap(uint index);
+	// coarse to fine stages into <map>.preview.png, returns filename or empty if cancelled
+	std::string renderPreview(const std::string &name);
+	// full render rows scaled into last preview stage, written every few seconds
+	void updatePreview(const NLMISC::CBitmap &rows, uint srcTop, uint top, uint height, uint fullHeight);
+	bool writePreview(NLMISC::CBitmap &bitmap);
+	// rendered canvas size in pixels, used to schedule largest maps first
+	uint64 estimateMapPixels(const std::string &name);
+	// dry run for _Maps, no gpu or zone loading
+	bool runPlan();
+	// fork worker processes, returns true in worker and false in parent
+	bool startWorkers();
+	// parent: hand out maps to workers until all are done, maps left when no worker
+	// is running go into remaining for serial render
+	bool runScheduler(std::vector<uint> &remaining);
+	// worker: render map indices from scheduler pipe until it is closed
+	bool runWorker();
+
+	// job loop, returns when stdin is closed or on 'quit' command
+	bool runDaemon();
+	// job settings are restored after render
+	bool runJob(const CRenderJob &job, std::string &output, std::string &error);
+
+	// http tile loop, runs until killed
+	bool runTileServer();
+	// render single pyramid tile into png from every continent under it, empty if tile is outside continents
+	void renderTile(const CTileKey &key, std::string &png);
+
+	// world pyramid, continents with unchanged settings are kept as they are
+	bool runWorld();
+	// render continent tile range in strips of tile rows, false on ESC
+	bool renderWorldContinent(CWorldPyramid &pyramid, uint zoom, uint x0, uint y0, uint x1, uint y1, const CWorldArea &area, const std::vector<CWorldArea> &others);
+
+	// <outdir>/autotune/<continent>.json
+	std::string getTuningFilename(const std::string &continent) const;
+	// tuning for current continent, false if there is none for current scale
+	bool getRenderTuning(CRenderTuning &tuning) const;
+
+	// sample regions with reference renders for auto tune
+	struct CTuneSample
+	{
+		float Width;
+		float Height;
+		std::vector<NLMISC::CVector2f> Centers;
+		std::vector<NLMISC::CBitmap> References;
+	};
+	// false if cancelled with ESC
+	bool runAutoTune();
+	bool autoTuneContinent();
+	// true if all sample regions are within maxDiff of reference, timing in seconds
+	bool tuneCandidate(const CTuneSample &sample, uint vision, uint tileNear, float maxDiff, double &seconds, bool &cancelled);
+	bool renderTuneRegion(const CTuneSample &sample, uint index, NLMISC::CBitmap &bitmap, double &seconds);
+
+	// returns false on regression against baseline
+	bool runBenchmark();
+	// returns false if user pressed ESC
+	bool benchmarkPath(const CBenchmarkPath &path, CBenchmarkReport &report);
+	bool benchmarkRegion(const CBenchmarkRegion &region, CBenchmarkReport &report, const std::string &kind);
+	bool benchmarkFrame(double animTime);
 
 	void updateCamera();
 
 	void renderOverlay();
+	// stage breakdown and frame time histogram, 2D11 coords from bottom left
+	void drawFrameHistory(float x0, float y0, float x1, float lineH);
 	void renderOverlayAuto(const NLMISC::CVector &viewCenter);
 
 	void frameStart();
@@ -145,10 +372,27 @@ private:
 	void drawPacs(const NLMISC::CVector &viewCenter);
 	void drawGrid(const NLMISC::CVector &viewCenter);
 
+	// rasterize pacs/grid overlays on cpu into separate transparent png files
+	// tileWidth/tileHeight must match renderScreenshot() tiles so layers align with terrain,
+	// returns written layer files
+	std::vector<std::string> renderOverlayLayers(uint tileWidth, uint tileHeight);
+	std::string saveOverlayLayer(NLMISC::CBitmap &btm, const std::string &suffix);
+
 	// add outpost ruins/buildings to scene, zoneIg is for reference positions
-	void addOutpostBuildings(CInstanceIG &ig, NL3D::UInstanceGroup *zoneIg);
-	// add village igs (towns) to scene
-	void addToScene(std::vector<CInstanceIG> &igs);
+	void addOutpostBuildings(COutpostIG &outpost, NL3D::UInstanceGroup *zoneIg);
+	void removeOutpostBuildings(COutpostIG &outpost);
+	// new ig deserialized from in-memory .ig file, file is read only once per loaded continent
+	NL3D::UInstanceGroup *createInstanceGroupFromTemplate(const std::string &filename);
+	const NL3D::CInstanceGroup *getInstanceGroupTemplate(const std::string &filename);
+	void releaseInstanceGroupTemplates();
+	// local shape box from .shape file, cached per shape name for whole run (shared between continents)
+	bool getShapeBounds(const std::string &shape, NLMISC::CAABBox &box);
+	// build village ig bounds and zone grid index
+	void indexVillageIGs();
+	// add/remove village igs (towns) to scene depending on distance from center
+	void updateVillageIGs(const NLMISC::CVector &center, float radius);
+	void addVillageToScene(CInstanceIG &ig);
+	void removeVillageFromScene(CInstanceIG &ig);
 	// debug ig clusters (ie. towns)
 	void debugClusters();
 
@@ -185,21 +429,37 @@ private:
 	std::vector<bool> _PacsFilter;
 	bool _AutoRender;
 	bool _InverseZ;
+	bool _InverseZAuto;
+	bool _TightDepth;
 	bool _UseFXAA;
 	bool _HideTrees;
 	float _Scale;
 	double _FrameDelta;
+	CFrameHistory _FrameHistory;
 	bool _SlowDown;
 	bool _UseLight;
 	bool _CamChanged;
 	// only render X frame(s) and then quit (for profiling)
 	uint _FrameLimit;
+	bool _Benchmark;
+	std::vector<std::string> _BenchmarkFilter;
+	std::string _BenchmarkBaseline;
+	// allowed p50 slowdown in percent
+	float _BenchmarkTolerance;
 
 	bool _RefineCenterAuto;
 	bool _TileNearLocked;
+	// tile size is not taken from auto tune (server tiles)
+	bool _TileSizeLocked;
 	uint _LandscapeTileNear;
 	uint _LandscapeVision;
 	float _LandscapeThreshold;
+	// auto render tessellation threshold at full quality, lower is finer
+	float _RenderThreshold;
+	// landscape detail drop at low scale, 0 full quality, negative uses auto tuned bias
+	float _LodBias;
+	// landscape only, zone and village igs are not streamed in
+	bool _SkipIGs;
 
 	float _ZNear;
 	float _ZFar;
@@ -210,11 +470,16 @@ private:
 	// initialized per continent
 	CContinentSheet *_ActiveContinent;
 	std::string _ContinentSheet;
+	// season of loaded zones, continent is kept if it does not change
+	std::string _LoadedSeason;
 	std::string _MapName;
 	NLMISC::CVector _ViewCenter;
 	bool _DrawPacs;
 	bool _DrawGrid;
 	bool _DrawGridNames;
+	// overlays as separate png layers instead of drawing them into terrain
+	bool _OverlayLayers;
+	bool _OverlayLayersOnly;
 	bool _DebugClusters;
 	bool _SheetsLoaded;
 
@@ -237,9 +502,93 @@ private:
 
 	// towns, bridges, water, etc
 	std::vector<CInstanceIG> _VillageIGs;
+	// zone tile -> _VillageIGs indices with bounds touching the tile
+	CZoneIdMap<std::vector<uint>> _VillageGrid;
+	uint _VillagesInScene;
+
+	// per stage timing for auto render
+	CRenderStats _Stats;
+
+	// bytes, 0 == no budget
+	uint64 _MemoryBudget;
+	// rss after last eviction
+	uint64 _EvictionRss;
+	// always write png in tile rows
+	bool _BandStreaming;
+
+	// no per frame simulation, scene animated once per map
+	bool _StaticMap;
+
+	// offscreen render target instead of visible window
+	bool _Headless;
+	uint _TileWidth;
+	uint _TileHeight;
+
+	bool _Heatmap;
+	THeatmapMetric _HeatmapMetric;
+
+	CProgressStream _Progress;
+
+	bool _Resume;
+	bool _Plan;
+	bool _Preview;
+	bool _PreviewOnly;
+	// last preview stage, refined by full render while file is set
+	NLMISC::CBitmap _PreviewBitmap;
+	std::string _PreviewFile;
+	NLMISC::TTicks _PreviewWritten;
+
+	// parallel auto render, worker pipes are -1 in parent and serial runs
+	uint _Jobs;
+	sint _WorkerIn;
+	sint _WorkerOut;
+	struct CWorkerProcess
+	{
+		sint Pid;
+		// map index, 'index ok|failed' lines back
+		sint CmdFd;
+		sint ResultFd;
+		// map index being rendered, -1 if idle
+		sint Map;
+		std::string Buffer;
+	};
+	std::vector<CWorkerProcess> _Workers;
+
+	// job source for daemon mode, empty if disabled
+	std::string _DaemonSource;
+
+	// tile server address, empty if disabled
+	std::string _TileServerAddress;
+	bool _World;
+	// render tiles at N times size and box filter them down, headless only
+	uint _Supersample;
+	// supersampled readback, kept between tiles
+	NLMISC::CBitmap _SupersampleBuffer;
+	bool _AutoTune;
+	// auto render vision in meters, 0 picks tuned or from tile size
+	uint _ForcedVision;
+	std::string _TileCacheDirectory;
+	uint64 _TileCacheMemory;
+	uint64 _TileCacheDisk;
 
 	// zone tiles with outpost ruins
-	std::unordered_map<std::string, CInstanceIG> _OutpostIGs;
+	CZoneIdMap<COutpostIG> _OutpostIGs;
+
+	// .ig file bytes for instancing and parsed copy for queries, IG is nullptr if file was not found
+	struct CIGTemplate
+	{
+		NL3D::CInstanceGroup *IG;
+		std::vector<uint8> Data;
+	};
+	std::map<std::string, CIGTemplate> _IGTemplates;
+	std::map<std::string, std::pair<bool, NLMISC::CAABBox>> _ShapeBounds;
+	std::map<uint16, bool> _LayeredZones;
+	// outpost buildings, construction ig is used for outposts without ruins when set
+	std::string _OutpostRuinsIG;
+	std::string _OutpostConstructionIG;
+
+	// computed zone name labels for drawGrid
+	std::unordered_map<TZoneId, NL3D::CComputedString> _GridLabels;
 };
 
 #endif
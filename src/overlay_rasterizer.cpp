@@ -0,0 +1,368 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OVERLAY_SSE2 1
+#endif
+
+#include "overlay_rasterizer.h"
+
+using namespace NLMISC;
+
+// tile size in pixels, each worker rasterizes one tile at a time
+#define OVERLAY_TILE_WH 256
+
+// 5x7 glyphs, one byte per row, bit 4 is leftmost pixel
+struct CGlyph
+{
+	char Char;
+	uint8 Rows[7];
+};
+
+static const CGlyph glyphs[] = {
+	{ '0', { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E } },
+	{ '1', { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+	{ '2', { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F } },
+	{ '3', { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E } },
+	{ '4', { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 } },
+	{ '5', { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E } },
+	{ '6', { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E } },
+	{ '7', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 } },
+	{ '8', { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E } },
+	{ '9', { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C } },
+	{ 'A', { 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 } },
+	{ 'B', { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E } },
+	{ 'C', { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E } },
+	{ 'D', { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C } },
+	{ 'E', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F } },
+	{ 'F', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 } },
+	{ 'G', { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F } },
+	{ 'H', { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 } },
+	{ 'I', { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+	{ 'J', { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C } },
+	{ 'K', { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 } },
+	{ 'L', { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F } },
+	{ 'M', { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 } },
+	{ 'N', { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 } },
+	{ 'O', { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E } },
+	{ 'P', { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 } },
+	{ 'Q', { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D } },
+	{ 'R', { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 } },
+	{ 'S', { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E } },
+	{ 'T', { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 } },
+	{ 'U', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E } },
+	{ 'V', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 } },
+	{ 'W', { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A } },
+	{ 'X', { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 } },
+	{ 'Y', { 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 } },
+	{ 'Z', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F } },
+	{ '_', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F } },
+	{ '-', { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 } },
+};
+
+static const uint8 *findGlyph(char c)
+{
+	if (c >= 'a' && c <= 'z') {
+		c = c - 'a' + 'A';
+	}
+	for (const auto &g : glyphs) {
+		if (g.Char == c) {
+			return g.Rows;
+		}
+	}
+	return nullptr;
+}
+
+// blend straight alpha color with coverage into premultiplied float pixel
+static inline void blendPixel(float *dst, NLMISC::CRGBA color, float coverage)
+{
+	float a = coverage * color.A * (1.f / 255.f);
+	float ia = 1.f - a;
+	dst[0] = color.R * a + dst[0] * ia;
+	dst[1] = color.G * a + dst[1] * ia;
+	dst[2] = color.B * a + dst[2] * ia;
+	dst[3] = 255.f * a + dst[3] * ia;
+}
+
+//----------------------------------------------------------------------------
+COverlayRasterizer::COverlayRasterizer(uint width, uint height, const CVector2f &origin, float scaleX, float scaleY)
+    : _Width(width)
+    , _Height(height)
+    , _Origin(origin)
+    , _ScaleX(scaleX)
+    , _ScaleY(scaleY)
+{
+}
+
+//----------------------------------------------------------------------------
+void COverlayRasterizer::clear()
+{
+	_Lines.clear();
+	_Labels.clear();
+}
+
+//----------------------------------------------------------------------------
+void COverlayRasterizer::addLine(const CVector &p0, const CVector &p1, CRGBA color, float width)
+{
+	CLinePrim line;
+	line.X0 = (p0.x - _Origin.x) * _ScaleX;
+	line.Y0 = (_Origin.y - p0.y) * _ScaleY;
+	line.X1 = (p1.x - _Origin.x) * _ScaleX;
+	line.Y1 = (_Origin.y - p1.y) * _ScaleY;
+	line.HalfWidth = width / 2.f;
+	line.Color = color;
+	_Lines.push_back(line);
+}
+
+//----------------------------------------------------------------------------
+void COverlayRasterizer::addLabel(const CVector &pos, const std::string &text, CRGBA color, uint scale)
+{
+	if (text.empty() || scale == 0) return;
+
+	uint textWidth = (text.size() * 6 - 1) * scale;
+	uint textHeight = 7 * scale;
+
+	CLabelPrim label;
+	label.X = (sint)((pos.x - _Origin.x) * _ScaleX) - (sint)textWidth / 2;
+	label.Y = (sint)((_Origin.y - pos.y) * _ScaleY) - (sint)textHeight / 2;
+	label.Scale = scale;
+	label.Text = text;
+	label.Color = color;
+	_Labels.push_back(label);
+}
+
+//----------------------------------------------------------------------------
+void COverlayRasterizer::rasterize(CBitmap &dest, uint threads) const
+{
+	dest.resize(_Width, _Height, CBitmap::RGBA);
+	if (_Width == 0 || _Height == 0) return;
+
+	uint tilesX = (_Width + OVERLAY_TILE_WH - 1) / OVERLAY_TILE_WH;
+	uint tilesY = (_Height + OVERLAY_TILE_WH - 1) / OVERLAY_TILE_WH;
+
+	// bin primitives into tiles they touch
+	std::vector<std::vector<uint>> tileLines(tilesX * tilesY);
+	std::vector<std::vector<uint>> tileLabels(tilesX * tilesY);
+
+	for (uint i = 0; i < _Lines.size(); ++i) {
+		const CLinePrim &line = _Lines[i];
+		float pad = line.HalfWidth + 1.f;
+		float minX = std::min(line.X0, line.X1) - pad;
+		float maxX = std::max(line.X0, line.X1) + pad;
+		float minY = std::min(line.Y0, line.Y1) - pad;
+		float maxY = std::max(line.Y0, line.Y1) + pad;
+		if (maxX < 0 || maxY < 0 || minX >= _Width || minY >= _Height) {
+			continue;
+		}
+
+		uint tx0 = (uint)std::max(0.f, minX) / OVERLAY_TILE_WH;
+		uint ty0 = (uint)std::max(0.f, minY) / OVERLAY_TILE_WH;
+		uint tx1 = std::min((uint)maxX / OVERLAY_TILE_WH, tilesX - 1);
+		uint ty1 = std::min((uint)maxY / OVERLAY_TILE_WH, tilesY - 1);
+		for (uint ty = ty0; ty <= ty1; ++ty) {
+			for (uint tx = tx0; tx <= tx1; ++tx) {
+				tileLines[ty * tilesX + tx].push_back(i);
+			}
+		}
+	}
+
+	for (uint i = 0; i < _Labels.size(); ++i) {
+		const CLabelPrim &label = _Labels[i];
+		// +scale for shadow
+		sint minX = label.X;
+		sint minY = label.Y;
+		sint maxX = label.X + (sint)((label.Text.size() * 6) * label.Scale);
+		sint maxY = label.Y + (sint)(8 * label.Scale);
+		if (maxX < 0 || maxY < 0 || minX >= (sint)_Width || minY >= (sint)_Height) {
+			continue;
+		}
+
+		uint tx0 = std::max(0, minX) / OVERLAY_TILE_WH;
+		uint ty0 = std::max(0, minY) / OVERLAY_TILE_WH;
+		uint tx1 = std::min((uint)maxX / OVERLAY_TILE_WH, tilesX - 1);
+		uint ty1 = std::min((uint)maxY / OVERLAY_TILE_WH, tilesY - 1);
+		for (uint ty = ty0; ty <= ty1; ++ty) {
+			for (uint tx = tx0; tx <= tx1; ++tx) {
+				tileLabels[ty * tilesX + tx].push_back(i);
+			}
+		}
+	}
+
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threads = std::min(threads, tilesX * tilesY);
+
+	uint8 *pixels = &dest.getPixels()[0];
+	std::atomic<uint> nextTile(0);
+
+	// tiles write into disjoint parts of dest, no locking needed
+	auto worker = [&]() {
+		std::vector<float> buffer(OVERLAY_TILE_WH * OVERLAY_TILE_WH * 4);
+		for (;;) {
+			uint tile = nextTile++;
+			if (tile >= tilesX * tilesY) {
+				break;
+			}
+			rasterizeTile(tile % tilesX, tile / tilesX, tileLines[tile], tileLabels[tile], buffer, pixels);
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (uint i = 1; i < threads; ++i) {
+		pool.emplace_back(worker);
+	}
+	worker();
+	for (auto &t : pool) {
+		t.join();
+	}
+}
+
+//----------------------------------------------------------------------------
+void COverlayRasterizer::rasterizeTile(uint tileX, uint tileY, const std::vector<uint> &lines, const std::vector<uint> &labels, std::vector<float> &buffer, uint8 *dest) const
+{
+	const sint left = tileX * OVERLAY_TILE_WH;
+	const sint top = tileY * OVERLAY_TILE_WH;
+	const sint tileW = std::min((sint)OVERLAY_TILE_WH, (sint)_Width - left);
+	const sint tileH = std::min((sint)OVERLAY_TILE_WH, (sint)_Height - top);
+
+	std::fill(buffer.begin(), buffer.end(), 0.f);
+
+	//------------------------------------------------------------------------
+	// lines, coverage from pixel center distance to segment
+	for (uint idx : lines) {
+		const CLinePrim &line = _Lines[idx];
+
+		float pad = line.HalfWidth + 1.f;
+		sint x0 = std::max(0, (sint)std::floor(std::min(line.X0, line.X1) - pad) - left);
+		sint x1 = std::min(tileW - 1, (sint)std::ceil(std::max(line.X0, line.X1) + pad) - left);
+		sint y0 = std::max(0, (sint)std::floor(std::min(line.Y0, line.Y1) - pad) - top);
+		sint y1 = std::min(tileH - 1, (sint)std::ceil(std::max(line.Y0, line.Y1) + pad) - top);
+		if (x0 > x1 || y0 > y1) {
+			continue;
+		}
+
+		float dx = line.X1 - line.X0;
+		float dy = line.Y1 - line.Y0;
+		float len2 = dx * dx + dy * dy;
+		float invLen2 = len2 > 0.f ? 1.f / len2 : 0.f;
+		float edge = line.HalfWidth + 0.5f;
+
+		for (sint y = y0; y <= y1; ++y) {
+			float vy = (float)(top + y) + 0.5f - line.Y0;
+			float *row = &buffer[(y * OVERLAY_TILE_WH) * 4];
+			sint x = x0;
+#ifdef OVERLAY_SSE2
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one = _mm_set1_ps(1.f);
+			const __m128 vDx = _mm_set1_ps(dx);
+			const __m128 vDy = _mm_set1_ps(dy);
+			const __m128 vInvLen2 = _mm_set1_ps(invLen2);
+			const __m128 vEdge = _mm_set1_ps(edge);
+			const __m128 vVy = _mm_set1_ps(vy);
+			const __m128 vVyDy = _mm_mul_ps(vVy, vDy);
+			const __m128 lane = _mm_set_ps(3.f, 2.f, 1.f, 0.f);
+			for (; x + 3 <= x1; x += 4) {
+				__m128 vx = _mm_add_ps(_mm_set1_ps((float)(left + x) + 0.5f - line.X0), lane);
+				// t = clamp(dot(v, d) / |d|^2, 0, 1)
+				__m128 t = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(vx, vDx), vVyDy), vInvLen2);
+				t = _mm_min_ps(_mm_max_ps(t, zero), one);
+				__m128 ex = _mm_sub_ps(vx, _mm_mul_ps(t, vDx));
+				__m128 ey = _mm_sub_ps(vVy, _mm_mul_ps(t, vDy));
+				__m128 dist = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)));
+				__m128 cov = _mm_min_ps(_mm_max_ps(_mm_sub_ps(vEdge, dist), zero), one);
+
+				if (_mm_movemask_ps(_mm_cmpgt_ps(cov, zero)) == 0) {
+					continue;
+				}
+
+				float c[4];
+				_mm_storeu_ps(c, cov);
+				for (uint i = 0; i < 4; ++i) {
+					if (c[i] > 0.f) {
+						blendPixel(&row[(x + i) * 4], line.Color, c[i]);
+					}
+				}
+			}
+#endif
+			for (; x <= x1; ++x) {
+				float vx = (float)(left + x) + 0.5f - line.X0;
+				float t = (vx * dx + vy * dy) * invLen2;
+				t = std::min(std::max(t, 0.f), 1.f);
+				float ex = vx - t * dx;
+				float ey = vy - t * dy;
+				float cov = edge - std::sqrt(ex * ex + ey * ey);
+				if (cov > 0.f) {
+					blendPixel(&row[x * 4], line.Color, std::min(cov, 1.f));
+				}
+			}
+		}
+	}
+
+	//------------------------------------------------------------------------
+	// labels, shaded like UTextContext
+	for (uint idx : labels) {
+		const CLabelPrim &label = _Labels[idx];
+		const uint s = label.Scale;
+		const sint shadow = std::max(1u, s / 2);
+
+		for (uint pass = 0; pass < 2; ++pass) {
+			CRGBA color = pass == 0 ? CRGBA(0, 0, 0, label.Color.A) : label.Color;
+			sint offset = pass == 0 ? shadow : 0;
+
+			for (uint i = 0; i < label.Text.size(); ++i) {
+				const uint8 *rows = findGlyph(label.Text[i]);
+				if (!rows) continue;
+
+				sint gx = label.X + offset + (sint)(i * 6 * s) - left;
+				sint gy = label.Y + offset - top;
+				for (uint r = 0; r < 7; ++r) {
+					for (uint c = 0; c < 5; ++c) {
+						if (!(rows[r] & (0x10 >> c))) continue;
+
+						sint bx0 = std::max(0, gx + (sint)(c * s));
+						sint bx1 = std::min(tileW, gx + (sint)((c + 1) * s));
+						sint by0 = std::max(0, gy + (sint)(r * s));
+						sint by1 = std::min(tileH, gy + (sint)((r + 1) * s));
+						for (sint y = by0; y < by1; ++y) {
+							for (sint x = bx0; x < bx1; ++x) {
+								blendPixel(&buffer[(y * OVERLAY_TILE_WH + x) * 4], color, 1.f);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	//------------------------------------------------------------------------
+	// premultiplied float -> straight alpha RGBA8
+	for (sint y = 0; y < tileH; ++y) {
+		const float *src = &buffer[(y * OVERLAY_TILE_WH) * 4];
+		uint8 *dst = dest + ((top + y) * _Width + left) * 4;
+		for (sint x = 0; x < tileW; ++x, src += 4, dst += 4) {
+			float a = src[3];
+			if (a <= 0.f) {
+				dst[0] = dst[1] = dst[2] = dst[3] = 0;
+				continue;
+			}
+			float ooa = 255.f / a;
+			dst[0] = (uint8)std::min(255.f, src[0] * ooa + 0.5f);
+			dst[1] = (uint8)std::min(255.f, src[1] * ooa + 0.5f);
+			dst[2] = (uint8)std::min(255.f, src[2] * ooa + 0.5f);
+			dst[3] = (uint8)std::min(255.f, a + 0.5f);
+		}
+	}
+}
@@ -0,0 +1,80 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef OVERLAY_RASTERIZER_H
+#define OVERLAY_RASTERIZER_H
+
+#include <string>
+#include <vector>
+
+#include "nel/misc/bitmap.h"
+#include "nel/misc/rgba.h"
+#include "nel/misc/vector.h"
+#include "nel/misc/vector_2f.h"
+
+// CPU rasterizer for map overlays (pacs, zone grid, zone names)
+//
+// Primitives are given in world coordinates and rasterized into transparent
+// RGBA image that has same pixel layout as the terrain render.
+class COverlayRasterizer
+{
+public:
+	// origin is top-left corner of the image in world coords
+	// scaleX/scaleY is pixel per meter
+	COverlayRasterizer(uint width, uint height, const NLMISC::CVector2f &origin, float scaleX, float scaleY);
+
+	// remove all primitives
+	void clear();
+
+	// anti-aliased line, width in pixels
+	void addLine(const NLMISC::CVector &p0, const NLMISC::CVector &p1, NLMISC::CRGBA color, float width = 1.f);
+
+	// text centered on world pos, glyph size is 5x7 * scale pixels
+	// supports 0-9, A-Z, '_', '-'
+	void addLabel(const NLMISC::CVector &pos, const std::string &text, NLMISC::CRGBA color, uint scale);
+
+	// rasterize into dest (resized to image size), using 'threads' workers (0 == auto)
+	void rasterize(NLMISC::CBitmap &dest, uint threads = 0) const;
+
+	uint getWidth() const { return _Width; }
+	uint getHeight() const { return _Height; }
+
+private:
+	struct CLinePrim
+	{
+		// pixel coords
+		float X0, Y0, X1, Y1;
+		float HalfWidth;
+		NLMISC::CRGBA Color;
+	};
+
+	struct CLabelPrim
+	{
+		// pixel coords for top-left corner
+		sint X, Y;
+		uint Scale;
+		std::string Text;
+		NLMISC::CRGBA Color;
+	};
+
+	// rasterize single tile into tile buffer and copy it into dest pixels
+	void rasterizeTile(uint tileX, uint tileY, const std::vector<uint> &lines, const std::vector<uint> &labels, std::vector<float> &buffer, uint8 *dest) const;
+
+	uint _Width;
+	uint _Height;
+	NLMISC::CVector2f _Origin;
+	float _ScaleX;
+	float _ScaleY;
+
+	std::vector<CLinePrim> _Lines;
+	std::vector<CLabelPrim> _Labels;
+};
+
+#endif
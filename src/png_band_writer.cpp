@@ -0,0 +1,169 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <csetjmp>
+#include <vector>
+
+#include <png.h>
+
+#include "nel/misc/debug.h"
+
+#include "png_band_writer.h"
+
+using namespace NLMISC;
+
+static void pngError(png_structp png, png_const_charp msg)
+{
+	nlwarning("png: %s", msg);
+	longjmp(png_jmpbuf(png), 1);
+}
+
+static void pngWarning(png_structp png, png_const_charp msg)
+{
+	nlwarning("png: %s", msg);
+}
+
+//----------------------------------------------------------------------------
+CPngBandWriter::CPngBandWriter()
+    : _File(nullptr)
+    , _Png(nullptr)
+    , _Info(nullptr)
+    , _Width(0)
+    , _Height(0)
+    , _Row(0)
+{
+}
+
+//----------------------------------------------------------------------------
+CPngBandWriter::~CPngBandWriter()
+{
+	if (_Png) {
+		close();
+	}
+	release();
+}
+
+//----------------------------------------------------------------------------
+void CPngBandWriter::release()
+{
+	if (_Png) {
+		png_structp png = (png_structp)_Png;
+		png_infop info = (png_infop)_Info;
+		png_destroy_write_struct(&png, &info);
+		_Png = nullptr;
+		_Info = nullptr;
+	}
+	if (_File) {
+		fclose(_File);
+		_File = nullptr;
+	}
+}
+
+//----------------------------------------------------------------------------
+bool CPngBandWriter::open(const std::string &filename, uint width, uint height)
+{
+	release();
+
+	_Filename = filename;
+	_Width = width;
+	_Height = height;
+	_Row = 0;
+
+	if (width == 0 || height == 0) {
+		nlwarning("'%s': invalid png size %dx%d", filename.c_str(), width, height);
+		return false;
+	}
+
+	_File = fopen(filename.c_str(), "wb");
+	if (!_File) {
+		nlwarning("failed to open '%s' for writing", filename.c_str());
+		return false;
+	}
+
+	png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, pngError, pngWarning);
+	png_infop info = png ? png_create_info_struct(png) : nullptr;
+	_Png = png;
+	_Info = info;
+	if (!png || !info) {
+		release();
+		return false;
+	}
+
+	if (setjmp(png_jmpbuf(png))) {
+		release();
+		return false;
+	}
+
+	png_init_io(png, _File);
+	png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_RGB,
+	    PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	png_write_info(png, info);
+	// input is RGBA, drop alpha
+	png_set_filler(png, 0, PNG_FILLER_AFTER);
+
+	return true;
+}
+
+//----------------------------------------------------------------------------
+bool CPngBandWriter::writeRows(const CBitmap &band, uint rows)
+{
+	if (!_Png) return false;
+
+	if (band.getWidth() != _Width || rows > band.getHeight() || band.getPixelFormat() != CBitmap::RGBA) {
+		nlwarning("'%s': band %dx%d does not match png width %d", _Filename.c_str(), band.getWidth(), band.getHeight(), _Width);
+		return false;
+	}
+	if (_Row + rows > _Height) {
+		rows = _Height - _Row;
+	}
+
+	png_structp png = (png_structp)_Png;
+	if (setjmp(png_jmpbuf(png))) {
+		release();
+		return false;
+	}
+
+	const uint8 *pixels = &band.getPixels()[0];
+	for (uint y = 0; y < rows; ++y) {
+		png_write_row(png, (png_const_bytep)(pixels + y * _Width * 4));
+	}
+	_Row += rows;
+
+	return true;
+}
+
+//----------------------------------------------------------------------------
+bool CPngBandWriter::close()
+{
+	if (!_Png) return false;
+
+	png_structp png = (png_structp)_Png;
+	png_infop info = (png_infop)_Info;
+
+	bool complete = _Row == _Height;
+	if (!complete) {
+		nlwarning("'%s': only %d of %d rows rendered, rest is left black", _Filename.c_str(), _Row, _Height);
+	}
+
+	std::vector<uint8> empty(_Width * 4, 0);
+	if (setjmp(png_jmpbuf(png))) {
+		release();
+		return false;
+	}
+
+	// keep file valid if render was interrupted
+	for (; _Row < _Height; ++_Row) {
+		png_write_row(png, &empty[0]);
+	}
+	png_write_end(png, info);
+	release();
+
+	return complete;
+}
@@ -0,0 +1,48 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef PNG_BAND_WRITER_H
+#define PNG_BAND_WRITER_H
+
+#include <cstdio>
+#include <string>
+
+#include "nel/misc/types_nl.h"
+#include "nel/misc/bitmap.h"
+
+// writes 24bit png row by row, so full map never needs to be in memory
+class CPngBandWriter
+{
+public:
+	CPngBandWriter();
+	~CPngBandWriter();
+
+	bool open(const std::string &filename, uint width, uint height);
+	// write first 'rows' rows from RGBA band, band width must match image width
+	bool writeRows(const NLMISC::CBitmap &band, uint rows);
+	// finish png, fails if not all rows were written
+	bool close();
+
+	uint getRowsWritten() const { return _Row; }
+
+private:
+	void release();
+
+	FILE *_File;
+	// png_structp, png_infop
+	void *_Png;
+	void *_Info;
+	std::string _Filename;
+	uint _Width;
+	uint _Height;
+	uint _Row;
+};
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <algorithm>
+
+#include "nel/misc/common.h"
+#include "nel/misc/debug.h"
+
+#include "progress_stream.h"
+#include "render_stats.h"
+
+using namespace NLMISC;
+
+//----------------------------------------------------------------------------
+CProgressStream::CProgressStream()
+    : _File(nullptr)
+    , _OwnFile(false)
+    , _Maps(0)
+    , _MapsDone(0)
+    , _Tiles(0)
+    , _Rendered(0)
+    , _BatchStart(0)
+    , _MapStart(0)
+    , _PassStart(0)
+{
+}
+
+//----------------------------------------------------------------------------
+CProgressStream::~CProgressStream()
+{
+	close();
+}
+
+//----------------------------------------------------------------------------
+bool CProgressStream::open(const std::string &target)
+{
+	close();
+
+	if (target.empty() || target == "stderr") {
+		_File = stderr;
+	} else if (target == "stdout" || target == "-") {
+		_File = stdout;
+	} else if (target.compare(0, 3, "fd:") == 0) {
+		sint fd;
+		if (!fromString(target.substr(3), fd) || fd < 0) {
+			nlwarning("invalid progress file descriptor '%s'", target.c_str());
+			return false;
+		}
+#ifdef NL_OS_UNIX
+		_File = fdopen(fd, "w");
+#else
+		_File = _fdopen(fd, "w");
+#endif
+		_OwnFile = true;
+	} else {
+		_File = fopen(target.c_str(), "w");
+		_OwnFile = true;
+	}
+
+	if (!_File) {
+		nlwarning("failed to open progress stream '%s'", target.c_str());
+		_OwnFile = false;
+		return false;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------
+void CProgressStream::close()
+{
+	if (_File && _OwnFile) {
+		fclose(_File);
+	}
+	_File = nullptr;
+	_OwnFile = false;
+}
+
+//----------------------------------------------------------------------------
+void CProgressStream::writeLine(const std::string &line)
+{
+	if (!_File) return;
+
+	fputs(line.c_str(), _File);
+	fputc('\n', _File);
+	// reader is usually waiting on the other end of a pipe
+	fflush(_File);
+}
+
+//----------------------------------------------------------------------------
+void CProgressStream::batchStart(uint maps)
+{
+	_Maps = maps;
+	_MapsDone = 0;
+	_BatchStart = CTime::getPerformanceTime();
+
+	writeLine(toString("{\"event\":\"batch_start\",\"maps\":%u}", maps));
+}
+
+//----------------------------------------------------------------------------
+void CProgressStream::mapStart(const std::string &map, uint mapIndex)
+{
+	_Map = map;
+	_Tiles = 0;
+	_MapStart = CTime::getPerformanceTime();
+	passStart();
+
+	writeLine(toString("{\"event\":\"map_start\",\"map\":\"%s\",\"map_index\":%u,\"maps\":%u}",
+	    CRenderStats::jsonEscape(map).c_str(), mapIndex, _Maps));
+}
+
+//----------------------------------------------------------------------------
+void CProgressStream::passStart()
+{
+	_Rendered = 0;
+	_PassStart = CTime::getPerformanceTime();
+}
+
+//----------------------------------------------------------------------------
+void CProgressStream::tile(uint tile, uint tiles, bool rendered)
+{
+	if (!_File) return;
+
+	_Tiles = tiles;
+	if (rendered) {
+		++_Rendered;
+	}
+	uint done = tile + 1;
+	TTicks now = CTime::getPerformanceTime();
+	double elapsed = CTime::ticksToSecond(now - _MapStart);
+	double passElapsed = CTime::ticksToSecond(now - _PassStart);
+	double rate = passElapsed > 0 ? _Rendered / passElapsed : 0.0;
+	double eta = rate > 0 ? (tiles - std::min(done, tiles)) / rate : 0.0;
+
+	writeLine(toString("{\"event\":\"tile\",\"map\":\"%s\",\"tile\":%u,\"tiles\":%u,\"elapsed\":%.3f,\"eta\":%.3f,\"tiles_per_second\":%.3f}",
+	    CRenderStats::jsonEscape(_Map).c_str(), tile, tiles, elapsed, eta, rate));
+}
+
+//----------------------------------------------------------------------------
+void CProgressStream::mapDone(const std::string &output)
+{
+	_MapsDone++;
+	double elapsed = CTime::ticksToSecond(CTime::getPerformanceTime() - _MapStart);
+
+	writeLine(toString("{\"event\":\"map_done\",\"map\":\"%s\",\"tiles\":%u,\"elapsed\":%.3f,\"output\":\"%s\"}",
+	    CRenderStats::jsonEscape(_Map).c_str(), _Tiles, elapsed, CRenderStats::jsonEscape(output).c_str()));
+}
+
+//----------------------------------------------------------------------------
+void CProgressStream::mapFailed(const std::string &reason)
+{
+	_MapsDone++;
+
+	writeLine(toString("{\"event\":\"map_failed\",\"map\":\"%s\",\"reason\":\"%s\"}",
+	    CRenderStats::jsonEscape(_Map).c_str(), CRenderStats::jsonEscape(reason).c_str()));
+}
+
+//----------------------------------------------------------------------------
+void CProgressStream::batchDone()
+{
+	double elapsed = CTime::ticksToSecond(CTime::getPerformanceTime() - _BatchStart);
+
+	writeLine(toString("{\"event\":\"batch_done\",\"maps\":%u,\"elapsed\":%.3f}", _MapsDone, elapsed));
+}
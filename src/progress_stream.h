@@ -0,0 +1,68 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef PROGRESS_STREAM_H
+#define PROGRESS_STREAM_H
+
+#include <cstdio>
+#include <string>
+
+#include "nel/misc/types_nl.h"
+#include "nel/misc/time_nl.h"
+
+// json lines progress events for batch renders, one object per line
+//
+// {"event":"batch_start","maps":3}
+// {"event":"map_start","map":"fyros","map_index":0,"maps":3}
+// {"event":"tile","map":"fyros","tile":12,"tiles":80,"elapsed":4.1,"eta":23.2,"tiles_per_second":2.9}
+// {"event":"map_done","map":"fyros","tiles":80,"elapsed":27.3,"output":"out/fyros.png"}
+// {"event":"batch_done","maps":3,"elapsed":91.0}
+class CProgressStream
+{
+public:
+	CProgressStream();
+	~CProgressStream();
+
+	// 'stderr' (default), 'stdout', 'fd:N' or filename
+	bool open(const std::string &target);
+	void close();
+	bool isOpen() const { return _File != nullptr; }
+
+	void batchStart(uint maps);
+	void mapStart(const std::string &map, uint mapIndex);
+	// restart rate and eta clock, each render pass (preview stage, full render) has own tiles
+	void passStart();
+	// tile is 0 based index of finished tile, rendered is false for tile resumed from checkpoint
+	void tile(uint tile, uint tiles, bool rendered);
+	void mapDone(const std::string &output);
+	// map failed to load or render was aborted
+	void mapFailed(const std::string &reason);
+	void batchDone();
+	// maps finished by worker processes, before batchDone()
+	void setMapsDone(uint maps) { _MapsDone = maps; }
+
+private:
+	void writeLine(const std::string &line);
+
+	FILE *_File;
+	bool _OwnFile;
+
+	uint _Maps;
+	uint _MapsDone;
+	std::string _Map;
+	uint _Tiles;
+	// tiles rendered in current pass, resumed tiles do not count for rate
+	uint _Rendered;
+	NLMISC::TTicks _BatchStart;
+	NLMISC::TTicks _MapStart;
+	NLMISC::TTicks _PassStart;
+};
+
+#endif
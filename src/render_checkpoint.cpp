@@ -0,0 +1,198 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include "nel/misc/common.h"
+#include "nel/misc/debug.h"
+#include "nel/misc/file.h"
+#include "nel/misc/path.h"
+
+#include "render_checkpoint.h"
+#include "render_job.h"
+#include "render_stats.h"
+
+using namespace NLMISC;
+
+//----------------------------------------------------------------------------
+CRenderCheckpoint::CRenderCheckpoint()
+    : _TilesX(0)
+    , _TilesY(0)
+    , _Resumed(0)
+{
+}
+
+//----------------------------------------------------------------------------
+std::string CRenderCheckpoint::hashSettings(const std::string &settings)
+{
+	// fnv-1a, only needs to tell settings apart
+	uint64 hash = 14695981039346656037ULL;
+	for (char c : settings) {
+		hash ^= (uint8)c;
+		hash *= 1099511628211ULL;
+	}
+	return toString("%016" NL_I64 "x", hash);
+}
+
+//----------------------------------------------------------------------------
+bool CRenderCheckpoint::open(const std::string &directory, const std::string &map, const std::string &settings, uint tilesX, uint tilesY)
+{
+	_Directory = CPath::standardizePath(directory);
+	_Map = map;
+	_Settings = hashSettings(settings);
+	_TilesX = tilesX;
+	_TilesY = tilesY;
+	_Done.clear();
+	_Resumed = 0;
+
+	if (!CFile::isDirectory(_Directory) && !CFile::createDirectoryTree(_Directory)) {
+		nlwarning("unable to create checkpoint directory '%s'", _Directory.c_str());
+		_Directory.clear();
+		return false;
+	}
+
+	if (CFile::fileExists(_Directory + "manifest.json") && !readManifest()) {
+		nlinfo("checkpoint '%s' is from different settings, starting over", _Directory.c_str());
+		remove();
+		return open(directory, map, settings, tilesX, tilesY);
+	}
+
+	if (!_Done.empty()) {
+		nlinfo("resuming '%s' from checkpoint, %u of %u tiles done", map.c_str(), (uint)_Done.size(), tilesX * tilesY);
+	}
+	writeManifest();
+	return true;
+}
+
+//----------------------------------------------------------------------------
+bool CRenderCheckpoint::readManifest()
+{
+	std::string text;
+	FILE *fp = fopen((_Directory + "manifest.json").c_str(), "rb");
+	if (!fp) return false;
+	char buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+		text.append(buf, n);
+	}
+	fclose(fp);
+
+	std::map<std::string, std::string> fields;
+	if (!parseFlatJson(text, fields)) return false;
+
+	uint tilesX = 0, tilesY = 0;
+	if (fields["map"] != _Map || fields["settings"] != _Settings
+	    || !fromString(fields["tiles_x"], tilesX) || !fromString(fields["tiles_y"], tilesY)
+	    || tilesX != _TilesX || tilesY != _TilesY) {
+		return false;
+	}
+
+	std::vector<std::string> done;
+	splitString(fields["done"], ",", done);
+	for (const auto &it : done) {
+		uint index;
+		// manifest may list tile whose png did not make it to disk
+		if (fromString(it, index) && index < _TilesX * _TilesY && CFile::fileExists(getTileFilename(index))) {
+			_Done.insert(index);
+		}
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------
+void CRenderCheckpoint::writeManifest()
+{
+	std::string done;
+	for (uint index : _Done) {
+		if (!done.empty()) done += ",";
+		done += toString(index);
+	}
+
+	std::string text = toString("{\"map\":\"%s\",\"settings\":\"%s\",\"tiles_x\":%u,\"tiles_y\":%u,\"done\":[%s]}\n",
+	    CRenderStats::jsonEscape(_Map).c_str(), _Settings.c_str(), _TilesX, _TilesY, done.c_str());
+
+	// replace in one step so crash never leaves half written manifest
+	std::string path = _Directory + "manifest.json";
+	std::string tmp = path + ".tmp";
+	FILE *fp = fopen(tmp.c_str(), "wb");
+	if (!fp) {
+		nlwarning("unable to write '%s'", tmp.c_str());
+		return;
+	}
+	bool ok = fwrite(text.data(), 1, text.size(), fp) == text.size();
+	ok = fclose(fp) == 0 && ok;
+	if (!ok || !CFile::moveFile(path, tmp)) {
+		nlwarning("unable to write '%s'", path.c_str());
+	}
+}
+
+//----------------------------------------------------------------------------
+std::string CRenderCheckpoint::getTileFilename(uint index) const
+{
+	return _Directory + toString("tile_%u.png", index);
+}
+
+//----------------------------------------------------------------------------
+bool CRenderCheckpoint::loadTile(uint index, CBitmap &dest)
+{
+	if (!isOpen() || _Done.find(index) == _Done.end()) {
+		return false;
+	}
+
+	CIFile file;
+	if (!file.open(getTileFilename(index))) {
+		return false;
+	}
+	try {
+		dest.load(file);
+	} catch (const EStream &e) {
+		nlwarning("failed to read checkpoint tile '%s' (%s)", getTileFilename(index).c_str(), e.what());
+		_Done.erase(index);
+		return false;
+	}
+	if (dest.getPixelFormat() != CBitmap::RGBA) {
+		dest.convertToType(CBitmap::RGBA);
+	}
+
+	++_Resumed;
+	return true;
+}
+
+//----------------------------------------------------------------------------
+void CRenderCheckpoint::saveTile(uint index, CBitmap &tile)
+{
+	if (!isOpen()) return;
+
+	{
+		COFile file(getTileFilename(index));
+		tile.writePNG(file, 24);
+	}
+
+	_Done.insert(index);
+	writeManifest();
+}
+
+//----------------------------------------------------------------------------
+void CRenderCheckpoint::remove()
+{
+	if (!isOpen()) return;
+
+	std::vector<std::string> files;
+	CPath::getPathContent(_Directory, false, false, true, files);
+	for (const auto &path : files) {
+		CFile::deleteFile(path);
+	}
+	CFile::deleteDirectory(_Directory);
+
+	_Directory.clear();
+	_Done.clear();
+}
@@ -0,0 +1,64 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef RENDER_CHECKPOINT_H
+#define RENDER_CHECKPOINT_H
+
+#include <set>
+#include <string>
+
+#include "nel/misc/bitmap.h"
+#include "nel/misc/types_nl.h"
+
+// finished screenshot tiles of single map render, so interrupted render can resume
+//
+// <dir>/manifest.json
+// {"map":"fyros","settings":"9f0c2d4e11a3b570","tiles_x":12,"tiles_y":9,"done":[0,1,2,14]}
+// <dir>/tile_<index>.png
+//
+// index is row * tiles_x + column, tiles from different settings are never reused
+class CRenderCheckpoint
+{
+public:
+	CRenderCheckpoint();
+
+	// existing checkpoint is reused if map, settings and tile grid match, otherwise cleared
+	bool open(const std::string &directory, const std::string &map, const std::string &settings, uint tilesX, uint tilesY);
+	bool isOpen() const { return !_Directory.empty(); }
+
+	// false if tile is not in checkpoint or could not be read
+	bool loadTile(uint index, NLMISC::CBitmap &dest);
+	// tile png first, then manifest
+	void saveTile(uint index, NLMISC::CBitmap &tile);
+
+	// tiles taken from earlier run
+	uint getResumed() const { return _Resumed; }
+
+	// render finished, checkpoint is not needed anymore
+	void remove();
+
+	// short hex hash of settings string
+	static std::string hashSettings(const std::string &settings);
+
+private:
+	std::string getTileFilename(uint index) const;
+	bool readManifest();
+	void writeManifest();
+
+	std::string _Directory;
+	std::string _Map;
+	std::string _Settings;
+	uint _TilesX;
+	uint _TilesY;
+	std::set<uint> _Done;
+	uint _Resumed;
+};
+
+#endif
@@ -0,0 +1,201 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <vector>
+
+#include "nel/misc/common.h"
+
+#include "render_job.h"
+
+using namespace NLMISC;
+
+static void skipSpace(const std::string &text, uint &pos)
+{
+	while (pos < text.size() && isspace((uint8)text[pos])) {
+		++pos;
+	}
+}
+
+// pos is at opening quote
+static bool parseString(const std::string &text, uint &pos, std::string &out)
+{
+	out.clear();
+	++pos;
+	while (pos < text.size()) {
+		char c = text[pos++];
+		if (c == '"') {
+			return true;
+		}
+		if (c != '\\') {
+			out += c;
+			continue;
+		}
+		if (pos >= text.size()) {
+			return false;
+		}
+		c = text[pos++];
+		switch (c) {
+		case 'n':
+			out += '\n';
+			break;
+		case 'r':
+			out += '\r';
+			break;
+		case 't':
+			out += '\t';
+			break;
+		case 'u':
+			// only ascii is expected in job files
+			if (pos + 4 > text.size()) return false;
+			out += (char)strtol(text.substr(pos, 4).c_str(), nullptr, 16);
+			pos += 4;
+			break;
+		default:
+			out += c;
+		}
+	}
+	return false;
+}
+
+// number, true, false, null
+static bool parseLiteral(const std::string &text, uint &pos, std::string &out)
+{
+	uint start = pos;
+	while (pos < text.size() && (isalnum((uint8)text[pos]) || text[pos] == '-' || text[pos] == '+' || text[pos] == '.')) {
+		++pos;
+	}
+	out = text.substr(start, pos - start);
+	return !out.empty();
+}
+
+//----------------------------------------------------------------------------
+bool parseFlatJson(const std::string &text, std::map<std::string, std::string> &fields)
+{
+	fields.clear();
+
+	uint pos = 0;
+	skipSpace(text, pos);
+	if (pos >= text.size() || text[pos] != '{') return false;
+	++pos;
+
+	skipSpace(text, pos);
+	if (pos < text.size() && text[pos] == '}') return true;
+
+	while (pos < text.size()) {
+		skipSpace(text, pos);
+		std::string key;
+		if (pos >= text.size() || text[pos] != '"' || !parseString(text, pos, key)) return false;
+
+		skipSpace(text, pos);
+		if (pos >= text.size() || text[pos] != ':') return false;
+		++pos;
+		skipSpace(text, pos);
+		if (pos >= text.size()) return false;
+
+		std::string value;
+		if (text[pos] == '"') {
+			if (!parseString(text, pos, value)) return false;
+		} else if (text[pos] == '[') {
+			++pos;
+			for (;;) {
+				skipSpace(text, pos);
+				if (pos >= text.size()) return false;
+				if (text[pos] == ']') {
+					++pos;
+					break;
+				}
+				std::string item;
+				if (text[pos] == '"' ? !parseString(text, pos, item) : !parseLiteral(text, pos, item)) return false;
+				if (!value.empty()) value += ",";
+				value += item;
+
+				skipSpace(text, pos);
+				if (pos < text.size() && text[pos] == ',') ++pos;
+			}
+		} else if (!parseLiteral(text, pos, value)) {
+			return false;
+		}
+		fields[key] = value;
+
+		skipSpace(text, pos);
+		if (pos >= text.size()) return false;
+		if (text[pos] == '}') return true;
+		if (text[pos] != ',') return false;
+		++pos;
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------------
+bool parseRenderJob(const std::string &line, CRenderJob &job, std::string &error)
+{
+	std::map<std::string, std::string> fields;
+	if (!parseFlatJson(line, fields)) {
+		error = "invalid json";
+		return false;
+	}
+
+	auto flag = [&fields](const char *key) {
+		auto it = fields.find(key);
+		return it != fields.end() && (it->second == "true" || it->second == "1");
+	};
+	auto text = [&fields](const char *key) {
+		auto it = fields.find(key);
+		return it != fields.end() && it->second != "null" ? it->second : std::string();
+	};
+
+	job = CRenderJob();
+	job.Id = text("id");
+	job.Command = text("cmd");
+	if (!job.Command.empty()) {
+		if (job.Command != "quit") {
+			error = "unknown command '" + job.Command + "'";
+			return false;
+		}
+		return true;
+	}
+
+	job.Map = text("map");
+	if (job.Map.empty()) {
+		error = "missing 'map'";
+		return false;
+	}
+	job.Season = text("season");
+	job.Scale = text("scale");
+	job.Output = text("output");
+	job.Pacs = flag("pacs");
+	job.Grid = flag("grid");
+	job.GridNames = flag("grid_names");
+	job.OverlayLayers = flag("overlay_layers");
+
+	std::string region = text("region");
+	if (!region.empty()) {
+		std::vector<std::string> coords;
+		splitString(region, ",", coords);
+		float v[4];
+		if (coords.size() != 4 || !fromString(coords[0], v[0]) || !fromString(coords[1], v[1])
+		    || !fromString(coords[2], v[2]) || !fromString(coords[3], v[3])) {
+			error = "'region' must be [x0, y0, x1, y1]";
+			return false;
+		}
+		job.HasRegion = true;
+		job.Min = NLMISC::CVector2f(std::min(v[0], v[2]), std::min(v[1], v[3]));
+		job.Max = NLMISC::CVector2f(std::max(v[0], v[2]), std::max(v[1], v[3]));
+		if (job.Min.x == job.Max.x || job.Min.y == job.Max.y) {
+			error = "empty 'region'";
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,70 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef RENDER_JOB_H
+#define RENDER_JOB_H
+
+#include <map>
+#include <string>
+
+#include "nel/misc/types_nl.h"
+#include "nel/misc/vector_2f.h"
+
+// single map render request for daemon mode, one json object per line
+//
+// {"id":"1","map":"fyros","season":"su","scale":"2:1","region":[18000,-25000,19600,-23400],
+//  "pacs":true,"grid":false,"grid_names":false,"overlay_layers":false,"output":"out/pyr.png"}
+//
+// only 'map' is required, other fields fall back to daemon settings
+struct CRenderJob
+{
+	std::string Id;
+	// 'quit' stops daemon after queued jobs are done
+	std::string Command;
+
+	std::string Map;
+	std::string Season;
+	// 'px:m' as in --scale, empty to keep current
+	std::string Scale;
+
+	bool HasRegion;
+	NLMISC::CVector2f Min;
+	NLMISC::CVector2f Max;
+
+	bool Pacs;
+	bool Grid;
+	bool GridNames;
+	bool OverlayLayers;
+
+	// output directory or .png filename
+	std::string Output;
+
+	// job server connection that sent the job
+	uint Client;
+
+	CRenderJob()
+	    : HasRegion(false)
+	    , Pacs(false)
+	    , Grid(false)
+	    , GridNames(false)
+	    , OverlayLayers(false)
+	    , Client(0)
+	{
+	}
+};
+
+// flat json object into key -> value, strings unescaped,
+// arrays as comma separated values, false on syntax error
+bool parseFlatJson(const std::string &text, std::map<std::string, std::string> &fields);
+
+// false with error message if line is not a valid job
+bool parseRenderJob(const std::string &line, CRenderJob &job, std::string &error);
+
+#endif
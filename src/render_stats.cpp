@@ -0,0 +1,393 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+
+#include "nel/misc/debug.h"
+
+#include "render_stats.h"
+
+using namespace NLMISC;
+
+static const char *stageNames[StageCount] = {
+	"sheets",
+	"continent",
+	"zones",
+	"zone_ig",
+	"render",
+	"inverse_z",
+	"fxaa",
+	"readback",
+	"downsample",
+	"blit",
+	"write_png",
+};
+
+//----------------------------------------------------------------------------
+const char *getRenderStageName(TRenderStage stage)
+{
+	if (stage >= StageCount) return "unknown";
+	return stageNames[stage];
+}
+
+//----------------------------------------------------------------------------
+void CMemoryStats::keepMax(const CMemoryStats &other)
+{
+	Rss = std::max(Rss, other.Rss);
+	PeakRss = std::max(PeakRss, other.PeakRss);
+	Canvas = std::max(Canvas, other.Canvas);
+	Texture = std::max(Texture, other.Texture);
+	Zones = std::max(Zones, other.Zones);
+	IGs = std::max(IGs, other.IGs);
+	Instances = std::max(Instances, other.Instances);
+}
+
+//----------------------------------------------------------------------------
+bool getProcessMemory(uint64 &rss, uint64 &peakRss)
+{
+	rss = 0;
+	peakRss = 0;
+#ifdef NL_OS_UNIX
+	FILE *fp = fopen("/proc/self/status", "r");
+	if (!fp) return false;
+
+	// values are in kB
+	char line[256];
+	while (fgets(line, sizeof(line), fp)) {
+		if (strncmp(line, "VmRSS:", 6) == 0) {
+			rss = strtoull(line + 6, nullptr, 10) * 1024;
+		} else if (strncmp(line, "VmHWM:", 6) == 0) {
+			peakRss = strtoull(line + 6, nullptr, 10) * 1024;
+		}
+	}
+	fclose(fp);
+	return rss > 0;
+#else
+	return false;
+#endif
+}
+
+//----------------------------------------------------------------------------
+CRenderStats::CRenderStats()
+    : _TraceEnabled(false)
+{
+	std::fill(_StageTime, _StageTime + StageCount, 0.0);
+	std::fill(_StageCalls, _StageCalls + StageCount, 0);
+	reset("");
+}
+
+//----------------------------------------------------------------------------
+void CRenderStats::reset(const std::string &mapName)
+{
+	// sheets are loaded once per run
+	double sheets = _StageTime[StageSheets];
+	uint sheetCalls = _StageCalls[StageSheets];
+
+	_MapName = mapName;
+	_MapStart = CTime::getPerformanceTime();
+	for (uint i = 0; i < StageCount; ++i) {
+		_StageTime[i] = 0.0;
+		_StageCalls[i] = 0;
+		_StageStart[i] = 0;
+		_StageDepth[i] = 0;
+	}
+	_StageTime[StageSheets] = sheets;
+	_StageCalls[StageSheets] = sheetCalls;
+
+	_ZonesLoaded = 0;
+	_ZonesUnloaded = 0;
+	_InverseZRendered = 0;
+	_InverseZSkipped = 0;
+	_PeakMemory = CMemoryStats();
+	_Evictions = 0;
+	_BandStreaming = false;
+	_TileWidth = 0;
+	_TileHeight = 0;
+	_Supersample = 1;
+	_InTile = false;
+	_Tiles.clear();
+	_Trace.clear();
+	_TraceFull = false;
+}
+
+//----------------------------------------------------------------------------
+void CRenderStats::begin(TRenderStage stage)
+{
+	if (_StageDepth[stage]++ == 0) {
+		_StageStart[stage] = CTime::getPerformanceTime();
+	}
+}
+
+//----------------------------------------------------------------------------
+void CRenderStats::end(TRenderStage stage)
+{
+	if (_StageDepth[stage] == 0) {
+		nlwarning("stage '%s' end without begin", getRenderStageName(stage));
+		return;
+	}
+	if (--_StageDepth[stage] > 0) {
+		return;
+	}
+
+	TTicks now = CTime::getPerformanceTime();
+	double dt = CTime::ticksToSecond(now - _StageStart[stage]);
+	_StageTime[stage] += dt;
+	_StageCalls[stage]++;
+	if (_InTile) {
+		_CurrentTile.StageTime[stage] += dt;
+	}
+
+	if (_TraceEnabled && !_TraceFull) {
+		if (_Trace.size() < maxTraceEvents) {
+			_Trace.push_back({ stage, _StageStart[stage], now });
+		} else {
+			nlwarning("trace for '%s' is full, %u events kept", _MapName.c_str(), maxTraceEvents);
+			_TraceFull = true;
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+void CRenderStats::beginTile(uint x, uint y)
+{
+	_InTile = true;
+	_TileStart = CTime::getPerformanceTime();
+	_CurrentTile.X = x;
+	_CurrentTile.Y = y;
+	_CurrentTile.Time = 0.0;
+	std::fill(_CurrentTile.StageTime, _CurrentTile.StageTime + StageCount, 0.0);
+	_CurrentTile.Memory = CMemoryStats();
+	_CurrentTile.Triangles = 0;
+	_CurrentTile.Meshes = 0;
+	_CurrentTile.DepthRange = 0.f;
+}
+
+//----------------------------------------------------------------------------
+void CRenderStats::endTile()
+{
+	if (!_InTile) return;
+
+	_InTile = false;
+	_CurrentTile.Time = CTime::ticksToSecond(CTime::getPerformanceTime() - _TileStart);
+	_Tiles.push_back(_CurrentTile);
+}
+
+//----------------------------------------------------------------------------
+void CRenderStats::setMemory(const CMemoryStats &mem)
+{
+	if (_InTile) {
+		_CurrentTile.Memory = mem;
+	}
+	_PeakMemory.keepMax(mem);
+}
+
+//----------------------------------------------------------------------------
+void CRenderStats::setTileComplexity(uint triangles, uint meshes)
+{
+	if (!_InTile) return;
+
+	_CurrentTile.Triangles = triangles;
+	_CurrentTile.Meshes = meshes;
+}
+
+//----------------------------------------------------------------------------
+void CRenderStats::setTileDepth(float range)
+{
+	if (!_InTile) return;
+
+	_CurrentTile.DepthRange = range;
+}
+
+//----------------------------------------------------------------------------
+double CRenderStats::getElapsed() const
+{
+	return CTime::ticksToSecond(CTime::getPerformanceTime() - _MapStart);
+}
+
+//----------------------------------------------------------------------------
+std::vector<double> CRenderStats::getTileSamples(uint stage) const
+{
+	std::vector<double> out;
+	out.reserve(_Tiles.size());
+	for (const auto &tile : _Tiles) {
+		out.push_back(stage < StageCount ? tile.StageTime[stage] : tile.Time);
+	}
+	std::sort(out.begin(), out.end());
+	return out;
+}
+
+//----------------------------------------------------------------------------
+double CRenderStats::percentile(const std::vector<double> &sorted, double p)
+{
+	if (sorted.empty()) return 0.0;
+
+	// nearest rank
+	uint rank = (uint)std::ceil(p / 100.0 * sorted.size());
+	rank = std::min((uint)sorted.size(), std::max(1u, rank));
+	return sorted[rank - 1];
+}
+
+//----------------------------------------------------------------------------
+double CRenderStats::getTilePercentile(double p) const
+{
+	return percentile(getTileSamples(StageCount), p);
+}
+
+//----------------------------------------------------------------------------
+std::string CRenderStats::jsonEscape(const std::string &str)
+{
+	std::string out;
+	out.reserve(str.size());
+	for (char c : str) {
+		switch (c) {
+		case '"':
+			out += "\\\"";
+			break;
+		case '\\':
+			out += "\\\\";
+			break;
+		case '\n':
+			out += "\\n";
+			break;
+		case '\r':
+			out += "\\r";
+			break;
+		case '\t':
+			out += "\\t";
+			break;
+		default:
+			if ((uint8)c < 0x20) {
+				char buf[8];
+				snprintf(buf, sizeof(buf), "\\u%04x", (uint8)c);
+				out += buf;
+			} else {
+				out += c;
+			}
+		}
+	}
+	return out;
+}
+
+//----------------------------------------------------------------------------
+bool CRenderStats::writeJson(const std::string &filename) const
+{
+	std::ofstream out(filename.c_str());
+	if (!out.is_open()) {
+		nlwarning("failed to open '%s' for writing", filename.c_str());
+		return false;
+	}
+
+	double elapsed = getElapsed();
+
+	out << std::fixed << std::setprecision(6);
+	out << "{\n";
+	out << "  \"map\": \"" << jsonEscape(_MapName) << "\",\n";
+	out << "  \"elapsed\": " << elapsed << ",\n";
+	out << "  \"tiles\": " << _Tiles.size() << ",\n";
+	out << "  \"tile_size\": [" << _TileWidth << ", " << _TileHeight << "],\n";
+	out << "  \"ssaa\": " << _Supersample << ",\n";
+	out << "  \"tiles_per_second\": " << (elapsed > 0 ? _Tiles.size() / elapsed : 0.0) << ",\n";
+	out << "  \"zones_loaded\": " << _ZonesLoaded << ",\n";
+	out << "  \"zones_unloaded\": " << _ZonesUnloaded << ",\n";
+	out << "  \"inverse_z\": { \"rendered\": " << _InverseZRendered << ", \"skipped\": " << _InverseZSkipped << " },\n";
+	// false: gpu stages are cpu submit time
+	out << "  \"gpu_sync\": " << (isGpuSynced() ? "true" : "false") << ",\n";
+
+	out << "  \"stages\": {\n";
+	for (uint i = 0; i < StageCount; ++i) {
+		std::vector<double> samples = getTileSamples(i);
+		out << "    \"" << stageNames[i] << "\": { \"total\": " << _StageTime[i]
+		    << ", \"calls\": " << _StageCalls[i]
+		    << ", \"tile_p50\": " << percentile(samples, 50)
+		    << ", \"tile_p90\": " << percentile(samples, 90)
+		    << ", \"tile_p99\": " << percentile(samples, 99)
+		    << ", \"tile_max\": " << percentile(samples, 100)
+		    << " }" << (i + 1 < StageCount ? "," : "") << "\n";
+	}
+	out << "  },\n";
+
+	std::vector<double> samples = getTileSamples(StageCount);
+	out << "  \"tile\": { \"p50\": " << percentile(samples, 50)
+	    << ", \"p90\": " << percentile(samples, 90)
+	    << ", \"p99\": " << percentile(samples, 99)
+	    << ", \"max\": " << percentile(samples, 100)
+	    << " },\n";
+
+	// peak values over map
+	out << "  \"memory\": { \"rss\": " << _PeakMemory.Rss
+	    << ", \"peak_rss\": " << _PeakMemory.PeakRss
+	    << ", \"canvas\": " << _PeakMemory.Canvas
+	    << ", \"texture\": " << _PeakMemory.Texture
+	    << ", \"zones\": " << _PeakMemory.Zones
+	    << ", \"igs\": " << _PeakMemory.IGs
+	    << ", \"instances\": " << _PeakMemory.Instances
+	    << ", \"evictions\": " << _Evictions
+	    << ", \"band_streaming\": " << (_BandStreaming ? "true" : "false")
+	    << " }\n";
+	out << "}\n";
+
+	return true;
+}
+
+//----------------------------------------------------------------------------
+bool CRenderStats::writeCsv(const std::string &filename) const
+{
+	std::ofstream out(filename.c_str());
+	if (!out.is_open()) {
+		nlwarning("failed to open '%s' for writing", filename.c_str());
+		return false;
+	}
+
+	out << std::fixed << std::setprecision(6);
+	out << "x,y,total";
+	for (uint i = 0; i < StageCount; ++i) {
+		out << "," << stageNames[i];
+	}
+	out << ",rss,texture,zones,igs,instances,depth\n";
+
+	for (const auto &tile : _Tiles) {
+		out << tile.X << "," << tile.Y << "," << tile.Time;
+		for (uint i = 0; i < StageCount; ++i) {
+			out << "," << tile.StageTime[i];
+		}
+		out << "," << tile.Memory.Rss << "," << tile.Memory.Texture << "," << tile.Memory.Zones
+		    << "," << tile.Memory.IGs << "," << tile.Memory.Instances << "," << tile.DepthRange << "\n";
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------------
+bool CRenderStats::writeChromeTrace(const std::string &filename) const
+{
+	std::ofstream out(filename.c_str());
+	if (!out.is_open()) {
+		nlwarning("failed to open '%s' for writing", filename.c_str());
+		return false;
+	}
+
+	out << std::fixed << std::setprecision(3);
+	out << "{\"traceEvents\":[\n";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"" << jsonEscape(_MapName) << "\"}}";
+	for (const auto &ev : _Trace) {
+		double ts = CTime::ticksToSecond(ev.Start - _MapStart) * 1000000.0;
+		double dur = CTime::ticksToSecond(ev.End - ev.Start) * 1000000.0;
+		out << ",\n{\"name\":\"" << stageNames[ev.Stage] << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << ts << ",\"dur\":" << dur << "}";
+	}
+	out << "\n]}\n";
+
+	return true;
+}
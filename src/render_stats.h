@@ -0,0 +1,219 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include <string>
+#include <vector>
+
+#include "nel/misc/types_nl.h"
+#include "nel/misc/time_nl.h"
+
+enum TRenderStage
+{
+	StageSheets = 0,
+	StageContinent,
+	StageZones,
+	StageZoneIG,
+	StageRender,
+	StageInverseZ,
+	StageFxaa,
+	StageReadback,
+	StageDownsample,
+	StageBlit,
+	StageWritePng,
+	StageCount
+};
+
+const char *getRenderStageName(TRenderStage stage);
+
+// memory use snapshot, bytes
+struct CMemoryStats
+{
+	uint64 Rss;
+	uint64 PeakRss;
+	// output bitmap held in memory
+	uint64 Canvas;
+	uint64 Texture;
+	uint Zones;
+	// zone/village/outpost igs in scene
+	uint IGs;
+	uint Instances;
+
+	CMemoryStats()
+	    : Rss(0)
+	    , PeakRss(0)
+	    , Canvas(0)
+	    , Texture(0)
+	    , Zones(0)
+	    , IGs(0)
+	    , Instances(0)
+	{
+	}
+
+	// keep larger value of each field
+	void keepMax(const CMemoryStats &other);
+};
+
+// current and peak resident set size, false if not supported on this platform
+bool getProcessMemory(uint64 &rss, uint64 &peakRss);
+
+// per map timing of render stages, per tile samples and optional trace events
+class CRenderStats
+{
+public:
+	struct CTileSample
+	{
+		uint X, Y;
+		double Time;
+		double StageTime[StageCount];
+		CMemoryStats Memory;
+		// only with complexity profiling
+		uint Triangles;
+		uint Meshes;
+		// zfar - znear in meters, 0 if fixed slab
+		float DepthRange;
+	};
+
+	CRenderStats();
+
+	// start new map, keeps sheet load time
+	void reset(const std::string &mapName);
+
+	// trace also waits for gpu at the end of render stages, without it
+	// render, inverse_z and fxaa are cpu submit time only
+	void setTraceEnabled(bool b) { _TraceEnabled = b; }
+	bool isTraceEnabled() const { return _TraceEnabled; }
+	bool isGpuSynced() const { return _TraceEnabled; }
+
+	// stage timing, nested stages are allowed (time is counted for both)
+	void begin(TRenderStage stage);
+	void end(TRenderStage stage);
+
+	// tile samples, stages outside tiles only go into map totals
+	void beginTile(uint x, uint y);
+	void endTile();
+
+	// zones streamed in/out by landscape
+	void addZones(uint loaded, uint unloaded)
+	{
+		_ZonesLoaded += loaded;
+		_ZonesUnloaded += unloaded;
+	}
+	uint getZonesLoaded() const { return _ZonesLoaded; }
+	uint getZonesUnloaded() const { return _ZonesUnloaded; }
+
+	// memory snapshot for current tile and map peak
+	void setMemory(const CMemoryStats &mem);
+	const CMemoryStats &getPeakMemory() const { return _PeakMemory; }
+	// primitives and meshes rendered for current tile
+	void setTileComplexity(uint triangles, uint meshes);
+	// per tile depth range
+	void setTileDepth(float range);
+	const std::vector<CTileSample> &getTiles() const { return _Tiles; }
+
+	// per tile inverse z pass decision
+	void addInverseZ(bool rendered) { ++(rendered ? _InverseZRendered : _InverseZSkipped); }
+	uint getInverseZSkipped() const { return _InverseZSkipped; }
+
+	// cache eviction because of memory budget
+	void addEviction() { ++_Evictions; }
+	void setBandStreaming(bool b) { _BandStreaming = b; }
+	// rendered tile size, so --plan can scale tile time to other sizes
+	void setTileSize(uint width, uint height, uint ssaa)
+	{
+		_TileWidth = width;
+		_TileHeight = height;
+		_Supersample = ssaa;
+	}
+
+	// seconds
+	double getStageTime(TRenderStage stage) const { return _StageTime[stage]; }
+	double getElapsed() const;
+	uint getTileCount() const { return _Tiles.size(); }
+	// tile render time percentile (0..100) in seconds
+	double getTilePercentile(double p) const;
+
+	const std::string &getMapName() const { return _MapName; }
+
+	bool writeJson(const std::string &filename) const;
+	bool writeCsv(const std::string &filename) const;
+	// chrome://tracing / perfetto json
+	bool writeChromeTrace(const std::string &filename) const;
+
+	// sorted tile total times in seconds
+	std::vector<double> getTileTimes() const { return getTileSamples(StageCount); }
+
+	// escape string for json output
+	static std::string jsonEscape(const std::string &str);
+	// nearest rank percentile (0..100) from sorted samples
+	static double percentile(const std::vector<double> &sorted, double p);
+
+private:
+	struct CTraceEvent
+	{
+		TRenderStage Stage;
+		NLMISC::TTicks Start;
+		NLMISC::TTicks End;
+	};
+
+	// sorted stage times (or tile total for StageCount) from tile samples
+	std::vector<double> getTileSamples(uint stage) const;
+
+	std::string _MapName;
+	bool _TraceEnabled;
+
+	NLMISC::TTicks _MapStart;
+	double _StageTime[StageCount];
+	uint _StageCalls[StageCount];
+	NLMISC::TTicks _StageStart[StageCount];
+	uint _StageDepth[StageCount];
+	uint _ZonesLoaded;
+	uint _ZonesUnloaded;
+	uint _InverseZRendered;
+	uint _InverseZSkipped;
+
+	CMemoryStats _PeakMemory;
+	uint _Evictions;
+	bool _BandStreaming;
+	uint _TileWidth;
+	uint _TileHeight;
+	uint _Supersample;
+
+	bool _InTile;
+	NLMISC::TTicks _TileStart;
+	CTileSample _CurrentTile;
+	std::vector<CTileSample> _Tiles;
+
+	// trace events kept per map, interactive mode would grow without bound
+	static const uint maxTraceEvents = 1 << 20;
+	std::vector<CTraceEvent> _Trace;
+	bool _TraceFull;
+};
+
+// scoped stage timer
+class CStageTimer
+{
+public:
+	CStageTimer(CRenderStats &stats, TRenderStage stage)
+	    : _Stats(stats)
+	    , _Stage(stage)
+	{
+		_Stats.begin(_Stage);
+	}
+	~CStageTimer() { _Stats.end(_Stage); }
+
+private:
+	CRenderStats &_Stats;
+	TRenderStage _Stage;
+};
+
+#endif
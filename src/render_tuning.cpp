@@ -0,0 +1,126 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+
+#include "nel/misc/common.h"
+#include "nel/misc/debug.h"
+#include "nel/misc/file.h"
+
+#include "render_job.h"
+#include "render_stats.h"
+#include "render_tuning.h"
+
+using namespace NLMISC;
+
+// summed rgb difference for pixel to count as different,
+// tessellation noise stays well below it, missing zones and tiles go over
+static const uint pixelDiffLimit = 72;
+
+//----------------------------------------------------------------------------
+bool readRenderTuning(const std::string &filename, CRenderTuning &tuning)
+{
+	FILE *fp = fopen(filename.c_str(), "rb");
+	if (!fp) return false;
+
+	std::string text;
+	char buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+		text.append(buf, n);
+	}
+	fclose(fp);
+
+	std::map<std::string, std::string> fields;
+	if (!parseFlatJson(text, fields)) return false;
+
+	tuning.Continent = fields["continent"];
+	tuning.Season = fields["season"];
+	// missing in files from before auto lod bias
+	if (!fromString(fields["auto_lod_bias"], tuning.AutoLodBias)) {
+		tuning.AutoLodBias = 0.f;
+	}
+	return fromString(fields["scale"], tuning.Scale)
+	    && fromString(fields["lod_bias"], tuning.LodBias)
+	    && fromString(fields["ssaa"], tuning.Supersample)
+	    && fromString(fields["tile_width"], tuning.TileWidth)
+	    && fromString(fields["tile_height"], tuning.TileHeight)
+	    && fromString(fields["vision"], tuning.Vision)
+	    && fromString(fields["tilenear"], tuning.TileNear)
+	    && tuning.TileWidth > 0 && tuning.TileHeight > 0 && tuning.Vision > 0;
+}
+
+//----------------------------------------------------------------------------
+bool writeRenderTuning(const std::string &filename, const CRenderTuning &tuning)
+{
+	std::string text = toString("{\"continent\":\"%s\",\"scale\":%.4f,\"lod_bias\":%.2f,\"season\":\"%s\",\"ssaa\":%u,"
+	                            "\"tile_width\":%u,\"tile_height\":%u,\"vision\":%u,\"tilenear\":%u,\"auto_lod_bias\":%.2f}\n",
+	    CRenderStats::jsonEscape(tuning.Continent).c_str(), tuning.Scale, tuning.LodBias, CRenderStats::jsonEscape(tuning.Season).c_str(),
+	    tuning.Supersample, tuning.TileWidth, tuning.TileHeight, tuning.Vision, tuning.TileNear, tuning.AutoLodBias);
+
+	// renders running next to tuning never read half written file
+	CFile::createDirectoryTree(CFile::getPath(filename));
+	std::string tmp = filename + ".tmp";
+	FILE *fp = fopen(tmp.c_str(), "wb");
+	if (!fp) {
+		nlwarning("unable to write '%s'", tmp.c_str());
+		return false;
+	}
+	bool ok = fwrite(text.data(), 1, text.size(), fp) == text.size();
+	ok = fclose(fp) == 0 && ok;
+	if (!ok || !CFile::moveFile(filename, tmp)) {
+		nlwarning("unable to write '%s'", filename.c_str());
+		CFile::deleteFile(tmp);
+		return false;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------
+CSeamDiff compareTileSeams(const CBitmap &reference, const CBitmap &test, uint tileWidth, uint tileHeight, uint band)
+{
+	CSeamDiff diff;
+
+	uint width = reference.getWidth();
+	uint height = reference.getHeight();
+	if (width == 0 || height == 0 || test.getWidth() != width || test.getHeight() != height) {
+		diff.All = 1.f;
+		diff.Border = 1.f;
+		return diff;
+	}
+
+	const uint8 *ref = &reference.getPixels()[0];
+	const uint8 *px = &test.getPixels()[0];
+
+	uint64 all = 0, border = 0, borderPixels = 0;
+	for (uint y = 0; y < height; ++y) {
+		// distance to nearest inner tile edge, image edges are not seams
+		uint ty = y % tileHeight;
+		bool rowBorder = (y >= tileHeight && ty < band) || (y - ty + tileHeight < height && tileHeight - ty <= band);
+		for (uint x = 0; x < width; ++x, ref += 4, px += 4) {
+			uint tx = x % tileWidth;
+			bool isBorder = rowBorder || (x >= tileWidth && tx < band) || (x - tx + tileWidth < width && tileWidth - tx <= band);
+
+			uint d = std::abs((sint)ref[0] - px[0]) + std::abs((sint)ref[1] - px[1]) + std::abs((sint)ref[2] - px[2]);
+			bool bad = d > pixelDiffLimit;
+			all += bad;
+			if (isBorder) {
+				border += bad;
+				++borderPixels;
+			}
+		}
+	}
+
+	diff.All = (float)all / ((uint64)width * height);
+	diff.Border = borderPixels ? (float)border / borderPixels : 0.f;
+	return diff;
+}
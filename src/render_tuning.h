@@ -0,0 +1,72 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef RENDER_TUNING_H
+#define RENDER_TUNING_H
+
+#include <string>
+
+#include "nel/misc/bitmap.h"
+#include "nel/misc/types_nl.h"
+
+// auto tuned landscape settings for single continent, scale, lod bias, season and ssaa
+//
+// <dir>/<continent>.json
+// {"continent":"fyros","scale":0.2500,"lod_bias":-1.00,"season":"sp","ssaa":1,"tile_width":800,"tile_height":800,"vision":720,"tilenear":360,"auto_lod_bias":2.00}
+struct CRenderTuning
+{
+	std::string Continent;
+	float Scale;
+	// requested bias, negative is auto
+	float LodBias;
+	std::string Season;
+	// requested ssaa factor
+	uint Supersample;
+	uint TileWidth;
+	uint TileHeight;
+	uint Vision;
+	uint TileNear;
+	// largest bias that stayed close to full quality render, used for auto lod bias
+	float AutoLodBias;
+
+	CRenderTuning()
+	    : Scale(0.f)
+	    , LodBias(0.f)
+	    , Supersample(1)
+	    , TileWidth(0)
+	    , TileHeight(0)
+	    , Vision(0)
+	    , TileNear(0)
+	    , AutoLodBias(0.f)
+	{
+	}
+};
+
+// false if file is missing or invalid
+bool readRenderTuning(const std::string &filename, CRenderTuning &tuning);
+bool writeRenderTuning(const std::string &filename, const CRenderTuning &tuning);
+
+// share of pixels that differ from reference render, all and within band px from tile borders
+struct CSeamDiff
+{
+	float All;
+	float Border;
+
+	CSeamDiff()
+	    : All(0.f)
+	    , Border(0.f)
+	{
+	}
+};
+
+// images must be same size, tile borders are at multiples of tile size
+CSeamDiff compareTileSeams(const NLMISC::CBitmap &reference, const NLMISC::CBitmap &test, uint tileWidth, uint tileHeight, uint band);
+
+#endif
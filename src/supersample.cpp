@@ -0,0 +1,166 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SUPERSAMPLE_SSE2
+#endif
+
+#include "supersample.h"
+
+using namespace NLMISC;
+
+// output rows per work item
+static const uint rowsPerChunk = 16;
+
+//----------------------------------------------------------------------------
+// any factor, also tail of vector rows
+static void downsampleRowScalar(const uint8 *src, uint srcPitch, uint factor, uint8 *dest, uint x0, uint x1)
+{
+	const uint count = factor * factor;
+	for (uint x = x0; x < x1; ++x) {
+		uint sum[4] = { 0, 0, 0, 0 };
+		for (uint sy = 0; sy < factor; ++sy) {
+			const uint8 *p = src + sy * srcPitch + x * factor * 4;
+			for (uint sx = 0; sx < factor; ++sx, p += 4) {
+				sum[0] += p[0];
+				sum[1] += p[1];
+				sum[2] += p[2];
+				sum[3] += p[3];
+			}
+		}
+		for (uint c = 0; c < 4; ++c) {
+			dest[x * 4 + c] = (uint8)((sum[c] + count / 2) / count);
+		}
+	}
+}
+
+#ifdef SUPERSAMPLE_SSE2
+//----------------------------------------------------------------------------
+// 4 output pixels from 2 rows of 8 source pixels, returns first pixel not done
+static uint downsampleRow2x(const uint8 *src, uint srcPitch, uint8 *dest, uint width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi16(2);
+	const uint8 *row0 = src;
+	const uint8 *row1 = src + srcPitch;
+
+	uint x = 0;
+	for (; x + 4 <= width; x += 4) {
+		__m128i a0 = _mm_loadu_si128((const __m128i *)(row0 + x * 8));
+		__m128i a1 = _mm_loadu_si128((const __m128i *)(row0 + x * 8 + 16));
+		__m128i b0 = _mm_loadu_si128((const __m128i *)(row1 + x * 8));
+		__m128i b1 = _mm_loadu_si128((const __m128i *)(row1 + x * 8 + 16));
+
+		// vertical sums, 2 source pixels per register
+		__m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+		__m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+		__m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+		__m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+		// horizontal pairs end up in low 64 bits
+		s0 = _mm_add_epi16(s0, _mm_srli_si128(s0, 8));
+		s1 = _mm_add_epi16(s1, _mm_srli_si128(s1, 8));
+		s2 = _mm_add_epi16(s2, _mm_srli_si128(s2, 8));
+		s3 = _mm_add_epi16(s3, _mm_srli_si128(s3, 8));
+
+		__m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s0, s1), round), 2);
+		__m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s2, s3), round), 2);
+		_mm_storeu_si128((__m128i *)(dest + x * 4), _mm_packus_epi16(lo, hi));
+	}
+	return x;
+}
+
+//----------------------------------------------------------------------------
+// 1 output pixel from 4 rows of 4 source pixels
+static uint downsampleRow4x(const uint8 *src, uint srcPitch, uint8 *dest, uint width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi16(8);
+
+	uint x = 0;
+	for (; x < width; ++x) {
+		__m128i sum = zero;
+		for (uint sy = 0; sy < 4; ++sy) {
+			__m128i p = _mm_loadu_si128((const __m128i *)(src + sy * srcPitch + x * 16));
+			sum = _mm_add_epi16(sum, _mm_unpacklo_epi8(p, zero));
+			sum = _mm_add_epi16(sum, _mm_unpackhi_epi8(p, zero));
+		}
+		sum = _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+		sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 4);
+		*(sint32 *)(dest + x * 4) = _mm_cvtsi128_si32(_mm_packus_epi16(sum, zero));
+	}
+	return x;
+}
+#endif
+
+//----------------------------------------------------------------------------
+static void downsampleRow(const uint8 *src, uint srcPitch, uint factor, uint8 *dest, uint width)
+{
+	uint x = 0;
+#ifdef SUPERSAMPLE_SSE2
+	if (factor == 2) {
+		x = downsampleRow2x(src, srcPitch, dest, width);
+	} else if (factor == 4) {
+		x = downsampleRow4x(src, srcPitch, dest, width);
+	}
+#endif
+	downsampleRowScalar(src, srcPitch, factor, dest, x, width);
+}
+
+//----------------------------------------------------------------------------
+void downsampleBitmap(const CBitmap &src, uint factor, CBitmap &dest, uint threads)
+{
+	factor = std::max(1u, factor);
+	const uint width = src.getWidth() / factor;
+	const uint height = src.getHeight() / factor;
+	dest.resize(width, height, CBitmap::RGBA);
+	if (width == 0 || height == 0) return;
+
+	const uint srcPitch = src.getWidth() * 4;
+	const uint8 *srcPixels = &src.getPixels()[0];
+	uint8 *destPixels = &dest.getPixels()[0];
+
+	uint chunks = (height + rowsPerChunk - 1) / rowsPerChunk;
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threads = std::min(threads, chunks);
+
+	std::atomic<uint> nextChunk(0);
+
+	// chunks write into disjoint rows of dest, no locking needed
+	auto worker = [&]() {
+		for (;;) {
+			uint chunk = nextChunk++;
+			if (chunk >= chunks) {
+				break;
+			}
+			uint y1 = std::min(height, (chunk + 1) * rowsPerChunk);
+			for (uint y = chunk * rowsPerChunk; y < y1; ++y) {
+				downsampleRow(srcPixels + y * factor * srcPitch, srcPitch, factor, destPixels + y * width * 4, width);
+			}
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (uint i = 1; i < threads; ++i) {
+		pool.emplace_back(worker);
+	}
+	worker();
+	for (auto &t : pool) {
+		t.join();
+	}
+}
@@ -0,0 +1,22 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef SUPERSAMPLE_H
+#define SUPERSAMPLE_H
+
+#include "nel/misc/bitmap.h"
+#include "nel/misc/types_nl.h"
+
+// box filter RGBA src into dest that is factor times smaller,
+// src size must be multiple of factor.
+// 2x and 4x use SSE2 when available, rows are split between threads (0 = all cores)
+void downsampleBitmap(const NLMISC::CBitmap &src, uint factor, NLMISC::CBitmap &dest, uint threads = 0);
+
+#endif
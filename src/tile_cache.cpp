@@ -0,0 +1,198 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "nel/misc/common.h"
+#include "nel/misc/debug.h"
+#include "nel/misc/file.h"
+#include "nel/misc/path.h"
+
+#include "tile_cache.h"
+
+using namespace NLMISC;
+
+//----------------------------------------------------------------------------
+std::string CTileKey::toString() const
+{
+	return NLMISC::toString("%s/%u/%u/%u", Season.c_str(), Z, X, Y);
+}
+
+//----------------------------------------------------------------------------
+CTileCache::CTileCache()
+    : _MemoryLimit(0)
+    , _MemorySize(0)
+    , _DiskLimit(0)
+    , _DiskSize(0)
+    , _Hits(0)
+    , _Misses(0)
+{
+}
+
+//----------------------------------------------------------------------------
+void CTileCache::init(uint64 memoryLimit, const std::string &directory, uint64 diskLimit)
+{
+	_MemoryLimit = memoryLimit;
+	_DiskLimit = diskLimit;
+	_Directory.clear();
+	if (!directory.empty()) {
+		_Directory = CPath::standardizePath(directory);
+		if (!CFile::isDirectory(_Directory) && !CFile::createDirectoryTree(_Directory)) {
+			nlwarning("unable to create tile cache directory '%s', disk cache disabled", _Directory.c_str());
+			_Directory.clear();
+		}
+	}
+	if (!_Directory.empty()) {
+		scanDisk();
+	}
+
+	nlinfo("tile cache: memory %u MiB, disk %u MiB in '%s' (%u tiles)",
+	    (uint)(_MemoryLimit >> 20), (uint)(_DiskLimit >> 20), _Directory.c_str(), (uint)_Disk.size());
+}
+
+//----------------------------------------------------------------------------
+std::string CTileCache::getDiskPath(const std::string &name) const
+{
+	return _Directory + name + ".png";
+}
+
+//----------------------------------------------------------------------------
+void CTileCache::scanDisk()
+{
+	std::vector<std::string> files;
+	CPath::getPathContent(_Directory, true, false, true, files);
+
+	std::vector<std::pair<uint32, std::string>> byDate;
+	for (const auto &path : files) {
+		if (CFile::getExtension(path) != "png") continue;
+		byDate.push_back(std::make_pair(CFile::getFileModificationDate(path), path));
+	}
+	std::sort(byDate.begin(), byDate.end());
+
+	// newest ends up at front
+	for (const auto &it : byDate) {
+		std::string name = it.second.substr(_Directory.size());
+		name = name.substr(0, name.size() - 4);
+		touchDisk(name, CFile::getFileSize(it.second));
+	}
+}
+
+//----------------------------------------------------------------------------
+bool CTileCache::get(const CTileKey &key, std::string &data)
+{
+	std::string name = key.toString();
+
+	auto mem = _MemoryIndex.find(name);
+	if (mem != _MemoryIndex.end()) {
+		_Memory.splice(_Memory.begin(), _Memory, mem->second);
+		data = mem->second->second;
+		++_Hits;
+		return true;
+	}
+
+	auto disk = _DiskIndex.find(name);
+	if (disk != _DiskIndex.end()) {
+		FILE *fp = fopen(getDiskPath(name).c_str(), "rb");
+		if (fp) {
+			data.resize(disk->second->second);
+			size_t n = data.empty() ? 0 : fread(&data[0], 1, data.size(), fp);
+			fclose(fp);
+			if (n == data.size() && !data.empty()) {
+				_Disk.splice(_Disk.begin(), _Disk, disk->second);
+				putMemory(name, data);
+				++_Hits;
+				return true;
+			}
+		}
+		// removed or truncated behind our back
+		_DiskSize -= disk->second->second;
+		_Disk.erase(disk->second);
+		_DiskIndex.erase(disk);
+	}
+
+	++_Misses;
+	return false;
+}
+
+//----------------------------------------------------------------------------
+void CTileCache::put(const CTileKey &key, const std::string &data)
+{
+	std::string name = key.toString();
+	putMemory(name, data);
+
+	if (_Directory.empty() || _DiskLimit == 0) return;
+
+	std::string path = getDiskPath(name);
+	CFile::createDirectoryTree(CFile::getPath(path));
+
+	// write aside and rename so readers never see partial tile
+	std::string tmp = path + ".tmp";
+	FILE *fp = fopen(tmp.c_str(), "wb");
+	if (!fp) {
+		nlwarning("unable to write '%s'", tmp.c_str());
+		return;
+	}
+	bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+	ok = fclose(fp) == 0 && ok;
+	if (!ok || !CFile::moveFile(path, tmp)) {
+		nlwarning("unable to write '%s'", path.c_str());
+		CFile::deleteFile(tmp);
+		return;
+	}
+
+	touchDisk(name, data.size());
+}
+
+//----------------------------------------------------------------------------
+void CTileCache::putMemory(const std::string &name, const std::string &data)
+{
+	auto it = _MemoryIndex.find(name);
+	if (it != _MemoryIndex.end()) {
+		_MemorySize -= it->second->second.size();
+		_Memory.erase(it->second);
+		_MemoryIndex.erase(it);
+	}
+	if (data.size() > _MemoryLimit) return;
+
+	_Memory.push_front(std::make_pair(name, data));
+	_MemoryIndex[name] = _Memory.begin();
+	_MemorySize += data.size();
+
+	while (_MemorySize > _MemoryLimit && !_Memory.empty()) {
+		_MemorySize -= _Memory.back().second.size();
+		_MemoryIndex.erase(_Memory.back().first);
+		_Memory.pop_back();
+	}
+}
+
+//----------------------------------------------------------------------------
+void CTileCache::touchDisk(const std::string &name, uint64 size)
+{
+	auto it = _DiskIndex.find(name);
+	if (it != _DiskIndex.end()) {
+		_DiskSize -= it->second->second;
+		_Disk.erase(it->second);
+		_DiskIndex.erase(it);
+	}
+
+	_Disk.push_front(std::make_pair(name, size));
+	_DiskIndex[name] = _Disk.begin();
+	_DiskSize += size;
+
+	while (_DiskSize > _DiskLimit && _Disk.size() > 1) {
+		const auto &oldest = _Disk.back();
+		CFile::deleteFile(getDiskPath(oldest.first));
+		_DiskSize -= oldest.second;
+		_DiskIndex.erase(oldest.first);
+		_Disk.pop_back();
+	}
+}
@@ -0,0 +1,92 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+#include <list>
+#include <map>
+#include <string>
+
+#include "nel/misc/types_nl.h"
+
+// world tile pyramid, zoom 0 is single tile covering TILE_WORLD_SIZE meters,
+// x grows east from world x=0, y grows south from world y=0
+#define TILE_WORLD_SIZE 131072.f
+#define TILE_PIXELS 256
+
+struct CTileKey
+{
+	uint Z;
+	uint X;
+	uint Y;
+	std::string Season;
+
+	CTileKey()
+	    : Z(0)
+	    , X(0)
+	    , Y(0)
+	{
+	}
+
+	// 'season/z/x/y'
+	std::string toString() const;
+
+	// tile size in meters and top-left corner in world coords
+	float getSize() const { return TILE_WORLD_SIZE / (1 << Z); }
+	float getLeft() const { return X * getSize(); }
+	float getTop() const { return -(Y * getSize()); }
+};
+
+// encoded tiles in memory and on disk, least recently used are dropped first
+class CTileCache
+{
+public:
+	CTileCache();
+
+	// limits in bytes, empty directory disables disk cache
+	void init(uint64 memoryLimit, const std::string &directory, uint64 diskLimit);
+
+	// memory first, disk hits are promoted to memory
+	bool get(const CTileKey &key, std::string &data);
+	void put(const CTileKey &key, const std::string &data);
+
+	uint getHits() const { return _Hits; }
+	uint getMisses() const { return _Misses; }
+	uint64 getMemorySize() const { return _MemorySize; }
+	uint64 getDiskSize() const { return _DiskSize; }
+
+private:
+	typedef std::list<std::pair<std::string, std::string>> TMemoryList;
+	typedef std::list<std::pair<std::string, uint64>> TDiskList;
+
+	std::string getDiskPath(const std::string &name) const;
+	void putMemory(const std::string &name, const std::string &data);
+	void touchDisk(const std::string &name, uint64 size);
+	// index existing disk cache, oldest files first
+	void scanDisk();
+
+	uint64 _MemoryLimit;
+	uint64 _MemorySize;
+	// front is most recently used
+	TMemoryList _Memory;
+	std::map<std::string, TMemoryList::iterator> _MemoryIndex;
+
+	std::string _Directory;
+	uint64 _DiskLimit;
+	uint64 _DiskSize;
+	TDiskList _Disk;
+	std::map<std::string, TDiskList::iterator> _DiskIndex;
+
+	uint _Hits;
+	uint _Misses;
+};
+
+#endif
@@ -0,0 +1,481 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include "nel/misc/common.h"
+#include "nel/misc/debug.h"
+
+#ifdef NL_OS_UNIX
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "tile_server.h"
+
+using namespace NLMISC;
+
+// request line and headers, anything larger is not a tile request
+static const uint maxRequestSize = 8192;
+// poll() rounds without blocking after first event
+static const uint maxPollRounds = 64;
+
+static bool isNumber(const std::string &s)
+{
+	if (s.empty() || s.size() > 9) return false;
+	for (char c : s) {
+		if (c < '0' || c > '9') return false;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------
+CTileServer::CTileServer(CTileCache &cache)
+    : _Cache(cache)
+    , _Listen(-1)
+    , _Season("sp")
+    , _MinZoom(0)
+    , _MaxZoom(16)
+    , _NextClient(1)
+    , _NextSeq(1)
+    , _Requests(0)
+    , _Coalesced(0)
+    , _Rendered(0)
+    , _Cancelled(0)
+{
+}
+
+//----------------------------------------------------------------------------
+CTileServer::~CTileServer()
+{
+	close();
+}
+
+//----------------------------------------------------------------------------
+bool CTileServer::open(const std::string &address)
+{
+	close();
+
+#ifdef NL_OS_UNIX
+	std::string host = "127.0.0.1";
+	std::string port = address;
+	std::string::size_type pos = address.rfind(':');
+	if (pos != std::string::npos) {
+		host = address.substr(0, pos);
+		port = address.substr(pos + 1);
+	}
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	uint portNum = 0;
+	if (!isNumber(port) || !fromString(port, portNum) || portNum == 0 || portNum > 65535
+	    || inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+		nlwarning("invalid tile server address '%s', use '[host:]port'", address.c_str());
+		return false;
+	}
+	addr.sin_port = htons(portNum);
+
+	_Listen = socket(AF_INET, SOCK_STREAM, 0);
+	if (_Listen < 0) {
+		nlwarning("socket: %s", strerror(errno));
+		return false;
+	}
+
+	int reuse = 1;
+	setsockopt(_Listen, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	if (bind(_Listen, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(_Listen, 64) < 0) {
+		nlwarning("'%s': %s", address.c_str(), strerror(errno));
+		close();
+		return false;
+	}
+
+	nlinfo("serving tiles on http://%s:%u/{z}/{x}/{y}.png", host.c_str(), portNum);
+	return true;
+#else
+	nlwarning("tile server is only supported on unix");
+	return false;
+#endif
+}
+
+//----------------------------------------------------------------------------
+void CTileServer::close()
+{
+#ifdef NL_OS_UNIX
+	for (auto &it : _Clients) {
+		::close(it.second.Fd);
+	}
+	if (_Listen >= 0) {
+		::close(_Listen);
+	}
+#endif
+	_Clients.clear();
+	_Pending.clear();
+	_Listen = -1;
+}
+
+//----------------------------------------------------------------------------
+void CTileServer::poll(sint timeout)
+{
+	// read everything that queued up during last render before next tile is picked,
+	// newly accepted clients need another round to deliver their request
+	for (uint round = 0; round < maxPollRounds; ++round) {
+		if (!pollOnce(round == 0 ? timeout : 0)) {
+			break;
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+bool CTileServer::pollOnce(sint timeout)
+{
+#ifdef NL_OS_UNIX
+	std::vector<pollfd> fds;
+	std::vector<uint> ids;
+	if (_Listen >= 0) {
+		fds.push_back({ _Listen, POLLIN, 0 });
+		ids.push_back(0);
+	}
+	// waiting clients are polled too, so hang up cancels their tile
+	for (const auto &it : _Clients) {
+		fds.push_back({ it.second.Fd, (short)(it.second.Out.empty() ? POLLIN : POLLOUT), 0 });
+		ids.push_back(it.first);
+	}
+
+	if (fds.empty() || ::poll(&fds[0], fds.size(), timeout) <= 0) {
+		return false;
+	}
+
+	bool active = false;
+	for (uint i = 0; i < fds.size(); ++i) {
+		if (!fds[i].revents) continue;
+
+		if (fds[i].fd == _Listen) {
+			acceptClient();
+			active = true;
+			continue;
+		}
+
+		auto it = _Clients.find(ids[i]);
+		if (it == _Clients.end()) continue;
+
+		if (!it->second.Out.empty()) {
+			if (!writeClient(it->second)) {
+				dropClient(it->first);
+			}
+			continue;
+		}
+
+		// waiting clients only report hang up
+		active = active || it->second.Tile.empty();
+		if (!readClient(it->first, it->second)) {
+			dropClient(it->first);
+		}
+	}
+	return active;
+#else
+	return false;
+#endif
+}
+
+//----------------------------------------------------------------------------
+void CTileServer::acceptClient()
+{
+#ifdef NL_OS_UNIX
+	sint fd = accept(_Listen, nullptr, nullptr);
+	if (fd < 0) {
+		nlwarning("accept: %s", strerror(errno));
+		return;
+	}
+	// slow client must not stall renderer or other clients
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+	_Clients[_NextClient++] = { fd, "", "", "", 0 };
+#endif
+}
+
+//----------------------------------------------------------------------------
+bool CTileServer::readClient(uint client, CClient &c)
+{
+#ifdef NL_OS_UNIX
+	char buf[4096];
+	ssize_t n = recv(c.Fd, buf, sizeof(buf), 0);
+	if (n <= 0) {
+		return n < 0 && (errno == EINTR || errno == EAGAIN);
+	}
+
+	// already answered request line, ignore anything else
+	if (!c.Tile.empty()) {
+		return true;
+	}
+
+	c.Buffer.append(buf, n);
+	std::string::size_type end = c.Buffer.find("\r\n\r\n");
+	if (end == std::string::npos) {
+		end = c.Buffer.find("\n\n");
+	}
+	if (end == std::string::npos) {
+		if (c.Buffer.size() > maxRequestSize) {
+			send(client, "431 Request Header Fields Too Large", "text/plain", "request too large\n");
+		}
+		return true;
+	}
+
+	std::string request = c.Buffer.substr(0, c.Buffer.find('\n'));
+	c.Buffer.clear();
+	handleRequest(client, c, trim(request));
+	return true;
+#else
+	return false;
+#endif
+}
+
+//----------------------------------------------------------------------------
+void CTileServer::handleRequest(uint client, CClient &c, const std::string &request)
+{
+	// GET /path HTTP/1.1
+	std::vector<std::string> parts;
+	splitString(request, " ", parts);
+	if (parts.size() < 2 || parts[0] != "GET") {
+		send(client, "405 Method Not Allowed", "text/plain", "only GET is supported\n");
+		return;
+	}
+	const std::string &path = parts[1];
+	++_Requests;
+
+	if (path == "/status") {
+		send(client, "200 OK", "application/json",
+		    toString("{\"requests\":%u,\"rendered\":%u,\"coalesced\":%u,\"cancelled\":%u,\"pending\":%u,"
+		             "\"cache\":{\"hits\":%u,\"misses\":%u,\"memory\":%" NL_I64 "u,\"disk\":%" NL_I64 "u}}\n",
+		        _Requests, _Rendered, _Coalesced, _Cancelled, (uint)_Pending.size(),
+		        _Cache.getHits(), _Cache.getMisses(), _Cache.getMemorySize(), _Cache.getDiskSize()));
+		return;
+	}
+
+	CTileKey key;
+	bool prefetch = false;
+	if (!parseTilePath(path, key, prefetch)) {
+		send(client, "404 Not Found", "text/plain", "not found\n");
+		return;
+	}
+
+	std::string data;
+	if (_Cache.get(key, data)) {
+		send(client, "200 OK", "image/png", data);
+		return;
+	}
+
+	std::string name = key.toString();
+	c.Tile = name;
+
+	auto it = _Pending.find(name);
+	if (it != _Pending.end()) {
+		// already queued, share the render
+		++_Coalesced;
+		it->second.Clients.push_back(client);
+		it->second.Seq = _NextSeq++;
+		it->second.Prefetch = it->second.Prefetch && prefetch;
+		return;
+	}
+
+	CPendingTile &tile = _Pending[name];
+	tile.Key = key;
+	tile.Clients.push_back(client);
+	tile.Seq = _NextSeq++;
+	tile.Prefetch = prefetch;
+}
+
+//----------------------------------------------------------------------------
+bool CTileServer::parseTilePath(const std::string &path, CTileKey &key, bool &prefetch) const
+{
+	std::string query;
+	std::string tile = path;
+	std::string::size_type pos = path.find('?');
+	if (pos != std::string::npos) {
+		tile = path.substr(0, pos);
+		query = path.substr(pos + 1);
+	}
+
+	key.Season = _Season;
+	prefetch = false;
+
+	std::vector<std::string> params;
+	splitString(query, "&", params);
+	for (const auto &param : params) {
+		std::string::size_type eq = param.find('=');
+		std::string name = param.substr(0, eq);
+		std::string value = eq == std::string::npos ? "" : param.substr(eq + 1);
+		if (name == "season") {
+			if (value != "sp" && value != "su" && value != "au" && value != "wi") {
+				return false;
+			}
+			key.Season = value;
+		} else if (name == "prefetch") {
+			prefetch = value != "0";
+		}
+	}
+
+	// /z/x/y.png
+	std::vector<std::string> parts;
+	splitString(tile, "/", parts);
+	if (parts.size() != 3 || parts[2].size() < 5 || parts[2].substr(parts[2].size() - 4) != ".png") {
+		return false;
+	}
+	parts[2] = parts[2].substr(0, parts[2].size() - 4);
+	if (!isNumber(parts[0]) || !isNumber(parts[1]) || !isNumber(parts[2])) {
+		return false;
+	}
+
+	fromString(parts[0], key.Z);
+	fromString(parts[1], key.X);
+	fromString(parts[2], key.Y);
+	if (key.Z < _MinZoom || key.Z > _MaxZoom) {
+		return false;
+	}
+
+	uint count = 1 << key.Z;
+	return key.X < count && key.Y < count;
+}
+
+//----------------------------------------------------------------------------
+bool CTileServer::nextTile(CTileKey &key)
+{
+	dropClosedClients();
+
+	const CPendingTile *best = nullptr;
+	for (const auto &it : _Pending) {
+		const CPendingTile &tile = it.second;
+		if (!best || (best->Prefetch && !tile.Prefetch) || (best->Prefetch == tile.Prefetch && tile.Seq > best->Seq)) {
+			best = &tile;
+		}
+	}
+	if (!best) {
+		return false;
+	}
+
+	key = best->Key;
+	return true;
+}
+
+//----------------------------------------------------------------------------
+void CTileServer::complete(const CTileKey &key, const std::string &data)
+{
+	if (!data.empty()) {
+		_Cache.put(key, data);
+	}
+
+	auto it = _Pending.find(key.toString());
+	if (it == _Pending.end()) {
+		return;
+	}
+
+	std::vector<uint> clients;
+	clients.swap(it->second.Clients);
+	_Pending.erase(it);
+	++_Rendered;
+
+	for (uint client : clients) {
+		if (data.empty()) {
+			send(client, "404 Not Found", "text/plain", "nothing to render\n");
+		} else {
+			send(client, "200 OK", "image/png", data);
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+void CTileServer::send(uint client, const std::string &status, const std::string &type, const std::string &body)
+{
+#ifdef NL_OS_UNIX
+	auto it = _Clients.find(client);
+	if (it == _Clients.end()) return;
+
+	CClient &c = it->second;
+	// request is answered, tile is no longer waited for
+	c.Tile.clear();
+	c.Out = toString("HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n"
+	                 "Access-Control-Allow-Origin: *\r\nConnection: close\r\n\r\n",
+	    status.c_str(), type.c_str(), (uint)body.size());
+	c.Out += body;
+	c.Sent = 0;
+
+	// rest is written from poll()
+	if (!writeClient(c)) {
+		dropClient(client);
+	}
+#endif
+}
+
+//----------------------------------------------------------------------------
+bool CTileServer::writeClient(CClient &c)
+{
+#ifdef NL_OS_UNIX
+	while (c.Sent < c.Out.size()) {
+		// client may have gone away, no SIGPIPE
+		ssize_t n = ::send(c.Fd, c.Out.data() + c.Sent, c.Out.size() - c.Sent, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR) continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+		if (n <= 0) return false;
+		c.Sent += n;
+	}
+#endif
+	return false;
+}
+
+//----------------------------------------------------------------------------
+void CTileServer::dropClosedClients()
+{
+#ifdef NL_OS_UNIX
+	// requests read in same poll as hang up, or clients that gave up during last render
+	std::vector<uint> closed;
+	for (const auto &it : _Clients) {
+		if (it.second.Tile.empty()) continue;
+
+		char c;
+		if (recv(it.second.Fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 0) {
+			closed.push_back(it.first);
+		}
+	}
+	for (uint client : closed) {
+		dropClient(client);
+	}
+#endif
+}
+
+//----------------------------------------------------------------------------
+void CTileServer::dropClient(uint client)
+{
+	auto it = _Clients.find(client);
+	if (it == _Clients.end()) return;
+
+	if (!it->second.Tile.empty()) {
+		auto tile = _Pending.find(it->second.Tile);
+		if (tile != _Pending.end()) {
+			auto &clients = tile->second.Clients;
+			clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
+			// nobody is looking at this tile anymore
+			if (clients.empty()) {
+				_Pending.erase(tile);
+				++_Cancelled;
+			}
+		}
+	}
+
+#ifdef NL_OS_UNIX
+	::close(it->second.Fd);
+#endif
+	_Clients.erase(it);
+}
@@ -0,0 +1,114 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef TILE_SERVER_H
+#define TILE_SERVER_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "nel/misc/types_nl.h"
+
+#include "tile_cache.h"
+
+// minimal http server for z/x/y tiles, one request per connection
+//
+// GET /{z}/{x}/{y}.png[?season=su&prefetch=1]
+// GET /status
+//
+// cached tiles are answered from poll(), missing tiles are queued for renderer.
+// replies are written without blocking, rest of a large png goes out on later polls.
+// requests for same tile share single render, newest request is rendered first
+// (viewer asks for visible tiles after pan), prefetch tiles come after those and
+// tiles are dropped if every client waiting for them has disconnected.
+class CTileServer
+{
+public:
+	CTileServer(CTileCache &cache);
+	~CTileServer();
+
+	// '[host:]port', host defaults to 127.0.0.1
+	bool open(const std::string &address);
+	void close();
+
+	void setSeason(const std::string &season) { _Season = season; }
+	void setZoomRange(uint minZoom, uint maxZoom)
+	{
+		_MinZoom = minZoom;
+		_MaxZoom = maxZoom;
+	}
+
+	// wait up to timeout ms (-1 forever) for requests
+	void poll(sint timeout);
+	bool hasPending() const { return !_Pending.empty(); }
+
+	// next tile to render, false if nothing is waiting
+	bool nextTile(CTileKey &key);
+	// send tile to everyone waiting for it, empty data replies 404
+	void complete(const CTileKey &key, const std::string &data);
+
+	uint getRendered() const { return _Rendered; }
+
+private:
+	struct CClient
+	{
+		sint Fd;
+		std::string Buffer;
+		// tile this client waits for, empty while reading request
+		std::string Tile;
+		// reply not yet written to socket, client is closed once it is sent
+		std::string Out;
+		uint Sent;
+	};
+
+	struct CPendingTile
+	{
+		CTileKey Key;
+		std::vector<uint> Clients;
+		// request order, higher is newer
+		uint Seq;
+		// only prefetch requests are waiting
+		bool Prefetch;
+	};
+
+	// false if there was nothing new to read
+	bool pollOnce(sint timeout);
+	void acceptClient();
+	// false when client should be dropped
+	bool readClient(uint client, CClient &c);
+	void handleRequest(uint client, CClient &c, const std::string &request);
+	bool parseTilePath(const std::string &path, CTileKey &key, bool &prefetch) const;
+
+	void send(uint client, const std::string &status, const std::string &type, const std::string &body);
+	// write as much of reply as socket takes, false when client is done or gone
+	bool writeClient(CClient &c);
+	void dropClient(uint client);
+	// cancel tiles nobody waits for anymore
+	void dropClosedClients();
+
+	CTileCache &_Cache;
+	sint _Listen;
+	std::string _Season;
+	uint _MinZoom;
+	uint _MaxZoom;
+
+	uint _NextClient;
+	uint _NextSeq;
+	std::map<uint, CClient> _Clients;
+	std::map<std::string, CPendingTile> _Pending;
+
+	uint _Requests;
+	uint _Coalesced;
+	uint _Rendered;
+	uint _Cancelled;
+};
+
+#endif
@@ -0,0 +1,277 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+
+#include "nel/misc/common.h"
+#include "nel/misc/debug.h"
+#include "nel/misc/file.h"
+#include "nel/misc/path.h"
+
+#include "render_job.h"
+#include "render_stats.h"
+#include "tile_cache.h"
+#include "world_pyramid.h"
+
+using namespace NLMISC;
+
+//----------------------------------------------------------------------------
+CWorldPyramid::CWorldPyramid(const std::string &directory)
+    : _Directory(CPath::standardizePath(directory))
+{
+}
+
+//----------------------------------------------------------------------------
+std::string CWorldPyramid::getTilePath(uint z, uint x, uint y) const
+{
+	return _Directory + toString("%u/%u/%u.png", z, x, y);
+}
+
+//----------------------------------------------------------------------------
+std::string CWorldPyramid::getManifestPath(const std::string &continent) const
+{
+	return _Directory + continent + ".json";
+}
+
+//----------------------------------------------------------------------------
+bool CWorldPyramid::writeTile(uint z, uint x, uint y, CBitmap &tile)
+{
+	std::string path = getTilePath(z, x, y);
+	CFile::createDirectoryTree(CFile::getPath(path));
+
+	// write aside and rename so tile server never sees partial tile
+	std::string tmp = path + ".tmp";
+	{
+		COFile file;
+		if (!file.open(tmp)) {
+			nlwarning("unable to write '%s'", tmp.c_str());
+			return false;
+		}
+		tile.writePNG(file, 24);
+	}
+	if (!CFile::moveFile(path, tmp)) {
+		nlwarning("unable to write '%s'", path.c_str());
+		CFile::deleteFile(tmp);
+		return false;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------
+bool CWorldPyramid::getTileRect(uint z, uint x, uint y, const CWorldArea &area, uint &x0, uint &y0, uint &x1, uint &y1)
+{
+	// tile y grows south
+	float size = TILE_WORLD_SIZE / (1 << z);
+	float left = x * size;
+	float top = -(y * size);
+	float ppm = TILE_PIXELS / size;
+
+	float fx0 = std::floor((area.Min.x - left) * ppm);
+	float fx1 = std::ceil((area.Max.x - left) * ppm);
+	float fy0 = std::floor((top - area.Max.y) * ppm);
+	float fy1 = std::ceil((top - area.Min.y) * ppm);
+	if (fx1 <= 0 || fy1 <= 0 || fx0 >= TILE_PIXELS || fy0 >= TILE_PIXELS) {
+		return false;
+	}
+
+	x0 = (uint)std::max(0.f, fx0);
+	y0 = (uint)std::max(0.f, fy0);
+	x1 = (uint)std::min((float)TILE_PIXELS, fx1);
+	y1 = (uint)std::min((float)TILE_PIXELS, fy1);
+	return true;
+}
+
+//----------------------------------------------------------------------------
+bool CWorldPyramid::mergeTile(uint z, uint x, uint y, CBitmap &tile, const CWorldArea &own, const std::vector<CWorldArea> &others, CRGBA background)
+{
+	bool shared = false;
+	uint x0, y0, x1, y1;
+	for (const auto &area : others) {
+		shared = shared || getTileRect(z, x, y, area, x0, y0, x1, y1);
+	}
+
+	CBitmap existing;
+	if (!shared || !loadTile(z, x, y, existing)) {
+		// tile belongs only to this continent, or neighbours are not rendered yet
+		return writeTile(z, x, y, tile);
+	}
+	mergePixels(z, x, y, existing, tile, own, others, background);
+	return writeTile(z, x, y, existing);
+}
+
+//----------------------------------------------------------------------------
+bool CWorldPyramid::mergePixels(uint z, uint x, uint y, CBitmap &dest, const CBitmap &tile, const CWorldArea &own, const std::vector<CWorldArea> &others, CRGBA background)
+{
+	// 0 - kept from dest, 1 - own, 2 - own and shared with other continent
+	std::vector<uint8> owner(TILE_PIXELS * TILE_PIXELS, 0);
+	uint x0, y0, x1, y1;
+	if (getTileRect(z, x, y, own, x0, y0, x1, y1)) {
+		for (uint py = y0; py < y1; ++py) {
+			std::fill(owner.begin() + py * TILE_PIXELS + x0, owner.begin() + py * TILE_PIXELS + x1, 1);
+		}
+	}
+
+	bool shared = false;
+	for (const auto &area : others) {
+		if (!getTileRect(z, x, y, area, x0, y0, x1, y1)) continue;
+
+		shared = true;
+		for (uint py = y0; py < y1; ++py) {
+			for (uint px = x0; px < x1; ++px) {
+				uint8 &o = owner[py * TILE_PIXELS + px];
+				o = o ? 2 : 0;
+			}
+		}
+	}
+
+	if (!shared) {
+		return false;
+	}
+
+	const uint8 *src = &tile.getPixels()[0];
+	uint8 *dst = &dest.getPixels()[0];
+	for (uint i = 0; i < TILE_PIXELS * TILE_PIXELS; ++i, src += 4, dst += 4) {
+		if (owner[i] == 0) continue;
+		if (owner[i] == 2 && src[0] == background.R && src[1] == background.G && src[2] == background.B && src[3] == background.A) continue;
+
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+		dst[3] = src[3];
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------
+bool CWorldPyramid::loadTile(uint z, uint x, uint y, CBitmap &tile) const
+{
+	CIFile file;
+	if (!file.open(getTilePath(z, x, y))) {
+		return false;
+	}
+	try {
+		tile.load(file);
+	} catch (const EStream &e) {
+		nlwarning("failed to read world tile '%s' (%s)", getTilePath(z, x, y).c_str(), e.what());
+		return false;
+	}
+	if (tile.getPixelFormat() != CBitmap::RGBA) {
+		tile.convertToType(CBitmap::RGBA);
+	}
+	return tile.getWidth() == TILE_PIXELS && tile.getHeight() == TILE_PIXELS;
+}
+
+//----------------------------------------------------------------------------
+bool CWorldPyramid::isContinentDone(const std::string &continent, const std::string &settings, uint zoom, uint x0, uint y0, uint x1, uint y1) const
+{
+	std::string text;
+	FILE *fp = fopen(getManifestPath(continent).c_str(), "rb");
+	if (!fp) return false;
+	char buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+		text.append(buf, n);
+	}
+	fclose(fp);
+
+	std::map<std::string, std::string> fields;
+	if (!parseFlatJson(text, fields)) return false;
+	if (fields["continent"] != continent || fields["settings"] != settings
+	    || fields["zoom"] != toString(zoom) || fields["tiles"] != toString("%u,%u,%u,%u", x0, y0, x1, y1)) {
+		return false;
+	}
+
+	// tiles may have been removed by hand
+	for (uint y = y0; y <= y1; ++y) {
+		for (uint x = x0; x <= x1; ++x) {
+			if (!CFile::fileExists(getTilePath(zoom, x, y))) return false;
+		}
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------
+void CWorldPyramid::setContinentDone(const std::string &continent, const std::string &settings, uint zoom, uint x0, uint y0, uint x1, uint y1)
+{
+	std::string text = toString("{\"continent\":\"%s\",\"settings\":\"%s\",\"zoom\":%u,\"tiles\":[%u,%u,%u,%u]}\n",
+	    CRenderStats::jsonEscape(continent).c_str(), settings.c_str(), zoom, x0, y0, x1, y1);
+
+	std::string path = getManifestPath(continent);
+	std::string tmp = path + ".tmp";
+	FILE *fp = fopen(tmp.c_str(), "wb");
+	if (!fp) {
+		nlwarning("unable to write '%s'", tmp.c_str());
+		return;
+	}
+	bool ok = fwrite(text.data(), 1, text.size(), fp) == text.size();
+	ok = fclose(fp) == 0 && ok;
+	if (!ok || !CFile::moveFile(path, tmp)) {
+		nlwarning("unable to write '%s'", path.c_str());
+	}
+}
+
+//----------------------------------------------------------------------------
+void CWorldPyramid::buildLevels(uint zoom, const std::set<TTileXY> &dirty, const std::set<TTileXY> &tiles, CRGBA background)
+{
+	std::set<TTileXY> level = tiles;
+	std::set<TTileXY> changed = dirty;
+
+	for (uint z = zoom; z > 0; --z) {
+		std::set<TTileXY> parents;
+		std::set<TTileXY> parentsChanged;
+		for (const auto &it : level) {
+			parents.insert(TTileXY(it.first / 2, it.second / 2));
+		}
+		for (const auto &it : changed) {
+			parentsChanged.insert(TTileXY(it.first / 2, it.second / 2));
+		}
+
+		uint built = 0;
+		for (const auto &parent : parents) {
+			if (parentsChanged.count(parent) == 0 && CFile::fileExists(getTilePath(z - 1, parent.first, parent.second))) {
+				continue;
+			}
+
+			// 2x2 children on background, missing children stay background
+			CBitmap canvas;
+			canvas.resize(TILE_PIXELS * 2, TILE_PIXELS * 2, CBitmap::RGBA);
+			uint8 *pixels = &canvas.getPixels()[0];
+			for (uint i = 0; i < TILE_PIXELS * 2 * TILE_PIXELS * 2; ++i, pixels += 4) {
+				pixels[0] = background.R;
+				pixels[1] = background.G;
+				pixels[2] = background.B;
+				pixels[3] = background.A;
+			}
+
+			for (uint dy = 0; dy < 2; ++dy) {
+				for (uint dx = 0; dx < 2; ++dx) {
+					TTileXY child(parent.first * 2 + dx, parent.second * 2 + dy);
+					CBitmap tile;
+					if (level.count(child) && loadTile(z, child.first, child.second, tile)) {
+						canvas.blit(tile, 0, 0, TILE_PIXELS, TILE_PIXELS, dx * TILE_PIXELS, dy * TILE_PIXELS);
+					}
+				}
+			}
+
+			canvas.resample(TILE_PIXELS, TILE_PIXELS);
+			if (writeTile(z - 1, parent.first, parent.second, canvas)) {
+				++built;
+			}
+			parentsChanged.insert(parent);
+		}
+		nlinfo("world zoom %u: %u tiles, %u rebuilt", z - 1, (uint)parents.size(), built);
+
+		level.swap(parents);
+		changed.swap(parentsChanged);
+	}
+}
@@ -0,0 +1,74 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef WORLD_PYRAMID_H
+#define WORLD_PYRAMID_H
+
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nel/misc/bitmap.h"
+#include "nel/misc/rgba.h"
+#include "nel/misc/types_nl.h"
+#include "nel/misc/vector_2f.h"
+
+// tile x, y on single zoom level
+typedef std::pair<uint, uint> TTileXY;
+
+// continent area in world coords
+struct CWorldArea
+{
+	NLMISC::CVector2f Min;
+	NLMISC::CVector2f Max;
+};
+
+// sparse world tile pyramid on disk, same tile grid as CTileKey
+//
+// <dir>/<z>/<x>/<y>.png
+// <dir>/<continent>.json - {"continent":"fyros","settings":"9f0c..","zoom":9,"tiles":[x0,y0,x1,y1]}
+//
+// continent manifest is written after all its tiles, so matching manifest means
+// continent tiles can be reused as they are
+//
+// tiles on continent edges are shared with neighbours, those are merged with
+// tile already on disk instead of overwriting it
+class CWorldPyramid
+{
+public:
+	CWorldPyramid(const std::string &directory);
+
+	std::string getTilePath(uint z, uint x, uint y) const;
+	bool writeTile(uint z, uint x, uint y, NLMISC::CBitmap &tile);
+	// pixels inside own area replace tile on disk, rest of it is kept for other continents,
+	// where areas overlap only non background pixels are taken
+	bool mergeTile(uint z, uint x, uint y, NLMISC::CBitmap &tile, const CWorldArea &own, const std::vector<CWorldArea> &others, NLMISC::CRGBA background);
+	// same merge into tile in memory, false if tile has no area shared with others (dest is untouched)
+	static bool mergePixels(uint z, uint x, uint y, NLMISC::CBitmap &dest, const NLMISC::CBitmap &tile, const CWorldArea &own, const std::vector<CWorldArea> &others, NLMISC::CRGBA background);
+
+	// continent was rendered with same settings and tile range
+	bool isContinentDone(const std::string &continent, const std::string &settings, uint zoom, uint x0, uint y0, uint x1, uint y1) const;
+	void setContinentDone(const std::string &continent, const std::string &settings, uint zoom, uint x0, uint y0, uint x1, uint y1);
+
+	// downsample 2x2 children into parent for dirty tiles on zoom and everything above it,
+	// missing parents of existing tiles are also built
+	void buildLevels(uint zoom, const std::set<TTileXY> &dirty, const std::set<TTileXY> &tiles, NLMISC::CRGBA background);
+
+private:
+	std::string getManifestPath(const std::string &continent) const;
+	// pixel rect [x0, x1) x [y0, y1) of area on tile, false if area does not touch tile
+	static bool getTileRect(uint z, uint x, uint y, const CWorldArea &area, uint &x0, uint &y0, uint &x1, uint &y1);
+	bool loadTile(uint z, uint x, uint y, NLMISC::CBitmap &tile) const;
+
+	std::string _Directory;
+};
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <iostream>
+#include <unordered_map>
+
+#include "nel/misc/common.h"
+#include "nel/misc/time_nl.h"
+
+#include "zone_id.h"
+
+using namespace NLMISC;
+
+//----------------------------------------------------------------------------
+TZoneId getZoneIdFromName(const std::string &name)
+{
+	uint i = 0;
+	uint row = 0;
+	while (i < name.size() && name[i] >= '0' && name[i] <= '9') {
+		row = row * 10 + (name[i] - '0');
+		++i;
+	}
+	if (i == 0 || row == 0 || row > 0xffff || i + 3 > name.size() || name[i] != '_') {
+		return ZONE_ID_INVALID;
+	}
+	++i;
+
+	uint column = 0;
+	for (uint j = 0; j < 2; ++j, ++i) {
+		// ascii upper case
+		char c = name[i] & ~0x20;
+		if (c < 'A' || c > 'Z') {
+			return ZONE_ID_INVALID;
+		}
+		column = column * 26 + (c - 'A');
+	}
+
+	// allow file extension
+	if (i < name.size() && name[i] != '.') {
+		return ZONE_ID_INVALID;
+	}
+
+	return makeZoneId(column, row);
+}
+
+//----------------------------------------------------------------------------
+std::string getZoneNameFromId(TZoneId id)
+{
+	if (id == ZONE_ID_INVALID) {
+		return "";
+	}
+
+	// row is at most 5 digits
+	char buf[9];
+	char *p = buf + sizeof(buf);
+	uint column = getZoneColumn(id);
+	*--p = 'A' + column % 26;
+	*--p = 'A' + (column / 26) % 26;
+	*--p = '_';
+	uint row = getZoneRow(id);
+	do {
+		*--p = '0' + row % 10;
+		row /= 10;
+	} while (row > 0);
+
+	return std::string(p, buf + sizeof(buf));
+}
+
+//----------------------------------------------------------------------------
+TZoneId getZoneIdFromPos(float x, float y)
+{
+	if (x < 0 || y > 0 || x >= ZONE_MAX_X || y <= -ZONE_MAX_Y) {
+		return ZONE_ID_INVALID;
+	}
+
+	return makeZoneId((uint)(x / ZONE_TILE_WH), (uint)(-y / ZONE_TILE_WH) + 1);
+}
+
+//----------------------------------------------------------------------------
+void getZoneIdPos(TZoneId id, float &left, float &top)
+{
+	left = (float)getZoneColumn(id) * ZONE_TILE_WH;
+	top = -(float)(getZoneRow(id) - 1) * ZONE_TILE_WH;
+}
+
+//----------------------------------------------------------------------------
+void benchZoneIds(uint iterations)
+{
+	if (iterations == 0) {
+		iterations = 100;
+	}
+
+	// continent sized grid, as landscape reports them
+	std::vector<std::string> names;
+	for (uint row = 1; row <= 64; ++row) {
+		for (uint column = 0; column < 96; ++column) {
+			names.push_back(getZoneNameFromId(makeZoneId(column, row)));
+		}
+	}
+
+	// every 8th zone has entry, like outpost tiles
+	std::unordered_map<std::string, uint> stringMap;
+	CZoneIdMap<uint> idMap;
+	for (uint i = 0; i < names.size(); i += 8) {
+		stringMap[toLower(names[i])] = i;
+		idMap[getZoneIdFromName(names[i])] = i;
+	}
+
+	uint64 checksum = 0;
+	uint64 lookups = (uint64)iterations * names.size();
+
+	auto report = [&](const char *what, TTicks start) {
+		double ms = CTime::ticksToSecond(CTime::getPerformanceTime() - start) * 1000.0;
+		std::cout << "  " << what << ": " << ms << " ms, " << (ms * 1000000.0 / lookups) << " ns/op\n";
+	};
+
+	std::cout << "zone id benchmark, " << names.size() << " zones x " << iterations << " iterations\n";
+
+	TTicks start = CTime::getPerformanceTime();
+	for (uint n = 0; n < iterations; ++n) {
+		for (const auto &name : names) {
+			checksum += getZoneIdFromName(name);
+		}
+	}
+	report("name -> id", start);
+
+	start = CTime::getPerformanceTime();
+	for (uint n = 0; n < iterations; ++n) {
+		for (uint i = 0; i < names.size(); ++i) {
+			checksum += getZoneNameFromId(makeZoneId(i % 96, i / 96 + 1)).size();
+		}
+	}
+	report("id -> name", start);
+
+	start = CTime::getPerformanceTime();
+	for (uint n = 0; n < iterations; ++n) {
+		for (const auto &name : names) {
+			auto it = stringMap.find(toLower(name));
+			if (it != stringMap.end()) {
+				checksum += it->second;
+			}
+		}
+	}
+	report("toLower + unordered_map<string> lookup", start);
+
+	start = CTime::getPerformanceTime();
+	for (uint n = 0; n < iterations; ++n) {
+		for (const auto &name : names) {
+			const uint *val = idMap.find(getZoneIdFromName(name));
+			if (val) {
+				checksum += *val;
+			}
+		}
+	}
+	report("name -> id + CZoneIdMap lookup", start);
+
+	start = CTime::getPerformanceTime();
+	for (uint n = 0; n < iterations; ++n) {
+		for (uint i = 0; i < names.size(); ++i) {
+			const uint *val = idMap.find(makeZoneId(i % 96, i / 96 + 1));
+			if (val) {
+				checksum += *val;
+			}
+		}
+	}
+	report("CZoneIdMap lookup", start);
+
+	std::cout << "  (checksum " << checksum << ")" << std::endl;
+}
@@ -0,0 +1,138 @@
+/*
+ * Ryzom Map Renderer - https://github.com/nimetu/ryzom_map_renderer
+ * Copyright (c) 2020 Meelis Mägi <nimetu@gmail.com>
+ *
+ * This file is part of Ryzom Map Renderer.
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef ZONE_ID_H
+#define ZONE_ID_H
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "nel/misc/types_nl.h"
+#include "nel/misc/debug.h"
+
+// nel zone tile width/height (1_AA.zonel) in meters
+#define ZONE_TILE_WH 160
+#define ZONE_MAX_X 26 * 26 * ZONE_TILE_WH // AA-ZZ == 108160
+#define ZONE_MAX_Y 256 * ZONE_TILE_WH
+
+// zone tile on 160m grid packed as (row << 16 | column)
+// row is the number part (1..), column is letter part (AA == 0, ZZ == 675)
+typedef uint32 TZoneId;
+
+// row 0 does not exist, so 0 is never a valid zone
+#define ZONE_ID_INVALID 0
+
+inline TZoneId makeZoneId(uint column, uint row) { return (row << 16) | (column & 0xffff); }
+inline uint getZoneColumn(TZoneId id) { return id & 0xffff; }
+inline uint getZoneRow(TZoneId id) { return id >> 16; }
+
+// '12_AB', '12_ab.zonel' -> id; returns ZONE_ID_INVALID on parse error
+TZoneId getZoneIdFromName(const std::string &name);
+// id -> '12_AB'
+std::string getZoneNameFromId(TZoneId id);
+// zone tile containing world pos, ZONE_ID_INVALID if outside of zone grid
+TZoneId getZoneIdFromPos(float x, float y);
+// top-left corner of zone tile in world coords
+void getZoneIdPos(TZoneId id, float &left, float &top);
+
+// open addressing hash map with zone id keys
+template <class T>
+class CZoneIdMap
+{
+public:
+	CZoneIdMap()
+	    : _Size(0)
+	{
+	}
+
+	uint size() const { return _Size; }
+	bool empty() const { return _Size == 0; }
+
+	void clear()
+	{
+		_Keys.clear();
+		_Values.clear();
+		_Size = 0;
+	}
+
+	T *find(TZoneId id)
+	{
+		if (_Keys.empty() || id == ZONE_ID_INVALID) return nullptr;
+
+		uint mask = _Keys.size() - 1;
+		for (uint i = hash(id) & mask;; i = (i + 1) & mask) {
+			if (_Keys[i] == id) return &_Values[i];
+			if (_Keys[i] == ZONE_ID_INVALID) return nullptr;
+		}
+	}
+
+	const T *find(TZoneId id) const { return const_cast<CZoneIdMap *>(this)->find(id); }
+
+	// insert default value if key is not present
+	T &operator[](TZoneId id)
+	{
+		nlassert(id != ZONE_ID_INVALID);
+
+		// keep load factor under 0.5
+		if ((_Size + 1) * 2 > _Keys.size()) {
+			rehash(std::max((uint)16, (uint)_Keys.size() * 2));
+		}
+
+		uint mask = _Keys.size() - 1;
+		uint i = hash(id) & mask;
+		while (_Keys[i] != ZONE_ID_INVALID && _Keys[i] != id) {
+			i = (i + 1) & mask;
+		}
+		if (_Keys[i] == ZONE_ID_INVALID) {
+			_Keys[i] = id;
+			_Values[i] = T();
+			++_Size;
+		}
+		return _Values[i];
+	}
+
+	// f(TZoneId, T&)
+	template <class F>
+	void forEach(F f)
+	{
+		for (uint i = 0; i < _Keys.size(); ++i) {
+			if (_Keys[i] != ZONE_ID_INVALID) {
+				f(_Keys[i], _Values[i]);
+			}
+		}
+	}
+
+private:
+	static uint hash(TZoneId id) { return (id * 2654435761u) >> 7; }
+
+	void rehash(uint capacity)
+	{
+		std::vector<TZoneId> keys(capacity, ZONE_ID_INVALID);
+		std::vector<T> values(capacity);
+		keys.swap(_Keys);
+		values.swap(_Values);
+		_Size = 0;
+		for (uint i = 0; i < keys.size(); ++i) {
+			if (keys[i] != ZONE_ID_INVALID) {
+				std::swap((*this)[keys[i]], values[i]);
+			}
+		}
+	}
+
+	std::vector<TZoneId> _Keys;
+	std::vector<T> _Values;
+	uint _Size;
+};
+
+// microbenchmark for zone name/id conversion and lookup, prints results to stdout
+void benchZoneIds(uint iterations);
+
+#endif